@@ -0,0 +1,79 @@
+/* ===========================================================================
+ * mfcompact.c
+ *
+ * Rewrites a MIDI file in as few bytes as possible with MidiCompactFile(), and reports how many
+ * bytes were saved. Every MIDI event gets running status wherever it's allowed, Note Offs become
+ * Note Ons with 0 velocity, Controller events that don't change anything are dropped, and SYSEX
+ * CONTINUATION packets at the same time are merged.
+ * =========================================================================
+ */
+
+#ifdef __OS2__
+#include <os2.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "midifile.h"
+
+/* Need CALLBACK structures for the DLL. No callbacks, since the DLL does the file I/O and the
+    copying */
+CALLBACK incb, outcb;
+
+/* Need MIDIFILE structures for the DLL, one for each file */
+MIDIFILE in, out;
+
+/* What MidiCompactFile() did */
+MIDICOMPACT stats;
+
+
+
+
+/*********************************** main() ***********************************
+ * Program entry point. Calls the MIDIFILE.DLL function to compact a MIDI file, and prints what
+ * was done.
+ ****************************************************************************/
+
+int main(int argc, char *argv[], char *envp[])
+{
+    LONG result;
+    UCHAR buf[60];
+
+    /* If no filename args supplied by user, exit with usage info */
+    if ( argc < 3 )
+    {
+	 printf("This program rewrites a MIDI (sequencer) file in as few\r\n");
+	 printf("bytes as possible. It requires MIDIFILE.DLL to run.\r\n\r\n");
+	 printf("Syntax: MFCOMPACT.EXE [infile] [outfile] /K\r\n");
+	 printf("    where /K means keep Note Offs (ie, their release velocities)\r\n");
+	 exit(1);
+    }
+
+    stats.Flags = MIDICOMPACTALL;
+    if ( argc > 3 && (!strcmp(argv[3], "/K") || !strcmp(argv[3], "/k")) )
+    {
+	 stats.Flags &= ~MIDICOMPACTNOTEOFF;
+    }
+
+    in.Callbacks = &incb;
+    in.Handle = (MIDIHANDLE)argv[1];
+    out.Callbacks = &outcb;
+    out.Handle = (MIDIHANDLE)argv[2];
+
+    result = MidiCompactFile(&in, &out, &stats);
+    if (result)
+    {
+	 MidiGetErr(&in, result, &buf[0]);
+	 printf("%s", (char *)&buf[0]);
+	 exit(1);
+    }
+
+    printf("Read %lu bytes, wrote %lu bytes, saved %ld bytes (%.1f%%)\r\n",
+	 (unsigned long)stats.InSize, (unsigned long)stats.OutSize, (long)stats.InSize - (long)stats.OutSize,
+	 stats.InSize ? 100.0 * ((double)stats.InSize - stats.OutSize) / stats.InSize : 0.0);
+    printf("%lu Note Offs rewritten, %lu Controllers dropped, %lu SYSEX packets merged\r\n",
+	 (unsigned long)stats.NoteOffs, (unsigned long)stats.Controllers, (unsigned long)stats.Packets);
+
+    exit(0);
+}
@@ -2,11 +2,26 @@
  * mfread.c
  *
  * Reads in and displays information about a MIDI file, including all events in an Mtrk chunk.
+ * With --stats, it instead tallies the events of many MIDI files (eg, whole directories of them)
+ * read on worker threads, printing one line per file and then totals for all of them. (Not on
+ * OS/2, whose MIDIFILE.DLL has no MidiReadFiles()).
  * =========================================================================
  */
 
+#ifdef __OS2__
 #include <os2.h>
+#endif
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#ifndef __OS2__
+#include <strings.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 #include "midifile.h"
 
 /* Uncomment this define if you want standard C buffered file I/O */
@@ -14,6 +29,9 @@
 
 /* function definitions */
 VOID initfuncs(CHAR * fn);
+#ifndef __OS2__
+int stats_main(int argc, char *argv[]);
+#endif
 
 /* Need a CALLBACK structure for the DLL */
 CALLBACK cb;
@@ -59,7 +77,7 @@ UCHAR * strptrs[] = { "Note Off", "Note On", "Aftertouch", "Controller", "Progra
  * all of the real work of displaying info about the file.
  ****************************************************************************/
 
-main(int argc, char *argv[], char *envp[])
+int main(int argc, char *argv[], char *envp[])
 {
     LONG result;
     UCHAR buf[60];
@@ -71,9 +89,19 @@ main(int argc, char *argv[], char *envp[])
 	 printf("file. It requires MIDIFILE.DLL to run.\n\n");
 	 printf("Syntax: MFREAD.EXE [filename] /I\n");
 	 printf("    where /I means list info about the MTrk but not each event\r\n");
+#ifndef __OS2__
+	 printf("   or: MFREAD.EXE --stats [--csv] [--jobs=N] [file or directory]...\n");
+	 printf("    which tallies the events of each file (and each .mid file in each\n");
+	 printf("    directory), printing a JSON (or CSV) line per file, and then the totals\r\n");
+#endif
 	 exit(1);
     }
 
+#ifndef __OS2__
+    /* Batch statistics for many files */
+    if (!strcmp(argv[1], "--stats")) exit(stats_main(argc - 2, &argv[2]));
+#endif
+
     /* See if he wants compressed listing */
     if (argc > 2)
     {
@@ -112,7 +140,7 @@ main(int argc, char *argv[], char *envp[])
 VOID prtime(MIDIFILE * mf)
 {
     if (!compress)
-	printf("%8ld |",mf->Time);
+	printf("%8ld |",(long)mf->Time);
 }
 
 
@@ -286,7 +314,9 @@ LONG EXPENTRY sysexEvt(MIDIFILE * mf)
 	 /* NOTE: Normally, we would allocate some memory to contain the SYSEX message, and
 	     read it in via MidiReadBytes. We'd check the last loaded byte of this event, and if
 	     a 0xF7, then clear MIDISYSEX. Note that, by simply returning, the DLL will skip any
-	     bytes that we haven't read of this event. */
+	     bytes that we haven't read of this event. (Or, we could give the MIDIFILE an Arena
+	     before reading, and then the DLL would have already loaded the message at the
+	     METATXT's Ptr for us to keep). */
 
 	 /* Seek to and read the last byte */
 	 chr=0;
@@ -303,12 +333,12 @@ LONG EXPENTRY sysexEvt(MIDIFILE * mf)
 	      if (chr == 0xF7)
 	      {
 		   if (!compress)
-			printf("Last Packet | len=%-6ld|\r\n",(mf->EventSize)+2);
+			printf("Last Packet | len=%-6ld|\r\n",(long)(mf->EventSize)+2);
 	      }
 	      else
 	      {
 		   if (!compress)
-			printf("Packet %-5ld| len=%-6ld|\r\n", packet, (mf->EventSize)+2);
+			printf("Packet %-5ld| len=%-6ld|\r\n", (long)packet, (long)(mf->EventSize)+2);
 	      }
 	 }
 
@@ -321,13 +351,13 @@ LONG EXPENTRY sysexEvt(MIDIFILE * mf)
 		       a series of packets (ie, more SYSEX CONTINUE events to follow) */
 		   if (chr == 0xF7)
 		   {
-			printf("Sysex 0xF0  | len=%-6ld|\r\n",(mf->EventSize)+3); /* +3 to also include the 0xF0 status which
+			printf("Sysex 0xF0  | len=%-6ld|\r\n",(long)(mf->EventSize)+3); /* +3 to also include the 0xF0 status which
 										      is normally considered part of the SYSEX */
 		   }
 		   else
 		   {
 			packet=1;
-			printf("First Packet| len=%-6ld|\r\n",(mf->EventSize)+3);
+			printf("First Packet| len=%-6ld|\r\n",(long)(mf->EventSize)+3);
 		   }
 	      }
 	      else
@@ -340,7 +370,7 @@ LONG EXPENTRY sysexEvt(MIDIFILE * mf)
     {
 escd:
 	 if (!compress)
-	      printf("Escape 0x%02x | len=%-6ld|\r\n", chr, mf->EventSize+1);
+	      printf("Escape 0x%02x | len=%-6ld|\r\n", chr, (long)mf->EventSize+1);
 	 else
 	      counts[8]+=1;
 	 /* NOTE: The DLL will skip any bytes of this event that we don't read in, so let's just
@@ -372,7 +402,7 @@ LONG EXPENTRY metatext(MIDIFILE * mf)
     {
 	 if (mf->Status > 7) mf->Status=0;	/* I only know about 7 of the possible 15 */
 	 if (!compress)
-	      printf("%s| len=%-6ld|", &types[mf->Status][0], mf->EventSize);
+	      printf("%s| len=%-6ld|", &types[mf->Status][0], (long)mf->EventSize);
 	 else
 	      counts[9+mf->Status]+=1;
     }
@@ -384,14 +414,14 @@ LONG EXPENTRY metatext(MIDIFILE * mf)
 	 {
 	      case 0x7F:
 		   if (!compress)
-			printf("Proprietary | len=%-6ld|", mf->EventSize);
+			printf("Proprietary | len=%-6ld|", (long)mf->EventSize);
 		   else
 			counts[17]+=1;
 		   break;
 
 	      default:
 		   if (!compress)
-			printf("Unknown Meta| Type = 0x%02x, len=%ld", mf->Status, mf->EventSize);
+			printf("Unknown Meta| Type = 0x%02x, len=%ld", mf->Status, (long)mf->EventSize);
 		   else
 			counts[18]+=1;
 	 }
@@ -477,7 +507,7 @@ LONG EXPENTRY metaend(METAEND * mf)
     {
 	 for (i=0; i<23; i++)
 	 {
-	      printf("%-10ld %s events.\r\n", counts[i], strptrs[i]);
+	      printf("%-10ld %s events.\r\n", (long)counts[i], strptrs[i]);
 	 }
     }
 
@@ -519,7 +549,7 @@ LONG EXPENTRY metatempo(METATEMPO * mf)
     prtime((MIDIFILE *)mf);
 
     if (!compress)
-	 printf("Tempo       | BPM=%-6d| micros/quarter=%ld \r\n", mf->TempoBPM, mf->Tempo);
+	 printf("Tempo       | BPM=%-6d| micros/quarter=%ld \r\n", mf->TempoBPM, (long)mf->Tempo);
     else
 	 counts[20]+=1;
 
@@ -600,7 +630,7 @@ LONG EXPENTRY unknown(MIDIFILE * mf)
     str[4] = 0;
 
     printf("\r\n******************** Unknown ********************\r\n");
-    printf("     ID = %s    ChunkSize=%ld\r\n", &str[0], mf->ChunkSize);
+    printf("     ID = %s    ChunkSize=%ld\r\n", &str[0], (long)mf->ChunkSize);
 
     return(0);
 }
@@ -619,14 +649,16 @@ LONG EXPENTRY midi_open(MIDIFILE * mf)
 {
     /* Open the file. Store the handle in the MIDIFILE's Handle field, although this isn't required,
 	but it's a handy place to keep it. */
-    if ( !(mf->Handle=(ULONG)fopen(fname, "rb")) )
+    if ( !(mf->Handle=(MIDIHANDLE)fopen(fname, "rb")) )
     {
        printf("Can't open %s\r\n", fname);
        return(MIDIERRFILE);
     }
 
     /* Set the # of bytes to parse */
-    mf->FileSize = _filelength(_fileno((struct __file *)mf->Handle));
+    fseek((FILE *)mf->Handle, 0, SEEK_END);
+    mf->FileSize = ftell((FILE *)mf->Handle);
+    fseek((FILE *)mf->Handle, 0, SEEK_SET);
     return(0);
 }
 
@@ -644,7 +676,7 @@ LONG EXPENTRY midi_close(MIDIFILE * mf)
 	But, if any other subsequent errors occur, this gets called before the read operation
 	aborts. So, I can always be assured that the file handle gets closed, even if an error
 	occurs. */
-    fclose((struct __file *)mf->Handle);
+    fclose((FILE *)mf->Handle);
 
     return(0);
 }
@@ -661,7 +693,7 @@ LONG EXPENTRY midi_seek(MIDIFILE * mf, LONG amt, ULONG type)
 {
     /* NOTE: The DLL only ever passes a seek type of DosSeek's FILE_CURRENT, which
 	translates to SEEK_CUR for C/Set2 fseek(). */
-    if( fseek((struct __file *)mf->Handle, amt, SEEK_CUR) )
+    if( fseek((FILE *)mf->Handle, amt, SEEK_CUR) )
     {
        printf("Seek error");
     }
@@ -680,7 +712,7 @@ LONG EXPENTRY midi_seek(MIDIFILE * mf, LONG amt, ULONG type)
 
 LONG EXPENTRY midi_read(MIDIFILE * mf, UCHAR * buffer, ULONG count)
 {
-     if( fread(buffer, 1L, count, (struct __file *)mf->Handle) ) return(0);
+     if( fread(buffer, 1L, count, (FILE *)mf->Handle) ) return(0);
      return(MIDIERRREAD);
 }
 
@@ -714,7 +746,7 @@ VOID initfuncs(CHAR * fn)
     cb.ReadWriteMidi = 0;
     cb.SeekMidi = 0;
     cb.CloseMidi = 0;
-    mfs.Handle = (ULONG)fn;
+    mfs.Handle = (MIDIHANDLE)fn;
 #endif
 
     cb.UnknownChunk = unknown;
@@ -730,4 +762,509 @@ VOID initfuncs(CHAR * fn)
     cb.MetaText = metatext;
     cb.MetaEOT = metaend;
 }
-
\ No newline at end of file
+
+
+
+
+/* ============================== Batch statistics ============================== */
+
+#ifndef __OS2__
+
+/* The most files to read at once */
+#define MAXJOBS 256
+
+/* Each worker's output is put together here, and written out in one go when nearly full */
+#define OUTSIZE 65536
+
+/* Room left in the output buffer for the longest line we make */
+#define LINEROOM 16384
+
+/* NumTracks of this or more are tallied together */
+#define MAXTRKS 128
+
+/* What's tallied, per file, and per worker for all of its files */
+typedef struct _TALLY
+{
+    ULONG Files;		 /* Number of files read successfully */
+    ULONG Failed;		 /* Number of files that couldn't be read */
+    ULONG Counts[23];		 /* As counts[] (ie, strptrs[]) */
+    ULONG Formats[4];		 /* Files of Format 0, 1, 2, and any other */
+    ULONG Tracks[MAXTRKS + 1];	 /* Files with each NumTracks */
+    ULONG Tempos[256];		 /* Tempo events at each BPM */
+    ULONG TimeSigs[33][9];	 /* Time Signature events of each Nom and power of 2 Denom (with
+				    powers of 8 or more all in the last) */
+} TALLY;
+
+/* A worker. The MIDIFILE must be first, since the callbacks recast it to this */
+typedef struct _STATWORKER
+{
+    MIDIFILE  mf;
+    ULONG     Counts[23];	 /* The file being read */
+    ULONG     FirstTempo;	 /* Its first tempo, in micros per quarter */
+    UCHAR     FirstNom, FirstDenom; /* Its first Time Signature (Denom as a power of 2) */
+    UCHAR     GotTempo, GotTime; /* Set once FirstTempo, and FirstNom and FirstDenom, are */
+    TALLY     Total;		 /* All of the worker's files */
+    ULONG     OutLen;		 /* Number of bytes in Out */
+    CHAR      Out[OUTSIZE];
+} STATWORKER;
+
+/* The files to read */
+CHAR ** paths;
+ULONG	numpaths, maxpaths;
+
+/* Set for CSV lines instead of JSON */
+UCHAR	csv;
+
+/* Serializes the workers' writes to stdout */
+pthread_mutex_t outlock = PTHREAD_MUTEX_INITIALIZER;
+
+/* All workers share this */
+CALLBACK statcb;
+
+
+
+
+/******************************** add_path() *********************************
+ * Adds a copy of the filename fn to paths[]. Returns 0 if success, or -1 if out of memory.
+ **************************************************************************/
+
+int add_path(const char * fn)
+{
+    CHAR ** ptr;
+
+    if (numpaths >= maxpaths)
+    {
+	 maxpaths = (maxpaths) ? maxpaths << 1 : 1024;
+	 if ( !(ptr = (CHAR **)realloc(paths, maxpaths * sizeof(CHAR *))) ) return(-1);
+	 paths = ptr;
+    }
+    if ( !(paths[numpaths] = strdup(fn)) ) return(-1);
+    numpaths++;
+    return(0);
+}
+
+
+
+
+/********************************* add_dir() *********************************
+ * Adds each regular file whose name ends in .mid or .midi, in the directory dir and all of its
+ * subdirectories, to paths[]. Names starting with '.' are skipped. Returns 0 if success, or -1
+ * if a directory can't be read or out of memory.
+ **************************************************************************/
+
+int add_dir(const char * dir)
+{
+    struct dirent * de;
+    struct stat st;
+    const char * ext;
+    char * fn;
+    DIR * dp;
+    int result, type;
+
+    if ( !(dp = opendir(dir)) ) return(-1);
+
+    result = 0;
+    while ( !result && (de = readdir(dp)) )
+    {
+	 if (de->d_name[0] == '.') continue;
+
+	 if ( !(fn = (char *)malloc(strlen(dir) + strlen(de->d_name) + 2)) )
+	 {
+	      result = -1;
+	      break;
+	 }
+	 sprintf(fn, "%s/%s", dir, de->d_name);
+
+	 /* Most systems say what the entry is, which saves a stat() of each one */
+	 type = DT_UNKNOWN;
+#ifdef _DIRENT_HAVE_D_TYPE
+	 type = de->d_type;
+#endif
+	 if (type == DT_UNKNOWN)
+	 {
+	      if (lstat(fn, &st))
+		   type = DT_UNKNOWN;
+	      else if (S_ISDIR(st.st_mode))
+		   type = DT_DIR;
+	      else if (S_ISREG(st.st_mode))
+		   type = DT_REG;
+	 }
+
+	 if (type == DT_DIR)
+	      result = add_dir(fn);
+	 else if ( type == DT_REG && (ext = strrchr(de->d_name, '.')) &&
+		   (!strcasecmp(ext, ".mid") || !strcasecmp(ext, ".midi")) )
+	      result = add_path(fn);
+
+	 free(fn);
+    }
+
+    closedir(dp);
+    return(result);
+}
+
+
+
+
+/******************************** flush_out() ********************************
+ * Writes out a worker's output buffer.
+ **************************************************************************/
+
+VOID flush_out(STATWORKER * wkr)
+{
+    if (wkr->OutLen)
+    {
+	 pthread_mutex_lock(&outlock);
+	 fwrite(&wkr->Out[0], 1, wkr->OutLen, stdout);
+	 pthread_mutex_unlock(&outlock);
+	 wkr->OutLen = 0;
+    }
+}
+
+
+
+
+/********************************* put_str() *********************************
+ * Adds the string str to a worker's output, quoted for JSON or CSV. Characters that would
+ * need escaping are replaced with '?' (as are any past LINEROOM / 2 of them), so the line can't
+ * overflow.
+ **************************************************************************/
+
+VOID put_str(STATWORKER * wkr, const CHAR * str)
+{
+    register CHAR * ptr = &wkr->Out[wkr->OutLen];
+    register ULONG i;
+    register UCHAR chr;
+
+    *ptr++ = '"';
+    for (i = 0; (chr = (UCHAR)str[i]) && i < LINEROOM / 2; i++)
+    {
+	 *ptr++ = (chr < 0x20 || chr == '"' || chr == '\\' || chr == 0x7F) ? '?' : chr;
+    }
+    *ptr++ = '"';
+    wkr->OutLen = ptr - &wkr->Out[0];
+}
+
+
+
+
+/********************************* stats_done() *******************************
+ * Called by MidiReadFiles() after each file. Adds its line to the worker's output, adds its
+ * tallies to the worker's totals, and then clears them for the next file.
+ **************************************************************************/
+
+LONG EXPENTRY stats_done(MIDIBATCH * batch, MIDIFILE * mf, ULONG item, LONG result)
+{
+    register STATWORKER * wkr = (STATWORKER *)mf;
+    register ULONG i;
+    UCHAR err[60];
+    CHAR * ptr;
+
+    if (OUTSIZE - wkr->OutLen < LINEROOM) flush_out(wkr);
+
+    if (!csv) wkr->OutLen += sprintf(&wkr->Out[wkr->OutLen], "{\"file\":");
+    put_str(wkr, batch->Paths[item]);
+    ptr = &wkr->Out[wkr->OutLen];
+
+    if (result)
+    {
+	 wkr->Total.Failed++;
+	 MidiGetErr(mf, result, &err[0]);
+	 if ( (i = strcspn((char *)&err[0], "\r\n")) ) err[i] = 0;
+	 if (!err[0]) sprintf((char *)&err[0], "App error %ld", (long)result);
+	 ptr += sprintf(ptr, (csv) ? ",%ld" : ",\"error\":%ld,\"message\":", (long)result);
+	 wkr->OutLen = ptr - &wkr->Out[0];
+	 if (!csv) put_str(wkr, (CHAR *)&err[0]);
+	 ptr = &wkr->Out[wkr->OutLen];
+	 ptr += sprintf(ptr, (csv) ? ",,,,,,,,,,,,,,,,,,,,,,,,,,,,\n" : "}\n");
+    }
+    else
+    {
+	 wkr->Total.Files++;
+	 wkr->Total.Formats[(mf->Format < 3) ? mf->Format : 3]++;
+	 wkr->Total.Tracks[(mf->NumTracks < MAXTRKS) ? mf->NumTracks : MAXTRKS]++;
+
+	 ptr += sprintf(ptr, (csv) ? ",0,%u,%u,%u," : ",\"error\":0,\"format\":%u,\"tracks\":%u,\"division\":%u,\"tempo\":",
+		mf->Format, mf->NumTracks, mf->Division);
+
+	 /* A file with no Tempo or Time Signature gets null (or an empty CSV field), rather than
+	    the 120 BPM 4/4 that a player would assume, so that it can be told apart */
+	 if (wkr->GotTempo)
+	      ptr += sprintf(ptr, "%lu", (unsigned long)wkr->FirstTempo);
+	 else if (!csv)
+	      ptr += sprintf(ptr, "null");
+	 ptr += sprintf(ptr, (csv) ? "," : ",\"timesig\":");
+	 if (wkr->GotTime)
+	 {
+	      if (wkr->FirstDenom < 8)
+		   ptr += sprintf(ptr, (csv) ? "%u/%u" : "\"%u/%u\"", wkr->FirstNom, 1 << wkr->FirstDenom);
+	      else
+		   ptr += sprintf(ptr, (csv) ? "%u/2^%u" : "\"%u/2^%u\"", wkr->FirstNom, wkr->FirstDenom);
+	 }
+	 else if (!csv)
+	      ptr += sprintf(ptr, "null");
+	 if (!csv) ptr += sprintf(ptr, ",\"counts\":[");
+
+	 for (i=0; i<23; i++)
+	 {
+	      ptr += sprintf(ptr, "%s%lu", (csv || i) ? "," : "", (unsigned long)wkr->Counts[i]);
+	      wkr->Total.Counts[i] += wkr->Counts[i];
+	 }
+	 ptr += sprintf(ptr, (csv) ? "\n" : "]}\n");
+    }
+    wkr->OutLen = ptr - &wkr->Out[0];
+
+    memset(&wkr->Counts[0], 0, sizeof(wkr->Counts));
+    wkr->GotTempo = wkr->GotTime = 0;
+    mf->Format = mf->NumTracks = mf->Division = 0;
+
+    return(0);
+}
+
+
+
+
+/***************************** The stats callbacks ******************************
+ * Tally each kind of event just as the /I listing does, but in the STATWORKER, and without
+ * printing anything. The data of SYSEX and Meta-Events isn't read (except to tell an ESCAPE
+ * from a SYSEX CONTINUE), so the DLL skips it.
+ **************************************************************************/
+
+LONG EXPENTRY stats_standard(MIDIFILE * mf)
+{
+    ((STATWORKER *)mf)->Counts[((mf->Status >> 4) & 0x07)]++;
+    return(0);
+}
+
+LONG EXPENTRY stats_sysex(MIDIFILE * mf)
+{
+    UCHAR chr;
+    LONG result;
+
+    if (mf->Status == 0xF0)
+    {
+	 ((STATWORKER *)mf)->Counts[7]++;
+	 return(0);
+    }
+
+    if ( (result = MidiReadBytes(mf, &chr, 1)) ) return(result);
+
+    /* Not a SYSEX CONTINUE, so an ESCAPE */
+    if ( !(mf->Flags & MIDISYSEX) || (chr > 0x7F && chr != 0xF7) ) ((STATWORKER *)mf)->Counts[8]++;
+    return(0);
+}
+
+LONG EXPENTRY stats_text(MIDIFILE * mf)
+{
+    register ULONG i;
+
+    if (mf->Status < 0x10)
+	 i = 9 + ((mf->Status > 7) ? 0 : mf->Status);
+    else
+	 i = (mf->Status == 0x7F) ? 17 : 18;
+    ((STATWORKER *)mf)->Counts[i]++;
+    return(0);
+}
+
+LONG EXPENTRY stats_key(METAKEY * mf)
+{
+    ((STATWORKER *)mf)->Counts[19]++;
+    return(0);
+}
+
+LONG EXPENTRY stats_tempo(METATEMPO * mf)
+{
+    register STATWORKER * wkr = (STATWORKER *)mf;
+
+    wkr->Counts[20]++;
+    wkr->Total.Tempos[mf->TempoBPM]++;
+    if (!wkr->GotTempo)
+    {
+	 wkr->FirstTempo = mf->Tempo;
+	 wkr->GotTempo = 1;
+    }
+    return(0);
+}
+
+LONG EXPENTRY stats_time(METATIME * mf)
+{
+    register STATWORKER * wkr = (STATWORKER *)mf;
+
+    /* Without MIDIDENOM, Denom is the power of 2. Any power of 8 or more (ie, a denominator of
+	256 or more, which no real file has) is tallied in its own bucket */
+    wkr->Counts[21]++;
+    wkr->Total.TimeSigs[(mf->Nom > 32) ? 0 : mf->Nom][(mf->Denom > 8) ? 8 : mf->Denom]++;
+    if (!wkr->GotTime)
+    {
+	 wkr->FirstNom = mf->Nom;
+	 wkr->FirstDenom = mf->Denom;
+	 wkr->GotTime = 1;
+    }
+    return(0);
+}
+
+LONG EXPENTRY stats_smpte(METASMPTE * mf)
+{
+    ((STATWORKER *)mf)->Counts[22]++;
+    return(0);
+}
+
+
+
+
+/******************************** print_totals() *******************************
+ * Prints the totals for all files, as one JSON line. For CSV, that goes to stderr, so as not to
+ * mix with the CSV lines.
+ **************************************************************************/
+
+VOID print_totals(TALLY * tot, FILE * out)
+{
+    register ULONG i, j;
+    register const CHAR * sep;
+
+    fprintf(out, "{\"totals\":{\"files\":%lu,\"failed\":%lu,\"events\":{",
+	    (unsigned long)tot->Files, (unsigned long)tot->Failed);
+    for (i=0; i<23; i++)
+    {
+	 fprintf(out, "%s\"%s\":%lu", (i) ? "," : "", strptrs[i], (unsigned long)tot->Counts[i]);
+    }
+
+    fprintf(out, "},\"formats\":{\"0\":%lu,\"1\":%lu,\"2\":%lu,\"other\":%lu},\"tracks\":{",
+	    (unsigned long)tot->Formats[0], (unsigned long)tot->Formats[1],
+	    (unsigned long)tot->Formats[2], (unsigned long)tot->Formats[3]);
+    for (sep="", i=0; i<=MAXTRKS; i++)
+    {
+	 if (tot->Tracks[i])
+	 {
+	      fprintf(out, "%s\"%lu%s\":%lu", sep, (unsigned long)i, (i == MAXTRKS) ? "+" : "", (unsigned long)tot->Tracks[i]);
+	      sep = ",";
+	 }
+    }
+
+    fprintf(out, "},\"bpm\":{");
+    for (sep="", i=0; i<256; i++)
+    {
+	 if (tot->Tempos[i])
+	 {
+	      fprintf(out, "%s\"%lu\":%lu", sep, (unsigned long)i, (unsigned long)tot->Tempos[i]);
+	      sep = ",";
+	 }
+    }
+
+    /* Nom 0 also counts any over 32, and a denominator of 256 also counts any bigger */
+    fprintf(out, "},\"timesigs\":{");
+    for (sep="", i=0; i<33; i++)
+    {
+	 for (j=0; j<9; j++)
+	 {
+	      if (tot->TimeSigs[i][j])
+	      {
+		   fprintf(out, "%s\"%lu/%u%s\":%lu", sep, (unsigned long)i, 1 << j, (j == 8) ? "+" : "",
+			   (unsigned long)tot->TimeSigs[i][j]);
+		   sep = ",";
+	      }
+	 }
+    }
+    fprintf(out, "}}}\n");
+}
+
+
+
+
+/******************************** stats_main() *******************************
+ * Does --stats. argv[] is the options and files/directories after it. Returns the exit code
+ * (0 if every file was read, 1 if any couldn't be, or 2 for bad args).
+ **************************************************************************/
+
+int stats_main(int argc, char *argv[])
+{
+    STATWORKER * wkrs;
+    MIDIFILE * files[MAXJOBS];
+    TALLY tot;
+    MIDIBATCH batch;
+    struct stat st;
+    ULONG i, j, num;
+    long n;
+
+    num = 0;
+
+    for (i=0; i<(ULONG)argc; i++)
+    {
+	 if (!strcmp(argv[i], "--csv"))
+	      csv = 1;
+	 else if (!strncmp(argv[i], "--jobs=", 7))
+	      num = atoi(&argv[i][7]);
+	 else if (!stat(argv[i], &st) && S_ISDIR(st.st_mode))
+	 {
+	      if ( add_dir(argv[i]) )
+	      {
+		   fprintf(stderr, "Can't read directory %s\n", argv[i]);
+		   return(2);
+	      }
+	 }
+	 else if ( add_path(argv[i]) )
+	 {
+	      fprintf(stderr, "Out of memory\n");
+	      return(2);
+	 }
+    }
+
+    /* By default, a few files per CPU, since most of the time is spent waiting for them */
+    if (!num)
+    {
+	 if ( (n = sysconf(_SC_NPROCESSORS_ONLN)) < 1 ) n = 1;
+	 num = n * 4;
+    }
+    if (num > MAXJOBS) num = MAXJOBS;
+
+    if ( !(wkrs = (STATWORKER *)calloc(num, sizeof(STATWORKER))) )
+    {
+	 fprintf(stderr, "Out of memory\n");
+	 return(2);
+    }
+
+    statcb.StandardEvt = stats_standard;
+    statcb.SysexEvt = stats_sysex;
+    statcb.MetaText = stats_text;
+    statcb.MetaKeySig = stats_key;
+    statcb.MetaTempo = stats_tempo;
+    statcb.MetaTimeSig = stats_time;
+    statcb.MetaSMPTE = stats_smpte;
+    for (i=0; i<num; i++)
+    {
+	 wkrs[i].mf.Callbacks = &statcb;
+	 files[i] = &wkrs[i].mf;
+    }
+
+    if (csv)
+    {
+	 printf("file,error,format,tracks,division,tempo,timesig");
+	 for (i=0; i<23; i++) printf(",%s", strptrs[i]);
+	 printf("\n");
+    }
+
+    memset(&batch, 0, sizeof(batch));
+    batch.Paths = (const CHAR **)paths;
+    batch.Count = numpaths;
+    batch.NumFiles = num;
+    batch.Files = &files[0];
+    batch.DoneFile = stats_done;
+    MidiReadFiles(&batch);
+
+    /* Add up the workers' totals */
+    memset(&tot, 0, sizeof(tot));
+    for (i=0; i<num; i++)
+    {
+	 flush_out(&wkrs[i]);
+	 for (j=0; j<sizeof(TALLY)/sizeof(ULONG); j++)
+	 {
+	      ((ULONG *)&tot)[j] += ((ULONG *)&wkrs[i].Total)[j];
+	 }
+    }
+    print_totals(&tot, (csv) ? stderr : stdout);
+
+    free(wkrs);
+    return( (batch.Failed) ? 1 : 0 );
+}
+
+#endif /* __OS2__ */
@@ -0,0 +1,413 @@
+/* ===========================================================================
+ * mfstress.c
+ *
+ * Checks that MIDIFILE.DLL can read and write many MIDI files at once, on many threads. Each
+ * thread repeatedly writes a MIDI file of its own (with MidiWriteFile()), and reads it back (with
+ * MidiReadFile()), checking that it gets back exactly what it wrote. Every thread's file has
+ * different events, so if the DLL ever mixed up two threads' state, the check would fail.
+ *
+ * All of the threads share the one read CALLBACK and the one write CALLBACK. Each has its own
+ * MIDIFILE, which is the first field of its JOB, so that the callbacks can recast the MIDIFILE
+ * (via MIDIAPPFILE()) to get at the rest of their thread's data. The threads take turns at the
+ * engine's different ways of doing things, so that those get stressed too:
+ *
+ *   0: Writes a Format 0 file, and reads it through the DLL's buffer.
+ *   1: Writes a Format 0 file, and reads it with MIDIMMAP.
+ *   2: Writes a Format 1 file with MIDIPARALLEL (so that the write itself uses several
+ *	threads), and reads it with a MIDIARENA.
+ *   3: Writes a Format 1 file with MIDIHOLD, and reads it with MIDIMMAP and a MIDIARENA.
+ * =========================================================================
+ */
+
+#ifdef __OS2__
+#include <os2.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "midifile.h"
+
+
+/* How many events each MTrk has (not counting the End Of Track) */
+#define NUMEVENTS 3000
+
+/* How many MTrks a Format 1 file has */
+#define NUMTRKS 2
+
+/* Never start more threads than this */
+#define MAXTHREADS 4096
+
+/* One thread's data */
+typedef struct _JOB
+{
+    MIDIFILE  mf;	 /* Must be first, so the callbacks can recast it to the JOB */
+    ULONG     Num;	 /* Which thread */
+    ULONG     Next[NUMTRKS]; /* Next event to write or read, in each MTrk. A MIDIPARALLEL write
+			    calls each MTrk's callbacks on a different thread, so each MTrk
+			    needs its own */
+    ULONG     Errors;	 /* How many times the events read back differed */
+    MIDIARENA Arena;	 /* For reading with a MIDIARENA */
+    LONG      Result;	 /* The DLL's error, if any */
+    CHAR      Name[32];  /* Its Track Name */
+    CHAR      File[300]; /* Its filename */
+    pthread_t Thread;
+} JOB;
+
+/* The callbacks for writing, and reading. Shared by all threads */
+CALLBACK wcb, rcb;
+
+/* The directory for the files */
+CHAR * Dir = ".";
+
+/* How many times each thread writes and reads its file */
+ULONG Repeats = 10;
+
+
+
+
+/********************************* job_of() **********************************
+ * Returns the JOB whose MIDIFILE a callback got (which, for a MIDIPARALLEL write, is the DLL's
+ * copy of it).
+ **************************************************************************/
+
+JOB * job_of(VOID * mf)
+{
+    return( (JOB *)MIDIAPPFILE(mf) );
+}
+
+
+
+
+/******************************** make_event() ********************************
+ * Makes up the event numbered num in a JOB's MTrk numbered trk, and stores it in a MIDIEVT.
+ * Each JOB's (and MTrk's) events differ. Every 100th event is a SYSEX, whose length is in
+ * Data1.
+ **************************************************************************/
+
+VOID make_event(JOB * job, UCHAR trk, ULONG num, MIDIEVT * evt)
+{
+    register ULONG val = job->Num * 7 + trk * 13 + num;
+
+    evt->Time = num * (1 + job->Num % 5) + (num & 3);
+    evt->Time -= evt->Time % 4;
+    if ( !(num % 100) )
+    {
+	evt->Status = 0xF0;
+	evt->Data1 = (UCHAR)(1 + val % 40);
+	evt->Data2 = 0;
+	return;
+    }
+    switch (num & 3)
+    {
+	case 0:
+	    evt->Status = 0xC0 | (val & 0x0F);
+	    evt->Data1 = (UCHAR)(val & 0x7F);
+	    evt->Data2 = 0xFF;
+	    break;
+	case 1:
+	    evt->Status = 0x90 | (job->Num & 0x0F);
+	    evt->Data1 = (UCHAR)(val & 0x7F);
+	    evt->Data2 = (UCHAR)(1 + val % 127);
+	    break;
+	case 2:
+	    evt->Status = 0x80 | (job->Num & 0x0F);
+	    evt->Data1 = (UCHAR)((val - 1) & 0x7F);
+	    evt->Data2 = 64;
+	    break;
+	default:
+	    evt->Status = 0xB0 | (val & 0x0F);
+	    evt->Data1 = (UCHAR)(val % 120);
+	    evt->Data2 = (UCHAR)(job->Num & 0x7F);
+    }
+}
+
+
+
+
+/******************************** make_sysex() ********************************
+ * Makes up the data bytes (after the 0xF0) of the SYSEX that is a JOB's event numbered num in
+ * MTrk trk, and stores them in buf. Returns how many.
+ **************************************************************************/
+
+ULONG make_sysex(JOB * job, UCHAR trk, ULONG num, UCHAR * buf)
+{
+    register ULONG i, len;
+    MIDIEVT evt;
+
+    make_event(job, trk, num, &evt);
+    len = evt.Data1;
+    for (i = 0; i < len - 1; i++) buf[i] = (UCHAR)((job->Num + trk + num + i) & 0x7F);
+    buf[i] = 0xF7;
+    return(len);
+}
+
+
+
+
+/***************************** The write callbacks *****************************
+ * w_metaseq() writes a Sequence Number (the JOB's Num) and Track Name (its Name) first.
+ * w_standardEvt() then supplies each event made up by make_event(), and w_sysexEvt() writes
+ * the data of the SYSEX ones.
+ **************************************************************************/
+
+LONG EXPENTRY w_metaseq(METASEQ * mf)
+{
+    mf->Type = 0xFF;
+    mf->WriteType = 0x00;
+    mf->SeqNum = (USHORT)job_of(mf)->Num;
+    mf->NamePtr = (UCHAR *)&job_of(mf)->Name[0];
+    return(0);
+}
+
+LONG EXPENTRY w_standardEvt(MIDIFILE * mf)
+{
+    register JOB * job = job_of(mf);
+    register ULONG * next = &job->Next[mf->TrackNum];
+    MIDIEVT evt;
+
+    if (*next >= NUMEVENTS)
+    {
+	mf->Status = 0xFF;
+	mf->Data[0] = 0x2F;
+	return(0);
+    }
+
+    make_event(job, mf->TrackNum, (*next)++, &evt);
+    mf->Time = evt.Time;
+    mf->Status = evt.Status;
+    if (evt.Status == 0xF0)
+    {
+	/* Have the DLL call w_sysexEvt() for the data */
+	mf->EventSize = evt.Data1;
+	((METATXT *)mf)->Ptr = 0;
+    }
+    else
+    {
+	mf->Data[0] = evt.Data1;
+	mf->Data[1] = evt.Data2;
+    }
+    return(0);
+}
+
+LONG EXPENTRY w_sysexEvt(MIDIFILE * mf)
+{
+    UCHAR buf[64];
+    ULONG len;
+
+    len = make_sysex(job_of(mf), mf->TrackNum, job_of(mf)->Next[mf->TrackNum] - 1, &buf[0]);
+    return( MidiWriteBytes(mf, &buf[0], len) );
+}
+
+
+
+
+/***************************** The read callbacks ******************************
+ * Each compares what's read with what the JOB wrote, counting any difference in the JOB's
+ * Errors. r_standardEvt() gets MIDI events, r_sysexEvt() SYSEX, r_metaseq() the Sequence
+ * Number, r_metaText() the Track Name, and r_metaEOT() the End Of Track. With a MIDIARENA, the
+ * DLL has already read the data of SYSEX and the Track Name, and get_data() just looks at it.
+ **************************************************************************/
+
+LONG get_data(MIDIFILE * mf, UCHAR * buf, ULONG len)
+{
+    if (mf->Arena)
+    {
+	memcpy(buf, ((METATXT *)mf)->Ptr, len);
+	return(0);
+    }
+    return( MidiReadBytes(mf, buf, len) );
+}
+
+LONG EXPENTRY r_standardEvt(MIDIFILE * mf)
+{
+    register JOB * job = job_of(mf);
+    MIDIEVT evt;
+
+    make_event(job, mf->TrackNum, job->Next[mf->TrackNum]++, &evt);
+    if ( mf->Time != evt.Time || mf->Status != evt.Status || mf->Data[0] != evt.Data1 ||
+	 mf->Data[1] != evt.Data2 ) job->Errors++;
+    return(0);
+}
+
+LONG EXPENTRY r_sysexEvt(MIDIFILE * mf)
+{
+    register JOB * job = job_of(mf);
+    register ULONG num = job->Next[mf->TrackNum]++;
+    UCHAR buf[64], expect[64];
+    MIDIEVT evt;
+    ULONG len;
+    LONG result;
+
+    make_event(job, mf->TrackNum, num, &evt);
+    len = make_sysex(job, mf->TrackNum, num, &expect[0]);
+    if ( mf->Time != evt.Time || mf->Status != 0xF0 || (ULONG)mf->EventSize != len )
+    {
+	job->Errors++;
+	return(0);
+    }
+    if ( (result = get_data(mf, &buf[0], len)) ) return(result);
+    if ( memcmp(&buf[0], &expect[0], len) ) job->Errors++;
+    return(0);
+}
+
+LONG EXPENTRY r_metaseq(METASEQ * mf)
+{
+    if ( mf->SeqNum != (USHORT)job_of(mf)->Num ) job_of(mf)->Errors++;
+    return(0);
+}
+
+LONG EXPENTRY r_metaText(METATXT * mf)
+{
+    register JOB * job = job_of(mf);
+    UCHAR buf[32];
+    ULONG len;
+    LONG result;
+
+    len = strlen(&job->Name[0]);
+    if ( mf->Type != 0x03 || (ULONG)mf->EventSize != len )
+    {
+	job->Errors++;
+	return(0);
+    }
+    if ( (result = get_data((MIDIFILE *)mf, &buf[0], len)) ) return(result);
+    if ( memcmp(&buf[0], &job->Name[0], len) ) job->Errors++;
+    return(0);
+}
+
+LONG EXPENTRY r_metaEOT(MIDIFILE * mf)
+{
+    if ( job_of(mf)->Next[mf->TrackNum] != NUMEVENTS ) job_of(mf)->Errors++;
+    return(0);
+}
+
+
+
+
+/********************************* run_job() **********************************
+ * A thread. Writes and reads back its JOB's file, Repeats times, and then deletes it. Stops
+ * at the first error from the DLL, and leaves it in the JOB's Result.
+ **************************************************************************/
+
+VOID * run_job(VOID * arg)
+{
+    register JOB * job = (JOB *)arg;
+    register MIDIFILE * mf = &job->mf;
+    ULONG i, t, mode, numtrks;
+
+    mode = job->Num & 3;
+    numtrks = (mode >= 2) ? NUMTRKS : 1;
+
+    for (i = 0; i < Repeats; i++)
+    {
+	memset(mf, 0, sizeof(MIDIFILE));
+	mf->Callbacks = &wcb;
+	mf->Handle = (MIDIHANDLE)&job->File[0];
+	mf->Format = (numtrks > 1) ? 1 : 0;
+	mf->NumTracks = (USHORT)numtrks;
+	mf->Division = 96;
+	if (mode == 2) mf->Flags = MIDIPARALLEL;
+	if (mode == 3) mf->Flags = MIDIHOLD;
+	memset(&job->Next[0], 0, sizeof(job->Next));
+	if ( (job->Result = MidiWriteFile(mf)) ) break;
+
+	memset(mf, 0, sizeof(MIDIFILE));
+	mf->Callbacks = &rcb;
+	mf->Handle = (MIDIHANDLE)&job->File[0];
+	if (mode & 1) mf->Flags = MIDIMMAP;
+	if (mode >= 2) mf->Arena = &job->Arena;
+	memset(&job->Next[0], 0, sizeof(job->Next));
+	job->Result = MidiReadFile(mf);
+	MidiFreeArena(&job->Arena);
+	if (job->Result) break;
+	if ( mf->Format != (numtrks > 1) || mf->NumTracks != numtrks || mf->Division != 96 )
+	    job->Errors++;
+	for (t = 0; t < numtrks; t++)
+	{
+	    if (job->Next[t] != NUMEVENTS) job->Errors++;
+	}
+    }
+
+    unlink(&job->File[0]);
+    return(0);
+}
+
+
+
+
+/*********************************** main() ***********************************
+ * Program entry point. Starts the threads, waits for them all to finish, and reports how
+ * many had errors.
+ ****************************************************************************/
+
+int main(int argc, char *argv[], char *envp[])
+{
+    JOB * jobs;
+    ULONG i, num, started, bad;
+    struct timespec start, end;
+    UCHAR buf[60];
+
+    num = (argc > 1) ? (ULONG)strtoul(argv[1], 0, 10) : 200;
+    if (argc > 2) Repeats = (ULONG)strtoul(argv[2], 0, 10);
+    if (argc > 3) Dir = argv[3];
+    if ( !num || num > MAXTHREADS || !Repeats )
+    {
+	 printf("This program writes and reads back MIDI files on many threads at once,\r\n");
+	 printf("checking that none of them get mixed up. It requires MIDIFILE.DLL to run.\r\n\r\n");
+	 printf("Syntax: MFSTRESS.EXE [threads (200)] [repeats (10)] [directory (.)]\r\n");
+	 exit(1);
+    }
+
+    wcb.MetaSeqNum = (CALL)w_metaseq;
+    wcb.StandardEvt = (CALL)w_standardEvt;
+    wcb.SysexEvt = (CALL)w_sysexEvt;
+
+    rcb.StandardEvt = (CALL)r_standardEvt;
+    rcb.SysexEvt = (CALL)r_sysexEvt;
+    rcb.MetaSeqNum = (CALL)r_metaseq;
+    rcb.MetaText = (CALL)r_metaText;
+    rcb.MetaEOT = (CALL)r_metaEOT;
+
+    if ( !(jobs = (JOB *)calloc(num, sizeof(JOB))) )
+    {
+	printf("Out of memory\r\n");
+	exit(1);
+    }
+
+    printf("Writing and reading %lu files, %lu times each, on %lu threads...\r\n",
+	(unsigned long)num, (unsigned long)Repeats, (unsigned long)num);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (started = 0; started < num; started++)
+    {
+	jobs[started].Num = started;
+	sprintf(&jobs[started].Name[0], "Thread %lu", (unsigned long)started);
+	snprintf(&jobs[started].File[0], sizeof(jobs[started].File), "%s/mfstress%lu.mid", Dir, (unsigned long)started);
+	if ( pthread_create(&jobs[started].Thread, 0, run_job, &jobs[started]) ) break;
+    }
+    for (i = 0; i < started; i++) pthread_join(jobs[i].Thread, 0);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    bad = 0;
+    for (i = 0; i < started; i++)
+    {
+	if (jobs[i].Result)
+	{
+	    MidiGetErr(&jobs[i].mf, jobs[i].Result, &buf[0]);
+	    printf("Thread %lu: %s", (unsigned long)i, (char *)&buf[0]);
+	}
+	if (jobs[i].Errors)
+	    printf("Thread %lu: %lu events read back wrong\r\n", (unsigned long)i, (unsigned long)jobs[i].Errors);
+	if (jobs[i].Result || jobs[i].Errors) bad++;
+    }
+
+    printf("%lu threads ran (%lu failed) in %.2f seconds\r\n", (unsigned long)started, (unsigned long)bad,
+	(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+
+    free(jobs);
+    exit( (bad || started < num) ? 1 : 0 );
+}
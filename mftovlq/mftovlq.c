@@ -3,15 +3,42 @@
  *
  * Converts ULONGs entered by the user into the variable length quantity equivalent and
  * displays that.
+ *
+ * With an arg of "-" (or "-b"), the ULONGs are instead read from stdin (separated by blanks,
+ * commas, or newlines), and their variable length quantities written to stdout, one line of hex
+ * bytes per ULONG (or for "-b", the bytes themselves). They're converted a batch at a time, so
+ * this can sit in a pipe that's feeding millions of them.
  * =========================================================================
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#if defined(__OS2__) || defined(_WIN32)
+#include <io.h>
+#include <fcntl.h>
+#endif
+#ifdef __OS2__
 #include <os2.h>
+#endif
 
 #include "midifile.h"
 
 
+/* How many ULONGs to convert at a time when streaming */
+#define BATCHVALS 16384
+
+/* Buffered stdin, and the ULONGs read from it */
+UCHAR inbuf[65536];
+ULONG inpos, inlen;
+ULONG vals[BATCHVALS];
+
+/* What's written to stdout. A line of text is at most 3 chars for each of 4 bytes */
+UCHAR outbuf[BATCHVALS * 12];
+
+/* For formatting hex bytes */
+static const CHAR hexchrs[] = "0123456789abcdef";
+
+
 
 /* *************************** hex2bin() ******************************
  * Convert an ascii hex numeric char (ie, '0' to '9', 'A' to 'F') to its binary equivalent.
@@ -27,16 +54,158 @@ USHORT hex2bin(UCHAR c)
 
 
 
+/* *************************** nextchr() ******************************
+ * Returns the next char from stdin, or EOF.
+ ******************************************************************* */
+
+int nextchr(VOID)
+{
+   if (inpos >= inlen)
+   {
+      if ( !(inlen = fread(&inbuf[0], 1, sizeof(inbuf), stdin)) ) return(EOF);
+      inpos = 0;
+   }
+   return(inbuf[inpos++]);
+}
+
+
+
+/* *************************** readvals() ******************************
+ * Reads up to BATCHVALS ULONGs (decimal, or hex with a leading 0x) from stdin into vals[].
+ * Returns how many, or 0 at the end of stdin. total is how many were read before these, for
+ * an error message. Exits if there's something that isn't a ULONG.
+ ******************************************************************* */
+
+ULONG readvals(ULONG total)
+{
+   register ULONG n = 0;
+   register ULONG conv, digits, hex;
+   register int c;
+
+   while (n < BATCHVALS)
+   {
+      /* Skip the separators */
+      do
+      {
+	 c = nextchr();
+      } while (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == ',');
+      if (c == EOF) break;
+
+      /* Hex, or decimal? */
+      conv = digits = hex = 0;
+      if (c == '0')
+      {
+	 c = nextchr();
+	 if (c == 'x' || c == 'X')
+	 {
+	    hex = 1;
+	    c = nextchr();
+	 }
+	 else
+	    digits = 1;
+      }
+
+      for (;; c = nextchr())
+      {
+	 if (c >= '0' && c <= '9')
+	    conv = hex ? (conv << 4) | (c - '0') : conv * 10 + (c - '0');
+	 else if (hex && ((c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F')))
+	    conv = (conv << 4) | hex2bin((UCHAR)c);
+	 else
+	    break;
+
+	 /* Checking each digit catches overflow before conv can wrap */
+	 if (conv > MIDIVLQMAX)
+	 {
+	    digits = 0;
+	    break;
+	 }
+	 digits++;
+      }
+
+      /* It must end with a separator */
+      if (!digits || (c != EOF && c != ' ' && c != '\t' && c != '\r' && c != '\n' && c != ','))
+      {
+	 fprintf(stderr, "ULONG #%lu isn't a number from 0 to 0x%08x\r\n", (unsigned long)(total + n + 1), MIDIVLQMAX);
+	 exit(1);
+      }
+
+      vals[n++] = conv;
+   }
+
+   return(n);
+}
+
+
+
+/* *************************** stream() ******************************
+ * Converts the ULONGs on stdin to variable length quantities on stdout, as text if binary is 0,
+ * or as the bytes themselves if 1.
+ ******************************************************************* */
+
+int stream(ULONG binary)
+{
+   register ULONG i, pos, len;
+   register UCHAR * ptr;
+   ULONG count, total = 0;
+   UCHAR buffer[5];
+
+#if defined(__OS2__) || defined(_WIN32)
+   if (binary) _setmode(_fileno(stdout), O_BINARY);
+#endif
+
+   while ( (count = readvals(total)) )
+   {
+      pos = 0;
+      if (binary)
+      {
+	 for (i = 0; i < count; i++) pos += MidiLongToVLQ(vals[i], &outbuf[pos]);
+      }
+      else
+      {
+	 for (i = 0; i < count; i++)
+	 {
+	    len = MidiLongToVLQ(vals[i], &buffer[0]);
+	    ptr = &buffer[0];
+	    for (; len; len--)
+	    {
+	       outbuf[pos++] = hexchrs[*ptr >> 4];
+	       outbuf[pos++] = hexchrs[*(ptr)++ & 0x0F];
+	       outbuf[pos++] = ' ';
+	    }
+	    outbuf[pos - 1] = '\n';
+	 }
+      }
+
+      if (fwrite(&outbuf[0], 1, pos, stdout) != pos) break;
+      total += count;
+   }
+
+   if (ferror(stdin))
+   {
+      fprintf(stderr, "Error reading stdin\r\n");
+      return(1);
+   }
+   if (ferror(stdout) || fflush(stdout))
+   {
+      fprintf(stderr, "Error writing stdout\r\n");
+      return(1);
+   }
+
+   return(0);
+}
+
+
+
 /* ********************************** main() ***********************************
  * Program entry point. Calls the MIDIFILE.DLL function MidiVLQToLong.
  *************************************************************************** */
 
-main(int argc, char *argv[], char *envp[])
+int main(int argc, char *argv[], char *envp[])
 {
     register USHORT i;
     ULONG conv, len;
     UCHAR buffer[6];
-    UCHAR convbuf[32];
     register UCHAR * arg;
 
     /* If no args supplied by user, exit with usage info */
@@ -46,13 +215,21 @@ main(int argc, char *argv[], char *envp[])
 	 printf("quantity (ie, series of bytes) equivalent and displays that.\r\n");
 	 printf("It requires MIDIFILE.DLL to run.\r\n");
 	 printf("Syntax: MFTOVLQ.EXE [ULONG1 ULONG2...]\r\n");
+	 printf("        MFTOVLQ.EXE - <ULONGs >text\r\n");
+	 printf("        MFTOVLQ.EXE -b <ULONGs >bytes\r\n");
 	 exit(1);
     }
 
+    /* Streaming from stdin? */
+    if ( argc == 2 && argv[1][0] == '-' && (!argv[1][1] || (argv[1][1] == 'b' && !argv[1][2])) )
+    {
+	 exit(stream(argv[1][1] == 'b'));
+    }
+
     /* Convert ascii numerals to byte values, and store in buffer */
     for (i=1; i<argc; i++)
     {
-	 arg = argv[i];
+	 arg = (UCHAR *)argv[i];
 	 if ( *arg == '0' && (*(arg+1) == 'x' || *(arg+1) == 'X') )
 	 {
 	      arg+=2;
@@ -64,7 +241,7 @@ main(int argc, char *argv[], char *envp[])
 	 }
 	 else
 	 {
-	      conv = (ULONG)atoi(arg);
+	      conv = (ULONG)strtoul((char *)arg, 0, 10);
 	 }
 
 	 /* Call MIDIFILE.DLL function to do the conversion */
@@ -82,4 +259,3 @@ main(int argc, char *argv[], char *envp[])
 
     exit(0);
 }
-
\ No newline at end of file
@@ -2,17 +2,48 @@
  * mfvlq.c
  *
  * Converts the variable length quantity typed by the user into a LONG and displays that.
+ *
+ * With an arg of "-" (or "-b"), a stream of variable length quantities is instead read from
+ * stdin as hex bytes separated by blanks, commas, or newlines (or for "-b", as the bytes
+ * themselves), and their values written to stdout in decimal, one per line. They're converted a
+ * batch at a time with MidiVLQToLongN(), so this can sit in a pipe that's feeding millions.
+ * (Not on OS/2, whose MIDIFILE.DLL has no MidiVLQToLongN()).
  * =========================================================================
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+#ifdef __OS2__
 #include <os2.h>
+#endif
 
 #include "midifile.h"
 
 
-/* A buffer to hold user input */
-UCHAR buffer[4096];
+/* A buffer to hold user input. A variable length quantity is at most 4 bytes, so any more args
+    are ignored */
+UCHAR buffer[8];
+
+#ifndef __OS2__
+
+/* How many quantities to convert at a time when streaming */
+#define BATCHVALS 16384
+
+/* Buffered stdin (for text), the bytes of the quantities, and their values */
+UCHAR inbuf[65536];
+ULONG inpos, inlen;
+UCHAR vlqbuf[65536];
+ULONG vals[BATCHVALS];
+
+/* What's written to stdout. A line is at most 10 digits and a newline */
+UCHAR outbuf[BATCHVALS * 11];
+
+#endif
 
 
 
@@ -30,11 +61,155 @@ USHORT hex2bin(UCHAR c)
 
 
 
+#ifndef __OS2__
+
+/* *************************** nextchr() ******************************
+ * Returns the next char from stdin, or EOF.
+ ******************************************************************* */
+
+int nextchr(VOID)
+{
+   if (inpos >= inlen)
+   {
+      if ( !(inlen = fread(&inbuf[0], 1, sizeof(inbuf), stdin)) ) return(EOF);
+      inpos = 0;
+   }
+   return(inbuf[inpos++]);
+}
+
+
+
+/* *************************** readbytes() ******************************
+ * Reads up to max hex bytes (each 1 or 2 digits, perhaps with a leading 0x) from stdin into ptr.
+ * Returns how many, or 0 at the end of stdin. total is how many were read before these, for an
+ * error message. Exits if there's something that isn't a hex byte.
+ ******************************************************************* */
+
+ULONG readbytes(UCHAR * ptr, ULONG max, ULONG total)
+{
+   register ULONG n = 0;
+   register ULONG conv, digits;
+   register int c;
+
+   while (n < max)
+   {
+      /* Skip the separators */
+      do
+      {
+	 c = nextchr();
+      } while (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == ',');
+      if (c == EOF) break;
+
+      /* Skip any 0x. (A lone 0 is a byte of 0) */
+      conv = digits = 0;
+      if (c == '0')
+      {
+	 c = nextchr();
+	 if (c == 'x' || c == 'X')
+	    c = nextchr();
+	 else
+	    digits = 1;
+      }
+
+      while ( (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F') )
+      {
+	 conv = (conv << 4) | hex2bin((UCHAR)c);
+	 digits++;
+	 c = nextchr();
+      }
+
+      /* It must end with a separator */
+      if (!digits || conv > 0xFF || (c != EOF && c != ' ' && c != '\t' && c != '\r' && c != '\n' && c != ','))
+      {
+	 fprintf(stderr, "Byte #%lu isn't a hex byte\r\n", (unsigned long)(total + n + 1));
+	 exit(1);
+      }
+
+      ptr[n++] = (UCHAR)conv;
+   }
+
+   return(n);
+}
+
+
+
+/* *************************** stream() ******************************
+ * Converts the variable length quantities on stdin to decimal values on stdout. If binary is 1,
+ * stdin has the bytes themselves, rather than text.
+ ******************************************************************* */
+
+int stream(ULONG binary)
+{
+   register ULONG i, pos, val;
+   register UCHAR * ptr;
+   ULONG count, got, have = 0, used, total = 0;
+   UCHAR digits[10];
+
+#ifdef _WIN32
+   if (binary) _setmode(_fileno(stdin), O_BINARY);
+#endif
+
+   for (;;)
+   {
+      /* Add to any bytes left over from the last batch (ie, an unfinished quantity) */
+      if (binary)
+	 got = fread(&vlqbuf[have], 1, sizeof(vlqbuf) - have, stdin);
+      else
+	 got = readbytes(&vlqbuf[have], sizeof(vlqbuf) - have, total + have);
+      if (!(have += got)) break;
+
+      /* Call MIDIFILE.DLL function to do the conversions. At the end of stdin, anything it
+	  couldn't convert is a quantity that never ended */
+      count = MidiVLQToLongN(&vlqbuf[0], have, &vals[0], BATCHVALS, &used);
+      if (!got && !count)
+      {
+	 fprintf(stderr, "The last variable length quantity is missing its final byte\r\n");
+	 return(1);
+      }
+
+      /* Format the values */
+      pos = 0;
+      for (i = 0; i < count; i++)
+      {
+	 val = vals[i];
+	 ptr = &digits[sizeof(digits)];
+	 do
+	 {
+	    *(--ptr) = (UCHAR)('0' + val % 10);
+	 } while (val /= 10);
+	 while (ptr < &digits[sizeof(digits)]) outbuf[pos++] = *(ptr)++;
+	 outbuf[pos++] = '\n';
+      }
+      if (fwrite(&outbuf[0], 1, pos, stdout) != pos) break;
+
+      total += used;
+      memmove(&vlqbuf[0], &vlqbuf[used], have - used);
+      have -= used;
+   }
+
+   if (ferror(stdin))
+   {
+      fprintf(stderr, "Error reading stdin\r\n");
+      return(1);
+   }
+   if (ferror(stdout) || fflush(stdout))
+   {
+      fprintf(stderr, "Error writing stdout\r\n");
+      return(1);
+   }
+
+   return(0);
+}
+
+#endif
+
+
+
 /* ********************************** main() ***********************************
  * Program entry point. Calls the MIDIFILE.DLL function MidiVLQToLong.
  *************************************************************************** */
 
-main(int argc, char *argv[], char *envp[])
+int main(int argc, char *argv[], char *envp[])
 {
     register USHORT i;
     ULONG conv, final;
@@ -48,14 +223,26 @@ main(int argc, char *argv[], char *envp[])
 	 printf("(ie, series of bytes) into a ULONG and displays that.\r\n");
 	 printf("It requires MIDIFILE.DLL to run.\r\n");
 	 printf("Syntax: MFVLQ.EXE [...bytes...]\r\n");
+#ifndef __OS2__
+	 printf("       MFVLQ.EXE - <text >ULONGs\r\n");
+	 printf("       MFVLQ.EXE -b <bytes >ULONGs\r\n");
+#endif
 	 exit(1);
     }
 
+#ifndef __OS2__
+    /* Streaming from stdin? */
+    if ( argc == 2 && argv[1][0] == '-' && (!argv[1][1] || (argv[1][1] == 'b' && !argv[1][2])) )
+    {
+	 exit(stream(argv[1][1] == 'b'));
+    }
+#endif
+
     /* Convert ascii numerals to byte values, and store in buffer */
     *(ptr)++ = 0;
-    for (i=1; i<argc; i++)
+    for (i=1; i<argc && ptr < &buffer[5]; i++)
     {
-	 arg = argv[i];
+	 arg = (UCHAR *)argv[i];
 	 if ( *arg == '0' && (*(arg+1) == 'x' || *(arg+1) == 'X') )
 	 {
 	      arg+=2;
@@ -64,7 +251,7 @@ main(int argc, char *argv[], char *envp[])
 	 }
 	 else
 	 {
-	      conv = (ULONG)atoi(arg);
+	      conv = (ULONG)strtoul((char *)arg, 0, 10);
 	 }
 	 *(ptr)++ = (UCHAR)conv | 0x80;
     }
@@ -77,8 +264,7 @@ main(int argc, char *argv[], char *envp[])
 
     /* Call MIDIFILE.DLL function to do the conversion, and print it  */
     final = MidiVLQToLong(&buffer[1], &conv);
-    printf("ULONG value = 0x%08lx\r\n%ld bytes converted\r\n", final, conv);
+    printf("ULONG value = 0x%08lx\r\n%ld bytes converted\r\n", (unsigned long)final, (long)conv);
 
     exit(0);
 }
-
\ No newline at end of file
@@ -7,7 +7,11 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __OS2__
 #include <os2.h>
+#endif
 
 #include "midifile.h"
 
@@ -49,57 +53,10 @@ VOID initfuncs(CHAR * fn);
     will form a USHORT length of the SYSEX (not counting the Status).
 */
 
-typedef struct _EVENT  /* general form of an "event" */
-{
-    ULONG Time;
-    UCHAR Status;
-    UCHAR Data1, Data2, Data3;
-} EVENT;
-
-typedef struct _XEVENT
-{
-    ULONG  Time;
-    UCHAR  Status;
-    UCHAR  Index;
-    USHORT Length;
-} XEVENT;
-
-typedef struct _SEQEVENT
-{
-    ULONG  Time;
-    UCHAR  Status;
-    UCHAR  UnUsed1;
-    USHORT SeqNum;
-} SEQEVENT;
-
-typedef struct _TXTEVENT
-{
-    ULONG  Time;
-    UCHAR  Status;
-    UCHAR  Length;
-    USHORT Index;
-} TXTEVENT;
-
-typedef struct _TEMPOEVENT
-{
-    ULONG  Time;
-    UCHAR  Status;
-    UCHAR  BPM, Unused1, UnUsed2;
-} TEMPOEVENT;
-
-typedef struct _TIMEEVENT
-{
-    ULONG Time;
-    UCHAR Status;
-    UCHAR Nom, Denom, Clocks;
-} TIMEEVENT;
-
-typedef struct _KEYEVENT
-{
-    ULONG Time;
-    UCHAR Status;
-    UCHAR Key, Minor, UnUsed1;
-} KEYEVENT;
+/* The MIDIEVT, MIDIXEVT, MIDISEQEVT, MIDITXTEVT, MIDITEMPOEVT, MIDITIMEEVT, and MIDIKEYEVT
+    structures are defined in midifile.h, since MidiWriteTrackEvents() can write an array of
+    them directly. The indexes of both the SYSEX and the variable length Meta-Events are into
+    the one payloads[] array (below), since that's what MidiWriteTrackEvents() expects. */
 
 
 
@@ -114,12 +71,19 @@ MIDIFILE mfs;
 
 
 
-/* OK, here's an artificially created block of EVENTS. We mix it up with a variety of Status,
+#ifndef __OS2__
+/* Counts the system calls that the DLL makes to write the file, if the user asked */
+MIDIIOSTATS stats;
+#endif
+
+
+
+/* OK, here's an artificially created block of MIDIEVTs. We mix it up with a variety of Status,
     to show you how you might store such. This is for writing a Format 0. In your own app, you
     may choose to store data in a different way.
 */
 
-EVENT evts[20] = {
+MIDIEVT evts[20] = {
      {0, 0x04, 5, 0x01, 0x00}, /* Instrument Name Meta-Event. Status = 0x04. Note that Data2
 				      and Data3 form a USHORT index. Because Intel CPU uses
 				      reverse byte order, the seq number here is really 0x0001 */
@@ -129,17 +93,17 @@ EVENT evts[20] = {
      {0, 0x51, 100, 0, 0},	  /* A Tempo Meta-Event. Status = 0x51. */
      {96, 0x90, 64, 127, 0},	 /* A Note-on (ie, fixed length MIDI message) */
      {96, 0xC0, 1, 0xFF, 0},	 /* A Program Change (ie, also a fixed length MIDI message) */
-     {96, 0xF0, 0, 0x02, 0x00}, /* SYSEX (ie, 0xF0 type) */
+     {96, 0xF0, 3, 0x02, 0x00}, /* SYSEX (ie, 0xF0 type) */
      {96, 0x90, 71, 127, 0},	 /* A Note-on (ie, fixed length MIDI message) */
      {192, 0xFC, 0, 0, 0},	 /* MIDI REALTIME "Stop" */
      {192, 0x90, 68, 127, 0},	/* A Note-on (ie, fixed length MIDI message) */
      {288, 0x90, 64, 0, 0},	 /* A Note-off (ie, Note-on with 0 velocity) */
      {288, 0x51, 120, 0, 0},	 /* A Tempo Meta-Event. Status = 0x51. */
      {288, 0x90, 68, 0, 0},	 /* A Note-off */
-     {384, 0xF0, 1, 0x01, 0x00}, /* SYSEX (ie, 0xF0 type, but the start of a series of packets,
+     {384, 0xF0, 4, 0x01, 0x00}, /* SYSEX (ie, 0xF0 type, but the start of a series of packets,
 				       so it doesn't end with 0xF7) */
-     {384, 0xF7, 2, 0x01, 0x00}, /* SYSEX (ie, 0xF7 type, the next packet). */
-     {384, 0xF7, 3, 0x02, 0x00}, /* SYSEX (ie, 0xF7 type, the last packet, so it ends with 0xF7). */
+     {384, 0xF7, 5, 0x01, 0x00}, /* SYSEX (ie, 0xF7 type, the next packet). */
+     {384, 0xF7, 6, 0x02, 0x00}, /* SYSEX (ie, 0xF7 type, the last packet, so it ends with 0xF7). */
      {480, 0x7F, 4, 0x02, 0x00}, /* Proprietary Meta-Event. */
      {480, 0x90, 71, 0, 0},	  /* A Note-off */
      {768, 0x2F, 0, 0, 0},	   /* An End Of Track Meta-Event. Status = 0x2F. */
@@ -147,13 +111,13 @@ EVENT evts[20] = {
 
 
 
-/* Here's 2 artificially created blocks of EVENTS. These 2 are for writing a Format 1. We simply
+/* Here's 2 artificially created blocks of MIDIEVTs. These 2 are for writing a Format 1. We simply
     separate the events in the above track into 2 tracks. With a format 1, the first track is
     considered the "tempo map", so we put appropriate events in that (ie, all tempo and time
     signature events should go in only this one track).
 */
 
-EVENT trk1[6] = {
+MIDIEVT trk1[6] = {
      {0, 0x58, 5, 4, 24},
      {0, 0x59, 1, 0, 0},
      {0, 0x51, 100, 0, 0},
@@ -162,20 +126,20 @@ EVENT trk1[6] = {
      {768, 0x2F, 0, 0, 0},
 };
 
-EVENT trk2[15] = {
+MIDIEVT trk2[15] = {
      {0, 0x04, 5, 0x01, 0x00},
      {0, 0x01, 11, 0x00, 0x00},
      {96, 0x90, 64, 127, 0},
      {96, 0xC0, 1, 0xFF, 0},
-     {96, 0xF0, 0, 0x02, 0x00},
+     {96, 0xF0, 3, 0x02, 0x00},
      {96, 0x90, 71, 127, 0},
      {192, 0xFC, 0, 0, 0},
      {192, 0x90, 68, 127, 0},
      {288, 0x90, 64, 0, 0},
      {288, 0x90, 68, 0, 0},
-     {384, 0xF0, 1, 0x01, 0x00},
-     {384, 0xF7, 2, 0x01, 0x00},
-     {384, 0xF7, 3, 0x02, 0x00},
+     {384, 0xF0, 4, 0x01, 0x00},
+     {384, 0xF7, 5, 0x01, 0x00},
+     {384, 0xF7, 6, 0x02, 0x00},
      {480, 0x90, 71, 0, 0},
      {768, 0x2F, 0, 0, 0},
 };
@@ -185,7 +149,10 @@ EVENT trk2[15] = {
 /* Pointers to our tracks. Assume Format 0. In your own app, you may choose to do something
     different.
  */
-EVENT * trk_ptrs[2] = { &evts[0], &trk2[0] };
+MIDIEVT * trk_ptrs[2] = { &evts[0], &trk2[0] };
+
+/* And how many MIDIEVTs each has */
+ULONG trk_lens[2] = { sizeof(evts) / sizeof(MIDIEVT), sizeof(trk2) / sizeof(MIDIEVT) };
 
 
 
@@ -218,8 +185,24 @@ UCHAR sysex[4][2] = {
 
 
 
+/* Where the data of each variable length Meta-Event and SYSEX is, by its MIDITXTEVT or
+    MIDIXEVT's Index */
+UCHAR * payloads[7] = {
+     &text[0][0], &text[1][0], &text[2][0],
+     &sysex[0][0], &sysex[1][0], &sysex[2][0], &sysex[3][0],
+};
+
+
+
+#ifndef __OS2__
+/* Set if the user asked for each MTrk to be written with MidiWriteTrackEvents() */
+UCHAR Bulk;
+#endif
+
+
+
 /* To point to the next event to write out */
-EVENT * TrkPtr;
+MIDIEVT * TrkPtr;
 
 
 
@@ -233,7 +216,7 @@ UCHAR ex_index;
  * all of the real work of feeding data to the DLL to write out.
  *************************************************************************** */
 
-main(int argc, char *argv[], char *envp[])
+int main(int argc, char *argv[], char *envp[])
 {
     LONG result;
     UCHAR buf[60];
@@ -243,7 +226,13 @@ main(int argc, char *argv[], char *envp[])
     {
 	 printf("This program writes out a 'dummy' MIDI (sequencer) file.\r\n");
 	 printf("It requires MIDIFILE.DLL to run.\r\n");
+#ifndef __OS2__
+	 printf("Syntax: MFWRITE.EXE filename [0, 1, or 2 (for Format)] [H, B, and/or S (to hold the file in\r\n");
+	 printf("        memory, to write each MTrk with one MidiWriteTrackEvents() call, and/or to count\r\n");
+	 printf("        the system calls made)]\r\n");
+#else
 	 printf("Syntax: MFWRITE.EXE filename [0, 1, or 2 (for Format)]\r\n");
+#endif
 	 exit(1);
     }
 
@@ -264,6 +253,7 @@ main(int argc, char *argv[], char *envp[])
 	 {
 	      mfs.NumTracks = 2;
 	      trk_ptrs[0] = &trk1[0];
+	      trk_lens[0] = sizeof(trk1) / sizeof(MIDIEVT);
 	 }
     }
     mfs.Division = 96;	 /* Arbitrarily chose 96 PPQN for my time-stamps */
@@ -271,6 +261,20 @@ main(int argc, char *argv[], char *envp[])
     /* Make it easier for me to specify Tempo and Time Signature events */
     mfs.Flags = MIDIBPM|MIDIDENOM;
 
+#ifndef __OS2__
+    /* If the user asked, have the DLL hold the whole file in memory, and write it out in one go
+	at the end. Otherwise, it writes out its buffer whenever that fills, and has to go back to
+	fix up any chunk size that has already been written */
+    if (argc>3 && (strchr(argv[3], 'H') || strchr(argv[3], 'h'))) mfs.Flags |= MIDIHOLD;
+
+    /* If the user asked, startMTrk() writes each whole MTrk from our array of MIDIEVTs with one
+	call, instead of the DLL calling standardEvt() for each event */
+    if (argc>3 && (strchr(argv[3], 'B') || strchr(argv[3], 'b'))) Bulk = 1;
+
+    /* If the user asked, have the DLL count its system calls */
+    if (argc>3 && (strchr(argv[3], 'S') || strchr(argv[3], 's'))) mfs.IOStats = &stats;
+#endif
+
     /* Tell MIDIFILE.DLL to write out the file, calling my callback functions */
     result = MidiWriteFile(&mfs);
 
@@ -278,6 +282,13 @@ main(int argc, char *argv[], char *envp[])
     MidiGetErr(&mfs, result, &buf[0]);
     printf(&buf[0]);
 
+#ifndef __OS2__
+    if (mfs.IOStats)
+	printf("System calls: %lu reads, %lu writes, %lu seeks, %lu others\r\n",
+	    (unsigned long)stats.Reads, (unsigned long)stats.Writes, (unsigned long)stats.Seeks,
+	    (unsigned long)stats.Others);
+#endif
+
     exit(0);
 }
 
@@ -316,6 +327,19 @@ LONG EXPENTRY startMTrk(MIDIFILE * mf)
     /* Initialize a global ptr to the start of the EVENTs that we're going to write in this MTrk */
     TrkPtr = trk_ptrs[mf->TrackNum];
 
+    /* If the user asked, write the whole MTrk ourselves, and return -1 so that the DLL moves on
+	to the next one. Our MIDIEVTs are already laid out as MidiWriteTrackEvents() wants. (But
+	then, metaseq() doesn't get called, so there's no Sequence Number nor Track Name) */
+#ifndef __OS2__
+    if (Bulk)
+    {
+	LONG result;
+
+	if ( (result = MidiWriteTrackEvents(mf, TrkPtr, trk_lens[mf->TrackNum], &payloads[0])) ) return(result);
+	return(-1);
+    }
+#endif
+
     /* Here, we could write out some non-standard chunk of our own creation. It will end up
 	in the MIDI file ahead of the MTrk that we're about to write. Nah! */
 
@@ -331,7 +355,7 @@ LONG EXPENTRY startMTrk(MIDIFILE * mf)
  * SEQUENCE NAME) Meta-Events
  ************************************************************************ */
 
-VOID store_seq(SEQEVENT * trk, METASEQ * mf)
+VOID store_seq(MIDISEQEVT * trk, METASEQ * mf)
 {
     mf->NamePtr = &names[mf->TrackNum][0];
     mf->SeqNum = trk->SeqNum;
@@ -343,7 +367,7 @@ VOID store_seq(SEQEVENT * trk, METASEQ * mf)
  * Called by standardEvt() to format the MIDIFILE for writing out a TEMPO Meta-Event
  ************************************************************************ */
 
-VOID store_tempo(TEMPOEVENT * trk, METATEMPO * mf)
+VOID store_tempo(MIDITEMPOEVT * trk, METATEMPO * mf)
 {
 
     /* NOTE: We set MIDIBPM Flag so the DLL will calculate micros from this BPM.
@@ -358,7 +382,7 @@ VOID store_tempo(TEMPOEVENT * trk, METATEMPO * mf)
  * Called by standardEvt() to format the MIDIFILE for writing out a TIME SIGNATURE Meta-Event
  ************************************************************************ */
 
-VOID store_time(TIMEEVENT * trk, METATIME * mf)
+VOID store_time(MIDITIMEEVT * trk, METATIME * mf)
 {
     mf->Nom = trk->Nom;
     mf->Denom = trk->Denom;
@@ -372,7 +396,7 @@ VOID store_time(TIMEEVENT * trk, METATIME * mf)
  * Called by standardEvt() to format the MIDIFILE for writing out a KEY SIGNATURE Meta-Event
  ************************************************************************ */
 
-VOID store_key(KEYEVENT * trk, METAKEY * mf)
+VOID store_key(MIDIKEYEVT * trk, METAKEY * mf)
 {
     mf->Key = trk->Key;
     mf->Minor = trk->Minor;
@@ -385,7 +409,7 @@ VOID store_key(KEYEVENT * trk, METAKEY * mf)
  * Meta-Events (ie, types 0x01 to 0x0F, or 0x7F).
  ************************************************************************ */
 
-VOID store_meta(TXTEVENT * trk, METATXT * mf)
+VOID store_meta(MIDITXTEVT * trk, METATXT * mf)
 {
     /* If a variable length Meta-Event (ie, type is 0x01 to 0x0F, or 0x7F), then we set
 	the EventSize to the number of bytes that we expect to output. We also set the
@@ -396,13 +420,13 @@ VOID store_meta(TXTEVENT * trk, METATXT * mf)
 	data. Here, we'll supply the pointer and let the DLL do all of the work of writing out
 	the data. */
 
-    /* Look up where I've stored the data for this meta-event (ie, in my text[] array), and
+    /* Look up where I've stored the data for this meta-event (ie, in my payloads[] array), and
        store this pointer in the MIDIFILE. */
-    mf->Ptr = &text[trk->Index][0];
+    mf->Ptr = payloads[trk->Index];
 
     /* Set the event length. NOTE: If we set this to 0, then that tells the DLL that
 	we're passing a null-terminated string, and the DLL uses strlen() to get the length.
-	We could have done that here to really simplify our the structure of our TXTEVENT
+	We could have done that here to really simplify our the structure of our MIDITXTEVT
 	since all of our strings happen to be null-terminated. But, if you ever need to write
 	out data strings with imbedded NULLs, you'll need to something like... */
     mf->EventSize = (ULONG)trk->Length;
@@ -414,7 +438,7 @@ VOID store_meta(TXTEVENT * trk, METATXT * mf)
  * Called by standardEvt() to format the MIDIFILE for writing out a SYSEX Meta-Events
  ************************************************************************ */
 
-VOID store_sysex(XEVENT * trk, METATXT * mf)
+VOID store_sysex(MIDIXEVT * trk, METATXT * mf)
 {
 
     /* For SYSEX, just store the status, and the length of the message. We also set the
@@ -523,14 +547,14 @@ LONG EXPENTRY standardEvt(MIDIFILE * mf)
 	      /* NOTE: If we use a MetaSeqNum callback, we wouldn't write out a Meta-Event
 		 here, and so this case wouldn't be needed. */
 	      case 0x00:
-		   /* Note the recasting of the EVENT and the MIDIFILE structures to the versions
+		   /* Note the recasting of the MIDIEVT and the MIDIFILE structures to the versions
 		       appropriate for a SEQUENCE NUMBER Meta-Event. */
-		   store_seq( (SEQEVENT *)TrkPtr, (METASEQ *)mf );
+		   store_seq( (MIDISEQEVT *)TrkPtr, (METASEQ *)mf );
 		   break;
 
 	      /* ------- Set Tempo -------- */
 	      case 0x51:
-		   store_tempo( (TEMPOEVENT *)TrkPtr, (METATEMPO *)mf );
+		   store_tempo( (MIDITEMPOEVT *)TrkPtr, (METATEMPO *)mf );
 		   break;
 
 	      /* --------- SMPTE --------- */
@@ -542,22 +566,22 @@ LONG EXPENTRY standardEvt(MIDIFILE * mf)
 
 	      /* ------- End of Track ------ */
 	      case 0x2F:
-		   printf("Closing track #%ld...\r\n", mf->TrackNum);
+		   printf("Closing track #%ld...\r\n", (long)mf->TrackNum);
 		   break;
 
 	      /* ------ Time Signature ----- */
 	      case 0x58:
-		   store_time( (TIMEEVENT *)TrkPtr, (METATIME *)mf );
+		   store_time( (MIDITIMEEVT *)TrkPtr, (METATIME *)mf );
 		   break;
 
 	      /* ------ Key Signature ------ */
 	      case 0x59:
-		   store_key( (KEYEVENT *)TrkPtr, (METAKEY *)mf );
+		   store_key( (MIDIKEYEVT *)TrkPtr, (METAKEY *)mf );
 		   break;
 
 	      /* Must be a variable length Meta-Event (ie, type is 0x01 to 0x0F, or 0x7F) */
 	      default:
-		   store_meta( (TXTEVENT *)TrkPtr, (METATXT *)mf );
+		   store_meta( (MIDITXTEVT *)TrkPtr, (METATXT *)mf );
 	 }
     }
 
@@ -567,7 +591,7 @@ LONG EXPENTRY standardEvt(MIDIFILE * mf)
 	 /* SYSEX (0xF0) or SYSEX CONTINUATION (0xF7) */
 	 case 0xF0:
 	 case 0xF7:
-	      store_sysex( (XEVENT *)TrkPtr, (METATXT *)mf );
+	      store_sysex( (MIDIXEVT *)TrkPtr, (METATXT *)mf );
 	      break;
 
 	 /* For other MIDI messages, they're all fixed length, and will fit into the MIDIFILE
@@ -601,7 +625,7 @@ LONG EXPENTRY sysexEvt(MIDIFILE * mf)
     register LONG result;
 
     /* Look up where I put the data for the SYSEX event that we're writing right now */
-    ptr = &sysex[ex_index][0];
+    ptr = payloads[ex_index];
 
     /* Here's an example of writing the data one byte at a time. This is slow, but it shows that
 	you can make multiple calls to MidiWriteBytes(). NOTE: commented out; just for
@@ -738,7 +762,7 @@ VOID initfuncs(CHAR * fn)
     cb.ReadWriteMidi = 0;
     cb.SeekMidi = 0;
     cb.CloseMidi = 0;
-    mfs.Handle = (ULONG)fn;
+    mfs.Handle = (MIDIHANDLE)fn;
 
     cb.UnknownChunk = make_extra;
     cb.StartMThd = 0;	 /* Don't need this since I initialized the MThd before MidiWriteFile() */
@@ -748,4 +772,3 @@ VOID initfuncs(CHAR * fn)
     cb.MetaSeqNum = metaseq;
     cb.MetaText = 0;	/* Not needed since we supply the data buffer to the DLL in standardEvt() */
 }
-
\ No newline at end of file
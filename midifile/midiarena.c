@@ -0,0 +1,116 @@
+/* ===========================================================================
+ * midiarena.c
+ *
+ * The MIDIFILE engine's MIDIARENA. This hands out memory for the data of SYSEX and variable
+ * length Meta-Events by bumping a pointer through big blocks, rather than a malloc() for each
+ * event, and then frees all of the blocks at once.
+ * =========================================================================
+ */
+
+#include <stdlib.h>
+
+#include "midipriv.h"
+
+
+/* The size of each block, if the app doesn't set BlockSize */
+#define DEFBLOCKSIZE 65536
+
+/* The start of each block, before the memory that's handed out. Blocks are linked from the
+    newest back to the oldest. Align makes it the size of the strictest of a pointer and a
+    double, so the memory after it starts out aligned for either */
+typedef union _ARENABLOCK
+{
+    union _ARENABLOCK * Prev;
+    double		Align;
+} ARENABLOCK;
+
+/* Rounds a number of bytes up to a multiple of the ARENABLOCK size, so that each piece handed
+    out is aligned just as the block is */
+#define ARENAROUND(n) (((n) + sizeof(ARENABLOCK) - 1) & ~(ULONG)(sizeof(ARENABLOCK) - 1))
+
+
+
+
+/******************************** MidiArenaAlloc() *****************************
+ * Returns a pointer to count bytes of memory from the MIDIARENA, or 0 if out of memory. It
+ * stays put until MidiFreeArena(), and is aligned for a pointer or a double. A count bigger than
+ * the BlockSize gets a block of its own, which is put behind the current block so that the rest
+ * of that isn't wasted.
+ **************************************************************************/
+
+UCHAR * EXPENTRY MidiArenaAlloc(MIDIARENA * arena, ULONG count)
+{
+    register ARENABLOCK * block;
+    register ULONG size;
+    ULONG used;
+    UCHAR * ptr;
+
+    arena->Total += count;
+
+    /* Fits in the current block (after the end of the last piece, rounded up) */
+    used = ARENAROUND(arena->Used);
+    if ( arena->Block && used <= arena->Size && count <= arena->Size - used )
+    {
+	ptr = (UCHAR *)((ARENABLOCK *)arena->Block + 1) + used;
+	arena->Used = used + count;
+	return(ptr);
+    }
+
+    if ( !(size = arena->BlockSize) ) size = DEFBLOCKSIZE;
+
+    /* Too big to share a block */
+    if ( count > size )
+    {
+	if ( !(block = (ARENABLOCK *)malloc(sizeof(ARENABLOCK) + count)) ) goto bad;
+	if (arena->Block)
+	{
+	    block->Prev = ((ARENABLOCK *)arena->Block)->Prev;
+	    ((ARENABLOCK *)arena->Block)->Prev = block;
+	}
+	else
+	{
+	    /* No current block yet, so this one is it, but full */
+	    block->Prev = 0;
+	    arena->Block = block;
+	    arena->Size = arena->Used = count;
+	}
+	return( (UCHAR *)(block + 1) );
+    }
+
+    /* Start a new block */
+    if ( !(block = (ARENABLOCK *)malloc(sizeof(ARENABLOCK) + size)) ) goto bad;
+    block->Prev = (ARENABLOCK *)arena->Block;
+    arena->Block = block;
+    arena->Size = size;
+    arena->Used = count;
+    return( (UCHAR *)(block + 1) );
+
+bad:
+    arena->Total -= count;
+    return(0);
+}
+
+
+
+
+/******************************** MidiFreeArena() ******************************
+ * Frees all of the memory that MidiArenaAlloc() handed out from a MIDIARENA. It can then be
+ * reused (with the same BlockSize).
+ **************************************************************************/
+
+VOID EXPENTRY MidiFreeArena(MIDIARENA * arena)
+{
+    register ARENABLOCK * block;
+    register ARENABLOCK * prev;
+
+    for (block = (ARENABLOCK *)arena->Block; block; block = prev)
+    {
+	prev = block->Prev;
+	free(block);
+    }
+
+    arena->Block = 0;
+    arena->Size = arena->Used = arena->Total = 0;
+    arena->Sysex = 0;
+    arena->SysexLen = arena->SysexMax = 0;
+}
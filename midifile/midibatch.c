@@ -0,0 +1,220 @@
+/* ===========================================================================
+ * midibatch.c
+ *
+ * The MIDIFILE engine's MidiReadFiles(). This reads a whole list of MIDI files on several worker
+ * threads, so that the waits for opening and reading the files overlap, rather than adding up.
+ * =========================================================================
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "midipriv.h"
+
+
+/* Never start more workers than this, however many MIDIFILEs the app supplies */
+#define MIDIMAXBATCH 256
+
+/* What the workers of one MidiReadFiles() share */
+typedef struct _BATCHJOB
+{
+    pthread_mutex_t Lock;
+    MIDIBATCH *     Batch;
+    ULONG	    Next;     /* Next file that a worker hasn't taken */
+    ULONG	    Stop;     /* Files from here on aren't started */
+    ULONG	    ErrItem;  /* Lowest file that returned an error */
+    LONG	    Result;   /* And that error */
+    LONG	    Halt;     /* The error that DoneFile stopped the batch with, or 0 */
+} BATCHJOB;
+
+/* One worker */
+typedef struct _BATCHWORKER
+{
+    BATCHJOB *	Job;
+    MIDIFILE *	MidiFile;     /* What it reads with */
+    pthread_t	Thread;
+} BATCHWORKER;
+
+
+
+
+/********************************* load_file() ********************************
+ * Reads the whole file at path into the worker's buffer (buf, which has room for max bytes),
+ * enlarging that if needed, and sets len to the number of bytes read. Returns 0 if success, or
+ * an error number.
+ **************************************************************************/
+
+static LONG load_file(MIDIFILE * mf, const CHAR * path, UCHAR ** buf, ULONG * max, ULONG * len)
+{
+    struct stat st;
+    register ULONG size, got;
+    UCHAR * ptr;
+    ssize_t n;
+    LONG result;
+    int fd;
+
+    MIDICOUNT(mf, Others);
+    if ( (fd = open(path, O_RDONLY)) < 0 ) return(MIDIERRFILE);
+
+    result = 0;
+    got = 0;
+
+    MIDICOUNT(mf, Others);
+    if ( fstat(fd, &st) )
+    {
+	result = MIDIERRINFO;
+	goto out;
+    }
+    size = (ULONG)st.st_size;
+
+    if (size > *max)
+    {
+	if ( !(ptr = (UCHAR *)realloc(*buf, size)) )
+	{
+	    result = MIDIERRREAD;
+	    goto out;
+	}
+	*buf = ptr;
+	*max = size;
+    }
+
+    /* Usually, one read() gets it all. If the file has shrunk since the fstat(), just read
+	what there is */
+    while (got < size)
+    {
+	MIDICOUNT(mf, Reads);
+	if ( (n = read(fd, *buf + got, size - got)) <= 0 )
+	{
+	    if (n < 0 && errno == EINTR) continue;
+	    if (n < 0) result = MIDIERRREAD;
+	    break;
+	}
+	got += n;
+    }
+
+out:
+    MIDICOUNT(mf, Others);
+    close(fd);
+    *len = got;
+    return(result);
+}
+
+
+
+
+/******************************** batch_worker() *******************************
+ * A worker thread. Takes the next file not yet taken, loads it, and reads it with the worker's
+ * MIDIFILE, until there are none left (or DoneFile stops the batch).
+ **************************************************************************/
+
+static VOID * batch_worker(VOID * arg)
+{
+    register BATCHWORKER * wkr = (BATCHWORKER *)arg;
+    register BATCHJOB * job = wkr->Job;
+    register MIDIBATCH * batch = job->Batch;
+    register MIDIFILE * mf = wkr->MidiFile;
+    register ULONG item;
+    UCHAR * buf;
+    ULONG max, len;
+    LONG result;
+
+    buf = 0;
+    max = 0;
+
+    for (;;)
+    {
+	pthread_mutex_lock(&job->Lock);
+	item = job->Next++;
+	if (item >= job->Stop)
+	{
+	    pthread_mutex_unlock(&job->Lock);
+	    break;
+	}
+	pthread_mutex_unlock(&job->Lock);
+
+	if ( !(result = load_file(mf, batch->Paths[item], &buf, &max, &len)) )
+	    result = MidiReadMemory(mf, buf, len);
+
+	if (batch->Results) batch->Results[item] = result;
+
+	if (result)
+	{
+	    pthread_mutex_lock(&job->Lock);
+	    batch->Failed++;
+	    if (item < job->ErrItem)
+	    {
+		job->ErrItem = item;
+		job->Result = result;
+	    }
+	    pthread_mutex_unlock(&job->Lock);
+	}
+
+	if ( batch->DoneFile && (result = batch->DoneFile(batch, mf, item, result)) )
+	{
+	    pthread_mutex_lock(&job->Lock);
+	    if (job->Stop > job->Next) job->Stop = job->Next;
+	    if (!job->Halt) job->Halt = result;
+	    pthread_mutex_unlock(&job->Lock);
+	}
+    }
+
+    free(buf);
+    return(0);
+}
+
+
+
+
+/******************************** MidiReadFiles() ******************************
+ * Reads each of the MIDIBATCH's Paths with one of its Files, spread over a worker thread per
+ * MIDIFILE (the calling thread being one of them). Which worker reads which file, and the order
+ * that they finish in, is up to the timing of the storage. Returns 0 if every file was read
+ * successfully, the error that DoneFile returned if it stopped the batch, or else the error
+ * for the lowest numbered file that failed (see Results for the rest).
+ **************************************************************************/
+
+LONG EXPENTRY MidiReadFiles(MIDIBATCH * batch)
+{
+    BATCHWORKER workers[MIDIMAXBATCH];
+    register ULONG i, num;
+    BATCHJOB job;
+
+    batch->Failed = 0;
+
+    if (!batch->Count) return(0);
+    if ( !(num = batch->NumFiles) ) return(MIDIERRFILE);
+    if (num > MIDIMAXBATCH) num = MIDIMAXBATCH;
+    if (num > batch->Count) num = batch->Count;
+
+    pthread_mutex_init(&job.Lock, 0);
+    job.Batch = batch;
+    job.Next = 0;
+    job.Stop = batch->Count;
+    job.ErrItem = batch->Count;
+    job.Result = job.Halt = 0;
+
+    for (i = 0; i < num; i++)
+    {
+	workers[i].Job = &job;
+	workers[i].MidiFile = batch->Files[i];
+    }
+
+    /* If a thread can't be started, the ones that are (and this one) just do more files */
+    for (i = 1; i < num; i++)
+    {
+	if ( pthread_create(&workers[i].Thread, 0, batch_worker, &workers[i]) ) break;
+    }
+    num = i;
+
+    batch_worker(&workers[0]);
+
+    for (i = 1; i < num; i++) pthread_join(workers[i].Thread, 0);
+
+    pthread_mutex_destroy(&job.Lock);
+
+    return( (job.Halt) ? job.Halt : job.Result );
+}
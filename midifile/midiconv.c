@@ -0,0 +1,736 @@
+/* ===========================================================================
+ * midiconv.c
+ *
+ * The MIDIFILE engine's MidiConvertFile() and MidiCompactFile(). MidiConvertFile() rewrites a MIDI
+ * file as Format 0 (all MTrks merged into one) or Format 1 (one MTrk per MIDI channel, after a
+ * first MTrk with everything else). MidiCompactFile() rewrites each MTrk in as few bytes as it
+ * can. Either way, the events are copied straight from one file to the other, so neither file is
+ * ever held in memory.
+ * =========================================================================
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "midipriv.h"
+
+
+
+/* Which events a pass of convert_pass() writes, other than a MIDI channel (0 to 15) */
+#define PASSCONDUCT 16	/* Everything but MIDI events (ie, the first MTrk of a Format 1) */
+#define PASSALL     17	/* Everything (ie, the only MTrk of a Format 0) */
+#define PASSSCAN    18	/* Nothing. Just find which MIDI channels have events */
+
+/* The state of a MidiConvertFile() */
+typedef struct _CONVERT
+{
+    MIDIFILE * In;	/* The file being read */
+    MIDIFILE * Out;	/* The file being written */
+    MERGE      Merge;	/* A CURSOR per MTrk of In */
+    ULONG      PrevTime; /* Time of the last event written to the current MTrk */
+    ULONG      EndTime;	/* Time of the last event in In */
+    USHORT     Chans;	/* A bit for each MIDI channel that In has events on */
+    USHORT     MaxFormat; /* The highest Format of In that can be rewritten */
+    UCHAR      RunStatus; /* Running status of the current MTrk being written */
+    UCHAR      SysexOpen; /* MidiCompactFile(): Set if in a SYSEX that continues in another packet */
+    MIDICOMPACT * Stats; /* MidiCompactFile(): The app's MIDICOMPACT */
+    USHORT     Owner[16]; /* MidiCompactFile(): Per channel, the MTrk (counting from 1) that has
+			    its Controller events, 0 if none does, or 0xFFFF if several do */
+    UCHAR      Ctl[16][128]; /* MidiCompactFile(): Per channel, each Controller's last value in
+			    the current MTrk, or 0xFF if not known */
+} CONVERT;
+
+/* The function that rewrite_file() calls to do the real work */
+typedef LONG (*REWRITE)(CONVERT * cv, USHORT arg);
+
+
+
+
+/******************************** write_head() ********************************
+ * Writes an event's delta-time and its first count bytes (at buf) to the MTrk being written.
+ * Returns 0 if success, or an error number.
+ **************************************************************************/
+
+static LONG write_head(CONVERT * cv, ULONG time, UCHAR * buf, ULONG count)
+{
+    UCHAR vlq[5];
+    LONG result;
+
+    if ( (result = MidiIOWrite(cv->Out, &vlq[0], MidiLongToVLQ(time - cv->PrevTime, &vlq[0]))) ) return(result);
+    cv->PrevTime = time;
+    return( MidiIOWrite(cv->Out, buf, count) );
+}
+
+
+
+
+/******************************** copy_data() *********************************
+ * Copies the len data bytes of a SYSEX or Meta-Event from the file being read to the one being
+ * written, a buffer at a time. Returns 0 if success, or an error number.
+ **************************************************************************/
+
+static LONG copy_data(CONVERT * cv, ULONG len)
+{
+    register ULONG count;
+    UCHAR buf[1024];
+    LONG result;
+
+    while (len)
+    {
+	count = (len > sizeof(buf)) ? sizeof(buf) : len;
+	if ( (result = MidiIORead(cv->In, &buf[0], count)) ) return(result);
+	if ( (result = MidiIOWrite(cv->Out, &buf[0], count)) ) return(result);
+	len -= count;
+    }
+    return(0);
+}
+
+
+
+
+/******************************** copy_event() ********************************
+ * Reads the next event of an MTrk of the file being read (ie, at the CURSOR, and after its
+ * delta-time), and writes it to the MTrk being written if the pass wants it. MIDI events are
+ * written with running status. Any other event cancels running status. End Of Tracks aren't
+ * written, since convert_pass() adds one at the end. Returns 0 if success, -1 if an End Of Track
+ * was read, or an error number.
+ **************************************************************************/
+
+static LONG copy_event(CONVERT * cv, CURSOR * cur, UCHAR pass)
+{
+    register MIDIFILE * in = cv->In;
+    register UCHAR status;
+    UCHAR buf[7];
+    ULONG len, count;
+    LONG result;
+
+    if ( (result = MidiIORead(in, &buf[0], 1)) ) return(result);
+
+    /* MIDI event with Status 0x80 to 0xEF (perhaps via running status) */
+    if (buf[0] < 0xF0)
+    {
+	if (buf[0] & 0x80)
+	{
+	    status = cur->Status = buf[0];
+	    count = 1;
+	}
+	else
+	{
+	    if ( !(status = cur->Status) ) return(MIDIERRSTATUS);
+	    buf[1] = buf[0];
+	    count = 2;
+	}
+
+	/* Read the rest of its data bytes after buf[0] (or the status), at buf[count] */
+	len = ((status & 0xE0) == 0xC0) ? 2 : 3;
+	if ( count < len && (result = MidiIORead(in, &buf[count], len - count)) ) return(result);
+
+	cv->Chans |= (1 << (status & 0x0F));
+	if ( pass != PASSALL && pass != (status & 0x0F) ) return(0);
+
+	buf[0] = status;
+	if (status == cv->RunStatus) return( write_head(cv, cur->Time, &buf[1], len - 1) );
+	cv->RunStatus = status;
+	return( write_head(cv, cur->Time, &buf[0], len) );
+    }
+
+    /* SYSEX, ESCAPE, or Meta-Event. buf gets its status, type, and length */
+    count = 1;
+    if (buf[0] == 0xFF)
+    {
+	if ( (result = MidiIORead(in, &buf[1], 1)) ) return(result);
+	count = 2;
+    }
+    else if (buf[0] != 0xF0 && buf[0] != 0xF7)
+	return(MIDIERREVENT);
+
+    if ( (result = MidiIOReadVLQ(in, &len)) ) return(result);
+
+    /* An End Of Track is skipped, and ends the MTrk */
+    if (buf[0] == 0xFF && buf[1] == 0x2F)
+    {
+	MidiSeek(in, (LONG)len);
+	return(-1);
+    }
+
+    if (pass != PASSALL && pass != PASSCONDUCT)
+    {
+	MidiSeek(in, (LONG)len);
+	return(0);
+    }
+
+    cv->RunStatus = 0;
+    count += MidiLongToVLQ(len, &buf[count]);
+    if ( (result = write_head(cv, cur->Time, &buf[0], count)) ) return(result);
+    return( copy_data(cv, len) );
+}
+
+
+
+
+/******************************** convert_pass() *******************************
+ * Reads all of the MTrks of the file being read, in order of time, and writes the events that
+ * pass wants as one MTrk (ending with an End Of Track at the time of the file's last event).
+ * With PASSSCAN, nothing is written. Returns 0 if success, or an error number.
+ **************************************************************************/
+
+static LONG convert_pass(CONVERT * cv, UCHAR pass)
+{
+    register MIDIFILE * in = cv->In;
+    register MERGE * mrg = &cv->Merge;
+    register CURSOR * cur;
+    register ULONG num;
+    UCHAR buf[3];
+    ULONG delta;
+    LONG result;
+
+    /* Start again from the MThd */
+    MidiSeek(in, -(LONG)(mrg->Size - in->FileSize));
+    if ( (result = MidiMergeChunks(in, mrg)) ) return(result);
+
+    if (pass != PASSSCAN)
+    {
+	memcpy(&cv->Out->ID, "MTrk", 4);
+	cv->Out->ChunkSize = 0;
+	if ( (result = MidiWriteHeader(cv->Out)) ) return(result);
+    }
+    cv->PrevTime = 0;
+    cv->RunStatus = 0;
+
+    for (num = mrg->NumCursors; num; )
+    {
+	cur = mrg->Heap[0];
+
+	/* Pick up where this MTrk left off. Usually, that's right where we are */
+	MidiSeek(in, (LONG)(cur->Offset - (mrg->Size - in->FileSize)));
+	in->ChunkSize = cur->Left;
+	if (cur->Time > cv->EndTime) cv->EndTime = cur->Time;
+
+	if ( (result = copy_event(cv, cur, pass)) && result != -1 ) return(result);
+	if ( in->ChunkSize < 0 ) return(MIDIERRBAD);
+
+	/* Is this MTrk done? */
+	if ( result == -1 || !in->ChunkSize )
+	{
+	    if (!--num) break;
+	    mrg->Heap[0] = mrg->Heap[num];
+	}
+	else
+	{
+	    if ( (result = MidiIOReadVLQ(in, &delta)) ) return(result);
+	    cur->Time += delta;
+	    cur->Offset = mrg->Size - in->FileSize;
+	    cur->Left = in->ChunkSize;
+	}
+
+	MidiSiftDown(mrg->Heap, num, 0);
+    }
+
+    if (pass == PASSSCAN) return(0);
+
+    buf[0] = 0xFF;
+    buf[1] = 0x2F;
+    buf[2] = 0;
+    if ( (result = write_head(cv, cv->EndTime, &buf[0], 3)) ) return(result);
+    return( MidiCloseChunk(cv->Out) );
+}
+
+
+
+
+/******************************** convert_file() *******************************
+ * Does the real work of MidiConvertFile() once both files are open.
+ **************************************************************************/
+
+static LONG convert_file(CONVERT * cv, USHORT format)
+{
+    register MIDIFILE * out = cv->Out;
+    register UCHAR chan;
+    UCHAR buf[6];
+    LONG result;
+
+    /* Find which MIDI channels are used */
+    if ( (result = convert_pass(cv, PASSSCAN)) ) return(result);
+
+    out->Format = format;
+    out->Division = cv->In->Division;
+    out->NumTracks = 1;
+    if (format)
+    {
+	for (chan = 0; chan < 16; chan++)
+	{
+	    if (cv->Chans & (1 << chan)) out->NumTracks++;
+	}
+    }
+
+    memcpy(&out->ID, "MThd", 4);
+    out->ChunkSize = 6;
+    if ( (result = MidiWriteHeader(out)) ) return(result);
+    buf[0] = (UCHAR)(out->Format >> 8);
+    buf[1] = (UCHAR)out->Format;
+    buf[2] = (UCHAR)(out->NumTracks >> 8);
+    buf[3] = (UCHAR)out->NumTracks;
+    buf[4] = (UCHAR)(out->Division >> 8);
+    buf[5] = (UCHAR)out->Division;
+    if ( (result = MidiIOWrite(out, &buf[0], 6)) ) return(result);
+
+    if (!format) return( convert_pass(cv, PASSALL) );
+
+    if ( (result = convert_pass(cv, PASSCONDUCT)) ) return(result);
+    for (chan = 0; chan < 16; chan++)
+    {
+	if ( (cv->Chans & (1 << chan)) && (result = convert_pass(cv, chan)) ) return(result);
+    }
+
+    return(0);
+}
+
+
+
+
+/******************************* compact_sysex() *******************************
+ * Copies a SYSEX or ESCAPE (whose status and length, len, have just been read) to the MTrk being
+ * written. With MIDICOMPACTSYSEX, the SYSEX CONTINUATION packets right after it (ie, with a 0
+ * delta-time, and nothing in between) are merged into it, so their delta-times, statuses, and
+ * lengths aren't written. Returns 0 if success, or an error number.
+ **************************************************************************/
+
+static LONG compact_sysex(CONVERT * cv, ULONG time, UCHAR status, ULONG len)
+{
+    register MIDIFILE * in = cv->In;
+    LONG start = in->ChunkSize;
+    ULONG total, more, pieces;
+    UCHAR buf[6];
+    UCHAR last, escape;
+    LONG result;
+
+    total = more = len;
+    pieces = 0;
+    last = escape = 0;
+
+    /* An 0xF0 starts a SYSEX. An 0xF7 is a CONTINUATION of it, or else an ESCAPE (which, between
+	a SYSEX's packets, starts with a status other than 0xF7) */
+    if (status == 0xF0) cv->SysexOpen = 1;
+    else if (cv->SysexOpen && len)
+    {
+	if ( (result = MidiIORead(in, &last, 1)) ) return(result);
+	MidiSeek(in, -1);
+	escape = ( (last & 0x80) && last != 0xF7 );
+    }
+
+    if (cv->SysexOpen && !escape)
+    {
+	/* Look ahead for the packets that finish the SYSEX (as long as they're at the same time) */
+	for (;;)
+	{
+	    if (more)
+	    {
+		MidiSeek(in, (LONG)more - 1);
+		if ( (result = MidiIORead(in, &last, 1)) ) return(result);
+	    }
+	    if ( last == 0xF7 || !(cv->Stats->Flags & MIDICOMPACTSYSEX) || in->ChunkSize <= 0 ) break;
+	    if ( (result = MidiIOReadVLQ(in, &more)) ) return(result);
+	    if (more) break;
+	    if ( (result = MidiIORead(in, &buf[0], 1)) ) return(result);
+	    if (buf[0] != 0xF7) break;
+	    if ( (result = MidiIOReadVLQ(in, &more)) ) return(result);
+
+	    /* An ESCAPE isn't part of the SYSEX, and the SYSEX is still open after it */
+	    if (more)
+	    {
+		if ( (result = MidiIORead(in, &last, 1)) ) return(result);
+		if ( (last & 0x80) && last != 0xF7 ) break;
+		MidiSeek(in, -1);
+	    }
+	    total += more;
+	    pieces++;
+	}
+	cv->SysexOpen = (last != 0xF7);
+	MidiSeek(in, in->ChunkSize - start);
+	cv->RunStatus = 0;
+    }
+
+    /* A REALTIME ESCAPE can be told not to cancel running status */
+    else
+    {
+	if (len == 1)
+	{
+	    if ( (result = MidiIORead(in, &last, 1)) ) return(result);
+	    MidiSeek(in, -1);
+	}
+	if ( len != 1 || last < 0xF8 || !(cv->Out->Flags & MIDIREALTIME) ) cv->RunStatus = 0;
+    }
+
+    buf[0] = status;
+    if ( (result = write_head(cv, time, &buf[0], 1 + MidiLongToVLQ(total, &buf[1]))) ) return(result);
+    if ( (result = copy_data(cv, len)) ) return(result);
+
+    /* Copy the data of each packet merged into it */
+    cv->Stats->Packets += pieces;
+    while (pieces--)
+    {
+	if ( (result = MidiIOReadVLQ(in, &more)) ) return(result);
+	if ( (result = MidiIORead(in, &buf[0], 1)) ) return(result);
+	if ( (result = MidiIOReadVLQ(in, &more)) ) return(result);
+	if ( (result = copy_data(cv, more)) ) return(result);
+    }
+
+    return(0);
+}
+
+
+
+
+/******************************* compact_track() *******************************
+ * Reads an MTrk (whose header has just been read) of the file being read, and writes it to the
+ * file being written as compactly as the MIDICOMPACT's Flags allow. MIDI events are written with
+ * running status wherever the MIDI file spec allows it (ie, not right after a SYSEX or
+ * Meta-Event). trk is its number in the file, counting from 1. With scan, nothing is written;
+ * the MTrk is only checked for which channels it has Controller events on. Returns 0 if success,
+ * or an error number.
+ **************************************************************************/
+
+static LONG compact_track(CONVERT * cv, USHORT trk, BOOL scan)
+{
+    register MIDIFILE * in = cv->In;
+    register UCHAR status = 0;
+    register UCHAR chan;
+    UCHAR buf[7];
+    ULONG time, len, count;
+    LONG result;
+
+    if (!scan)
+    {
+	memcpy(&cv->Out->ID, "MTrk", 4);
+	cv->Out->ChunkSize = 0;
+	if ( (result = MidiWriteHeader(cv->Out)) ) return(result);
+    }
+    cv->PrevTime = time = 0;
+    cv->RunStatus = cv->SysexOpen = 0;
+    memset(&cv->Ctl[0][0], 0xFF, sizeof(cv->Ctl));
+
+    while (in->ChunkSize > 0)
+    {
+	if ( (result = MidiIOReadVLQ(in, &len)) ) return(result);
+	time += len;
+	if ( (result = MidiIORead(in, &buf[0], 1)) ) return(result);
+
+	/* MIDI event with Status 0x80 to 0xEF (perhaps via running status) */
+	if (buf[0] < 0xF0)
+	{
+	    if (buf[0] & 0x80)
+	    {
+		status = buf[0];
+		count = 1;
+	    }
+	    else
+	    {
+		if (!status) return(MIDIERRSTATUS);
+		buf[1] = buf[0];
+		count = 2;
+	    }
+	    len = ((status & 0xE0) == 0xC0) ? 2 : 3;
+	    if ( count < len && (result = MidiIORead(in, &buf[count], len - count)) ) return(result);
+	    buf[0] = status;
+	    chan = status & 0x0F;
+	    cv->SysexOpen = 0;
+
+	    if ( (status & 0xF0) == 0xB0 )
+	    {
+		if (scan)
+		{
+		    if (!cv->Owner[chan])
+			cv->Owner[chan] = trk;
+		    else if (cv->Owner[chan] != trk)
+			cv->Owner[chan] = 0xFFFF;
+		    continue;
+		}
+
+		/* Drop a Controller that's set to the value it already has. But not if another
+		    MTrk could have changed it in between, nor for Data Entry and Data
+		    Increment/Decrement (which act on whatever parameter is selected), nor for
+		    Channel Mode messages. Reset All Controllers makes every value unknown */
+		if ( (cv->Stats->Flags & MIDICOMPACTCTL) && (in->Format != 1 || cv->Owner[chan] == trk) )
+		{
+		    if (buf[1] == 121)
+			memset(&cv->Ctl[chan][0], 0xFF, 128);
+		    else if ( buf[1] < 120 && buf[1] != 6 && buf[1] != 38 && buf[1] != 96 && buf[1] != 97 )
+		    {
+			if (cv->Ctl[chan][buf[1]] == buf[2])
+			{
+			    cv->Stats->Controllers++;
+			    continue;
+			}
+			cv->Ctl[chan][buf[1]] = buf[2];
+		    }
+		}
+	    }
+	    if (scan) continue;
+
+	    /* Note Off becomes Note On with 0 velocity, so it can share running status */
+	    if ( (status & 0xF0) == 0x80 && (cv->Stats->Flags & MIDICOMPACTNOTEOFF) )
+	    {
+		buf[0] = status | 0x10;
+		buf[2] = 0;
+		cv->Stats->NoteOffs++;
+	    }
+
+	    if (buf[0] == cv->RunStatus)
+		result = write_head(cv, time, &buf[1], len - 1);
+	    else
+	    {
+		cv->RunStatus = buf[0];
+		result = write_head(cv, time, &buf[0], len);
+	    }
+	    if (result) return(result);
+	    continue;
+	}
+
+	/* Meta-Event */
+	if (buf[0] == 0xFF)
+	{
+	    if ( (result = MidiIORead(in, &buf[1], 1)) ) return(result);
+	    if ( (result = MidiIOReadVLQ(in, &len)) ) return(result);
+	    cv->SysexOpen = 0;
+	    if (scan)
+		MidiSeek(in, (LONG)len);
+	    else
+	    {
+		cv->RunStatus = 0;
+		if ( (result = write_head(cv, time, &buf[0], 2 + MidiLongToVLQ(len, &buf[2]))) ) return(result);
+		if ( (result = copy_data(cv, len)) ) return(result);
+	    }
+
+	    /* Anything after the End Of Track is dropped */
+	    if (buf[1] == 0x2F)
+	    {
+		if (in->ChunkSize > 0) MidiSeek(in, in->ChunkSize);
+		break;
+	    }
+	    continue;
+	}
+
+	/* SYSEX, or SYSEX CONTINUATION/ESCAPE. This could be a reset, so forget the Controllers */
+	if (buf[0] != 0xF0 && buf[0] != 0xF7) return(MIDIERREVENT);
+	if ( (result = MidiIOReadVLQ(in, &len)) ) return(result);
+	memset(&cv->Ctl[0][0], 0xFF, sizeof(cv->Ctl));
+	if (scan)
+	    MidiSeek(in, (LONG)len);
+	else if ( (result = compact_sysex(cv, time, buf[0], len)) ) return(result);
+    }
+
+    if (in->ChunkSize < 0) return(MIDIERRBAD);
+    return( scan ? 0 : MidiCloseChunk(cv->Out) );
+}
+
+
+
+
+/****************************** compact_chunks() *******************************
+ * Does each chunk after the MThd for compact_file(). MTrks are compacted, and other chunks are
+ * copied as they are. With scan, nothing is written (see compact_track()). Returns 0 if success,
+ * or an error number.
+ **************************************************************************/
+
+static LONG compact_chunks(CONVERT * cv, BOOL scan)
+{
+    register MIDIFILE * in = cv->In;
+    register MIDIFILE * out = cv->Out;
+    register USHORT trk;
+    LONG result;
+
+    for (trk = 1; !(result = MidiNextChunk(in)); )
+    {
+	if ( MidiCompareID((UCHAR *)&in->ID, (UCHAR *)"MTrk") )
+	{
+	    if ( (result = compact_track(cv, trk++, scan)) ) return(result);
+	}
+	else if (!scan)
+	{
+	    memcpy(&out->ID, &in->ID, 4);
+	    out->ChunkSize = in->ChunkSize;
+	    if ( (result = MidiWriteHeader(out)) ) return(result);
+	    if ( (result = copy_data(cv, in->ChunkSize)) ) return(result);
+	}
+    }
+
+    return( (result == -1) ? 0 : result );
+}
+
+
+
+
+/******************************** compact_file() *******************************
+ * Does the real work of MidiCompactFile() once both files are open. arg isn't used (it's there
+ * so that this is a REWRITE, like convert_file(), whose arg is the format).
+ **************************************************************************/
+
+static LONG compact_file(CONVERT * cv, USHORT arg)
+{
+    register MIDIFILE * in = cv->In;
+    register MIDIFILE * out = cv->Out;
+    UCHAR buf[6];
+    LONG start, result;
+
+    (VOID)arg;
+
+    cv->Stats->InSize = in->FileSize;
+
+    /* Copy the MThd (but not any extra bytes after its 6) */
+    if ( (result = MidiReadMThd(in, FALSE)) ) return(result);
+    out->Format = in->Format;
+    out->NumTracks = in->NumTracks;
+    out->Division = in->Division;
+    buf[0] = (UCHAR)(in->Format >> 8);
+    buf[1] = (UCHAR)in->Format;
+    buf[2] = (UCHAR)(in->NumTracks >> 8);
+    buf[3] = (UCHAR)in->NumTracks;
+    buf[4] = (UCHAR)(in->Division >> 8);
+    buf[5] = (UCHAR)in->Division;
+
+    memcpy(&out->ID, "MThd", 4);
+    out->ChunkSize = 6;
+    if ( (result = MidiWriteHeader(out)) ) return(result);
+    if ( (result = MidiIOWrite(out, &buf[0], 6)) ) return(result);
+
+    /* In a Format 1, Controller repeats are dropped only on channels whose Controllers are all in
+	one MTrk, so find those first */
+    if ( in->Format == 1 && (cv->Stats->Flags & MIDICOMPACTCTL) )
+    {
+	start = in->FileSize;
+	if ( (result = compact_chunks(cv, TRUE)) ) return(result);
+	MidiSeek(in, in->FileSize - start);
+	in->ChunkSize = 0;
+    }
+
+    if ( (result = compact_chunks(cv, FALSE)) ) return(result);
+
+    cv->Stats->OutSize = out->FileSize;
+    return(0);
+}
+
+
+
+
+/******************************** rewrite_file() *******************************
+ * Opens in (just as with MidiReadFile(), but mapped into memory if the engine does the file
+ * I/O), and out (just as with MidiWriteFile()), and calls func to copy one to the other. Only
+ * the file I/O callbacks of in's CALLBACK are used (and if the app does in's file I/O, it must
+ * have a SeekMidi). in's MThd is checked before out is opened, so that out isn't truncated when
+ * in isn't a MIDI file, or its Format is over the CONVERT's MaxFormat. func starts back at the
+ * MThd. Returns 0 if success, or an error number.
+ **************************************************************************/
+
+static LONG rewrite_file(CONVERT * cv, REWRITE func, USHORT arg)
+{
+    register MIDIFILE * in = cv->In;
+    register MIDIFILE * out = cv->Out;
+    CALLBACK * cb = in->Callbacks;
+    USHORT mmap = in->Flags & MIDIMMAP;
+    CALLBACK io;
+    LONG result;
+
+    /* Only the app's file I/O is used, so it gets no StartMThd or StartMTrk */
+    memset(&io, 0, sizeof(CALLBACK));
+    io.OpenMidi = cb->OpenMidi;
+    io.ReadWriteMidi = cb->ReadWriteMidi;
+    io.SeekMidi = cb->SeekMidi;
+    io.CloseMidi = cb->CloseMidi;
+
+    /* We go back and forth in the file, so the app's file I/O must be able to seek */
+    if ( io.ReadWriteMidi && !io.SeekMidi ) return(MIDIERRREAD);
+
+    in->Callbacks = &io;
+    in->Flags = (in->Flags & ~(MIDIWRITE|MIDISYSEX|MIDIMEMIO)) | MIDIMMAP;
+    if ( !(result = MidiIOOpen(in)) )
+    {
+	cv->Merge.Size = in->FileSize;
+	if ( !(result = MidiReadMThd(in, FALSE)) && in->Format > cv->MaxFormat ) result = MIDIERRBAD;
+	MidiSeek(in, -(LONG)(cv->Merge.Size - in->FileSize));
+	in->ChunkSize = 0;
+
+	out->Flags = (out->Flags & ~(MIDISYSEX|MIDIMEMIO)) | MIDIWRITE;
+	if ( !result && !(result = MidiIOOpen(out)) )
+	{
+	    if ( !(result = func(cv, arg)) ) result = MidiIOFlush(out);
+	    MidiCloseFile(out);
+	}
+	MidiCloseFile(in);
+    }
+    in->Callbacks = cb;
+    in->Flags = (in->Flags & ~MIDIMMAP) | mmap;
+
+    free(cv->Merge.Heap);
+    free(cv->Merge.Cursors);
+    return(result);
+}
+
+
+
+
+/****************************** MidiConvertFile() *****************************
+ * Reads the MIDI file of in, and writes it to out as the specified format (0 or 1). in is opened
+ * just as with MidiReadFile() (and if the engine does the file I/O, it's mapped into memory, as
+ * with MidiReadMerged()). out is opened just as with MidiWriteFile(). Only the file I/O callbacks
+ * of their CALLBACKs are used (and if the app does in's file I/O, it must have a SeekMidi).
+ *   For Format 0, the events of all of in's MTrks are merged, in order of time, into one MTrk.
+ * For Format 1, the first MTrk gets all of the SYSEX and Meta-Events (eg, Tempo, Time Signature,
+ * and Key Signature), and then there's an MTrk for each MIDI channel that has events, in order
+ * of channel, with that channel's MIDI events. Either way, events at the same time keep the
+ * order of their MTrks in in, MIDI events are written with running status, and each MTrk ends
+ * with an End Of Track at the time of in's last event. in can be Format 0 or 1. Its other chunks
+ * aren't copied.
+ *   Only one MTrk of out is written at a time, from a pass over in, so memory use doesn't grow
+ * with the size of the files. Returns 0 if success, or an error number (MIDIERRBAD if format
+ * isn't 0 or 1, in which case neither file is opened, or if in is Format 2, in which case out
+ * isn't opened).
+ **************************************************************************/
+
+LONG EXPENTRY MidiConvertFile(MIDIFILE * in, MIDIFILE * out, USHORT format)
+{
+    CONVERT cv;
+
+    if (format > 1) return(MIDIERRBAD);
+
+    memset(&cv, 0, sizeof(CONVERT));
+    cv.In = in;
+    cv.Out = out;
+    cv.MaxFormat = 1;
+    return( rewrite_file(&cv, convert_file, format) );
+}
+
+
+
+
+/****************************** MidiCompactFile() *****************************
+ * Reads the MIDI file of in, and writes it to out in as few bytes as it can, without changing
+ * what it plays. in and out are opened just as with MidiConvertFile(). The MIDICOMPACT's Flags
+ * pick which of these are done, and its other fields are filled in with what was done:
+ *   Each MIDI event is written with running status wherever the MIDI file spec allows it (ie,
+ * other than after a SYSEX or Meta-Event). This is always done. With the MIDIREALTIME Flag of
+ * out, an ESCAPE of a REALTIME message doesn't cancel running status.
+ *   MIDICOMPACTNOTEOFF writes each Note Off as a Note On with 0 velocity (so that it can share
+ * running status with Note Ons). Note that any release velocity is lost.
+ *   MIDICOMPACTCTL drops each Controller event that sets the value that the Controller already
+ * has (ie, from an earlier event in the same MTrk). Data Entry, Data Increment/Decrement, and
+ * Channel Mode messages are always kept. So is everything after a Reset All Controllers or a
+ * SYSEX, until the Controller is set again. In a Format 1, this is done only on channels whose
+ * Controller events are all in one MTrk.
+ *   MIDICOMPACTSYSEX merges the SYSEX CONTINUATION packets that come right after a SYSEX packet
+ * (at the same time) into it.
+ *   Events after an End Of Track are dropped. Any chunks other than MTrks are copied as they are.
+ * Returns 0 if success, or an error number.
+ **************************************************************************/
+
+LONG EXPENTRY MidiCompactFile(MIDIFILE * in, MIDIFILE * out, MIDICOMPACT * stats)
+{
+    CONVERT cv;
+
+    memset(&cv, 0, sizeof(CONVERT));
+    cv.In = in;
+    cv.Out = out;
+    cv.Stats = stats;
+    cv.MaxFormat = 2;
+    stats->InSize = stats->OutSize = stats->NoteOffs = stats->Controllers = stats->Packets = 0;
+    return( rewrite_file(&cv, compact_file, 0) );
+}
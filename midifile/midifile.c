@@ -0,0 +1,1973 @@
+/* ===========================================================================
+ * midifile.c
+ *
+ * The MIDIFILE engine's MidiReadFile() and MidiWriteFile(). These parse/format the MThd and MTrk
+ * chunks of a MIDI file, calling the app's callbacks to process (or supply) each event.
+ * =========================================================================
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "midipriv.h"
+
+
+/* The META structures redefine a MIDIFILE, so their fields must line up with it. If any of
+    these fail to compile, the padding in midifile.h is wrong for this CPU. */
+#define MIDICHECK(name, cond) typedef char name[(cond) ? 1 : -1]
+MIDICHECK(check_tempo, offsetof(METATEMPO, RunStatus) == offsetof(MIDIFILE, RunStatus));
+MIDICHECK(check_bpm, offsetof(METATEMPO, TempoBPM) == offsetof(MIDIFILE, Data[6]));
+MIDICHECK(check_seq, offsetof(METASEQ, RunStatus) == offsetof(MIDIFILE, RunStatus));
+MIDICHECK(check_name, offsetof(METASEQ, NamePtr) == offsetof(MIDIFILE, EventSize));
+MIDICHECK(check_smpte, offsetof(METASMPTE, RunStatus) == offsetof(MIDIFILE, RunStatus));
+MIDICHECK(check_time, offsetof(METATIME, RunStatus) == offsetof(MIDIFILE, RunStatus));
+MIDICHECK(check_key, offsetof(METAKEY, RunStatus) == offsetof(MIDIFILE, RunStatus));
+MIDICHECK(check_end, offsetof(METAEND, RunStatus) == offsetof(MIDIFILE, RunStatus));
+MIDICHECK(check_txt, offsetof(METATXT, RunStatus) == offsetof(MIDIFILE, RunStatus));
+MIDICHECK(check_ptr, offsetof(METATXT, Ptr) == offsetof(MIDIFILE, Data[2]));
+MIDICHECK(check_skip, offsetof(METATXT, SkipEvents) == offsetof(MIDIFILE, SkipEvents));
+MIDICHECK(check_arena, offsetof(METATXT, Arena) == offsetof(MIDIFILE, Arena));
+MIDICHECK(check_stats, offsetof(METATXT, IOStats) == offsetof(MIDIFILE, IOStats));
+MIDICHECK(check_parent, offsetof(METATXT, Parent) == offsetof(MIDIFILE, Parent));
+MIDICHECK(check_bufsize, offsetof(METATXT, BufSize) == offsetof(MIDIFILE, BufSize));
+MIDICHECK(check_size, sizeof(METATXT) == sizeof(MIDIFILE));
+
+
+/* No end time for read_track() */
+#define NOEND 0xFFFFFFFF
+
+/* The Meta-Events that MidiReadRange() chases, in the order they're reported */
+static const UCHAR ChaseMetas[] = {0x51, 0x58, 0x59};
+#define CHASEMETAS (sizeof(ChaseMetas))
+
+/* The state of an MTrk (as of the last event read) that MidiReadRange() reports at its start
+    time. Any byte that's 0xFF hasn't been seen yet. Only controllers 0 to 119 are kept, since the
+    rest are Channel Mode messages (eg, All Notes Off) rather than settings. */
+typedef struct _CHASE
+{
+    UCHAR   Metas[CHASEMETAS][4]; /* Data of each of ChaseMetas */
+    UCHAR   Ctrl[16][120];	  /* Value of each controller, per channel */
+    UCHAR   Program[16];	  /* Program, per channel */
+    UCHAR   Pressure[16];	  /* Channel Pressure, per channel */
+    UCHAR   Bend[16][2];	  /* Pitch Wheel LSB and MSB, per channel */
+} CHASE;
+
+
+
+
+/******************************* fixed_len() **********************************
+ * Returns the length of a fixed length Meta-Event of the specified type, or -1 if that type is
+ * a variable length Meta-Event.
+ **************************************************************************/
+
+static LONG fixed_len(UCHAR type)
+{
+    switch (type)
+    {
+	case 0x00:
+	    return(2);
+	case 0x2F:
+	    return(0);
+	case 0x51:
+	    return(3);
+	case 0x54:
+	    return(5);
+	case 0x58:
+	    return(4);
+	case 0x59:
+	    return(2);
+    }
+    return(-1);
+}
+
+
+
+
+/******************************* meta_skip() **********************************
+ * Returns the MIDIFILE SkipEvents bit for a fixed length Meta-Event of the specified type, or 0
+ * if it can't be skipped (ie, End Of Track).
+ **************************************************************************/
+
+static ULONG meta_skip(UCHAR type)
+{
+    switch (type)
+    {
+	case 0x00:
+	    return(MIDISKIPSEQNUM);
+	case 0x51:
+	    return(MIDISKIPTEMPO);
+	case 0x54:
+	    return(MIDISKIPSMPTE);
+	case 0x58:
+	    return(MIDISKIPTIMESIG);
+	case 0x59:
+	    return(MIDISKIPKEYSIG);
+    }
+    return(0);
+}
+
+
+
+
+/******************************* meta_event() *********************************
+ * Loads the len bytes of data (at buf) of a fixed length Meta-Event of the specified type into
+ * the MIDIFILE (redefined as the appropriate META structure), and calls the app's respective
+ * callback. Returns 0 if success, or the callback's error number.
+ **************************************************************************/
+
+static LONG meta_event(MIDIFILE * mf, UCHAR type, const UCHAR * buf, ULONG len)
+{
+    register CALLBACK * cb = mf->Callbacks;
+    register CALL func;
+    ULONG val;
+    LONG result;
+
+    mf->Status = type;
+    mf->Data[0] = (UCHAR)len;
+    mf->Data[1] = 0;
+
+    switch (type)
+    {
+	case 0x00:
+	    ((METASEQ *)mf)->SeqNum = ((USHORT)buf[0] << 8) | buf[1];
+	    func = cb->MetaSeqNum;
+	    break;
+
+	case 0x2F:
+	    func = cb->MetaEOT;
+	    break;
+
+	case 0x51:
+	    val = ((ULONG)buf[0] << 16) | ((ULONG)buf[1] << 8) | buf[2];
+	    ((METATEMPO *)mf)->Tempo = val;
+	    if (val) val = (60000000 + (val >> 1)) / val;
+	    ((METATEMPO *)mf)->TempoBPM = (val > 255) ? 255 : (UCHAR)val;
+	    func = cb->MetaTempo;
+	    break;
+
+	case 0x54:
+	    memcpy(&((METASMPTE *)mf)->Hours, &buf[0], 5);
+	    func = cb->MetaSMPTE;
+	    break;
+
+	case 0x58:
+	    ((METATIME *)mf)->Nom = buf[0];
+	    ((METATIME *)mf)->Denom = (mf->Flags & MIDIDENOM) ? (UCHAR)(1 << (buf[1] & 7)) : buf[1];
+	    ((METATIME *)mf)->Clocks = buf[2];
+	    ((METATIME *)mf)->_32nds = buf[3];
+	    func = cb->MetaTimeSig;
+	    break;
+
+	default: /* 0x59 */
+	    ((METAKEY *)mf)->Key = (CHAR)buf[0];
+	    ((METAKEY *)mf)->Minor = buf[1];
+	    func = cb->MetaKeySig;
+    }
+
+    if ( func && (result = func(mf)) ) return(result);
+
+    return(0);
+}
+
+
+
+
+/******************************** call_data() *********************************
+ * Calls the app's SysexEvt or MetaText callback (func) for a SYSEX or variable length
+ * Meta-Event, once EventSize has been set. If the MIDIFILE has an Arena, the data is first read
+ * into memory from that, and Ptr set to it. Afterward, skips whatever of the event the callback
+ * didn't read. Returns 0 if success, or an error number.
+ **************************************************************************/
+
+static LONG call_data(MIDIFILE * mf, CALL func)
+{
+    register ULONG len;
+    LONG result;
+
+    if (func)
+    {
+	if (mf->Arena)
+	{
+	    MIDIDATAPTR(mf) = 0;
+	    if ( (len = mf->EventSize) )
+	    {
+		if ( mf->EventSize > mf->ChunkSize ) return(MIDIERRBAD);
+		if ( !(MIDIDATAPTR(mf) = MidiArenaAlloc(mf->Arena, len)) ) return(MIDIERRREAD);
+		if ( (result = MidiIORead(mf, MIDIDATAPTR(mf), len)) ) return(result);
+	    }
+	    result = func(mf);
+	    mf->EventSize = 0;
+	    return(result);
+	}
+
+	if ( (result = func(mf)) ) return(result);
+    }
+
+    MidiSkipEvent(mf);
+    return(0);
+}
+
+
+
+
+/******************************** MidiEndSysex() *******************************
+ * Passes the SYSEX that MIDIWHOLESYSEX has been putting back together in the MIDIFILE's Arena
+ * to the app's SysexEvt callback, with the Time and TrackNum of its last packet, if there is
+ * one. Returns 0 if success (or none), or an error number.
+ **************************************************************************/
+
+LONG MidiEndSysex(MIDIFILE * mf)
+{
+    register MIDIARENA * arena = mf->Arena;
+    register CALL func = mf->Callbacks->SysexEvt;
+    register UCHAR * ptr;
+    ULONG time;
+    UCHAR status, track;
+    LONG result;
+
+    if ( !arena || !arena->Sysex ) return(0);
+
+    /* Done with it, even if the callback fails */
+    ptr = arena->Sysex;
+    arena->Sysex = 0;
+    if (!func) return(0);
+
+    status = mf->Status;
+    time = mf->Time;
+    track = mf->TrackNum;
+    mf->Status = 0xF0;
+    mf->EventSize = arena->SysexLen;
+    mf->Time = arena->SysexTime;
+    mf->TrackNum = arena->SysexTrack;
+    MIDIDATAPTR(mf) = ptr;
+
+    result = func(mf);
+
+    mf->Status = status;
+    mf->Time = time;
+    mf->TrackNum = track;
+    mf->EventSize = 0;
+    return(result);
+}
+
+
+
+
+/******************************** whole_sysex() ********************************
+ * Reads a SYSEX (chr is 0xF0) or SYSEX CONTINUATION/ESCAPE (0xF7) for MIDIWHOLESYSEX, once
+ * EventSize has been set. An 0xF0 starts a message in the MIDIFILE's Arena, and an 0xF7 that
+ * continues it (ie, in the same MTrk, and whose first byte isn't a status) is added onto it.
+ * Once the message ends with 0xF7, it's passed to the app's SysexEvt callback (func). Other
+ * 0xF7 events are passed to func as they are. Returns 0 if success, or an error number.
+ **************************************************************************/
+
+static LONG whole_sysex(MIDIFILE * mf, UCHAR chr, CALL func)
+{
+    register MIDIARENA * arena = mf->Arena;
+    register ULONG len = mf->EventSize;
+    UCHAR * ptr;
+    ULONG max;
+    UCHAR first;
+    LONG result;
+
+    if ( mf->EventSize > mf->ChunkSize ) return(MIDIERRBAD);
+
+    if (chr == 0xF0)
+    {
+	/* Only one message can be put together at a time (with MidiReadMerged(), that's not
+	    necessarily from this MTrk) */
+	if ( (result = MidiEndSysex(mf)) ) return(result);
+	arena->SysexLen = arena->SysexMax = 0;
+	first = 0;
+    }
+    else
+    {
+	/* Not a continuation of a message being put together? Then pass it on as is */
+	if ( !arena->Sysex || arena->SysexTrack != mf->TrackNum ) return( call_data(mf, func) );
+	if (!len)
+	{
+	    arena->SysexTime = mf->Time;
+	    return(0);
+	}
+	if ( (result = MidiIORead(mf, &first, 1)) ) return(result);
+	if ( (first & 0x80) && first != 0xF7 )
+	{
+	    if ( !(ptr = MidiArenaAlloc(arena, len)) ) return(MIDIERRREAD);
+	    *ptr = first;
+	    if ( len > 1 && (result = MidiIORead(mf, ptr + 1, len - 1)) ) return(result);
+	    MIDIDATAPTR(mf) = ptr;
+	    result = func(mf);
+	    mf->EventSize = 0;
+	    return(result);
+	}
+    }
+
+    /* Make room to add the packet onto the message (doubling the room each time, so that a
+	message of many packets isn't copied over and over) */
+    if ( !arena->Sysex || arena->SysexLen + len > arena->SysexMax )
+    {
+	max = arena->SysexMax << 1;
+	if (max < arena->SysexLen + len) max = arena->SysexLen + len;
+	if (max < 64) max = 64;
+	if ( !(ptr = MidiArenaAlloc(arena, max)) ) return(MIDIERRREAD);
+	if (arena->SysexLen) memcpy(ptr, arena->Sysex, arena->SysexLen);
+	arena->Sysex = ptr;
+	arena->SysexMax = max;
+    }
+
+    ptr = arena->Sysex + arena->SysexLen;
+    if (chr == 0xF7)
+    {
+	*ptr++ = first;
+	len--;
+	arena->SysexLen++;
+    }
+    if ( len && (result = MidiIORead(mf, ptr, len)) ) return(result);
+    arena->SysexLen += len;
+    arena->SysexTime = mf->Time;
+    arena->SysexTrack = mf->TrackNum;
+    mf->EventSize = 0;
+
+    /* Is that the end of it? */
+    if ( arena->SysexLen && arena->Sysex[arena->SysexLen - 1] == 0xF7 ) return( MidiEndSysex(mf) );
+    return(0);
+}
+
+
+
+
+/******************************* read_meta() **********************************
+ * Reads the remainder of a Meta-Event (ie, after the 0xFF), and calls the app's respective
+ * callback. For fixed length Meta-Events, see meta_event(). For others, the type is stored in
+ * Status, and EventSize is set for the app's MetaText callback (see call_data()). If
+ * chase isn't 0, any Meta-Event that MidiReadRange() chases is stored in it. Returns 0 if
+ * success, -1 if an End Of Track was read, or an error number.
+ **************************************************************************/
+
+static LONG read_meta(MIDIFILE * mf, CHASE * chase)
+{
+    register CALLBACK * cb = mf->Callbacks;
+    register ULONG i;
+    UCHAR buf[5];
+    UCHAR type;
+    ULONG len;
+    LONG result;
+
+    if ( (result = MidiIORead(mf, &type, 1)) ) return(result);
+    if ( (result = MidiIOReadVLQ(mf, &len)) ) return(result);
+
+    mf->Status = type;
+
+    /* A Meta-Event means no more SYSEX CONTINUATION packets, and cancels running status */
+    mf->Flags &= ~MIDISYSEX;
+    mf->RunStatus = 0;
+
+    /* Variable length (or a "fixed" length event with the wrong length) */
+    if ( fixed_len(type) != (LONG)len )
+    {
+	mf->EventSize = len;
+	return( call_data(mf, (mf->SkipEvents & MIDISKIPTEXT) ? 0 : cb->MetaText) );
+    }
+
+    /* Skipped without loading it (and so not chased either) */
+    if (mf->SkipEvents & meta_skip(type))
+    {
+	MidiSeek(mf, (LONG)len);
+	return(0);
+    }
+
+    if ( len && (result = MidiIORead(mf, &buf[0], len)) ) return(result);
+
+    if (chase)
+    {
+	for (i = 0; i < CHASEMETAS; i++)
+	{
+	    if (ChaseMetas[i] == type) memcpy(&chase->Metas[i][0], &buf[0], len);
+	}
+    }
+
+    if ( (result = meta_event(mf, type, &buf[0], len)) ) return(result);
+
+    return( (type == 0x2F) ? -1 : 0 );
+}
+
+
+
+
+/******************************** chase_evt() *********************************
+ * Calls the app's StandardEvt for a MIDI event that send_chase() reports.
+ **************************************************************************/
+
+static LONG chase_evt(MIDIFILE * mf, UCHAR status, UCHAR data1, UCHAR data2)
+{
+    register CALLBACK * cb = mf->Callbacks;
+
+    mf->Status = status;
+    mf->Data[0] = data1;
+    mf->Data[1] = data2;
+    return( (cb->StandardEvt) ? cb->StandardEvt(mf) : 0 );
+}
+
+
+
+
+/******************************* send_chase() *********************************
+ * Reports the state of an MTrk (ie, the Meta-Events and MIDI settings stored in chase) to the
+ * app's callbacks, as events at the time start, with the MIDICHASE Flag set. Returns 0 if
+ * success, or a callback's error number.
+ **************************************************************************/
+
+static LONG send_chase(MIDIFILE * mf, CHASE * chase, ULONG start)
+{
+    register ULONG i, chan;
+    register UCHAR * ptr;
+    ULONG delta = start - mf->PrevTime;
+    UCHAR runstatus = mf->RunStatus;
+    LONG result = 0;
+
+/* Sets the Time of the next reported event. With MIDIDELTA, only the first has a delta */
+#define CHASETIME() \
+    mf->Time = (mf->Flags & MIDIDELTA) ? delta : start; \
+    delta = 0
+
+    mf->PrevTime = start;
+    mf->EventSize = 0;
+    mf->Flags = (mf->Flags & ~MIDISYSEX) | MIDICHASE;
+
+    for (i = 0; i < CHASEMETAS && !result; i++)
+    {
+	if (chase->Metas[i][0] != 0xFF)
+	{
+	    CHASETIME();
+	    result = meta_event(mf, ChaseMetas[i], &chase->Metas[i][0], (ULONG)fixed_len(ChaseMetas[i]));
+	}
+    }
+
+    /* Controllers first, so that a Bank Select precedes its Program Change */
+    for (chan = 0; chan < 16 && !result; chan++)
+    {
+	ptr = &chase->Ctrl[chan][0];
+	for (i = 0; i < 120 && !result; i++)
+	{
+	    if (ptr[i] != 0xFF)
+	    {
+		CHASETIME();
+		result = chase_evt(mf, (UCHAR)(0xB0 | chan), (UCHAR)i, ptr[i]);
+	    }
+	}
+	if (!result && chase->Program[chan] != 0xFF)
+	{
+	    CHASETIME();
+	    result = chase_evt(mf, (UCHAR)(0xC0 | chan), chase->Program[chan], 0xFF);
+	}
+	if (!result && chase->Pressure[chan] != 0xFF)
+	{
+	    CHASETIME();
+	    result = chase_evt(mf, (UCHAR)(0xD0 | chan), chase->Pressure[chan], 0xFF);
+	}
+	if (!result && chase->Bend[chan][0] != 0xFF)
+	{
+	    CHASETIME();
+	    result = chase_evt(mf, (UCHAR)(0xE0 | chan), chase->Bend[chan][0], chase->Bend[chan][1]);
+	}
+    }
+
+    mf->Flags &= ~MIDICHASE;
+    mf->RunStatus = runstatus;
+    return(result);
+}
+
+
+
+
+/******************************** read_event() ********************************
+ * Reads one event of an MTrk (after its delta-time), and calls the app's callback for it.
+ * *status is the MIDI status that running status resolves to, and is updated for the next
+ * event. If chase isn't 0, any setting that MidiReadRange() chases is stored in it. An event that
+ * the MIDIFILE's SkipChans or SkipEvents rules out is skipped without calling any callback.
+ * Returns 0 if success, -1 if an End Of Track was read, or an error number.
+ **************************************************************************/
+
+static LONG read_event(MIDIFILE * mf, UCHAR * status, CHASE * chase)
+{
+    register CALLBACK * cb = mf->Callbacks;
+    register UCHAR stat = *status;
+    CALL func;
+    UCHAR chr;
+    ULONG len;
+    LONG result;
+
+    if ( (result = MidiIORead(mf, &chr, 1)) ) return(result);
+
+    /* Anything but an 0xF7 ends any SYSEX of this MTrk that MIDIWHOLESYSEX is putting together */
+    if ( chr != 0xF7 && mf->Arena && mf->Arena->Sysex && mf->Arena->SysexTrack == mf->TrackNum &&
+	 (result = MidiEndSysex(mf)) ) return(result);
+
+    /* MIDI event with Status 0x80 to 0xEF (perhaps via running status) */
+    if (chr < 0xF0)
+    {
+	if (chr & 0x80)
+	    *status = stat = chr;
+	else if (!stat)
+	    return(MIDIERRSTATUS);
+
+	/* Does the app want it skipped (by its kind or channel)? Then seek past its data bytes,
+	    not counting chr if that's the first one */
+	if ( ((mf->SkipEvents >> ((stat >> 4) - 8)) | (mf->SkipChans >> (stat & 0x0F))) & 1 )
+	{
+	    MidiSeek(mf, (((stat & 0xE0) == 0xC0) ? 1 : 2) - ((chr & 0x80) ? 0 : 1));
+	    mf->Flags &= ~MIDISYSEX;
+	    mf->RunStatus = stat;
+	    return(0);
+	}
+
+	if (chr & 0x80)
+	{
+	    if ( (result = MidiIORead(mf, &mf->Data[0], 1)) ) return(result);
+	}
+	else
+	    mf->Data[0] = chr;
+	mf->Status = stat;
+
+	/* Program Change and Channel Pressure have only 1 data byte */
+	if ( (stat & 0xE0) == 0xC0 )
+	    mf->Data[1] = 0xFF;
+	else if ( (result = MidiIORead(mf, &mf->Data[1], 1)) ) return(result);
+
+	mf->Flags &= ~MIDISYSEX;
+	if ( cb->StandardEvt && (result = cb->StandardEvt(mf)) ) return(result);
+	mf->RunStatus = stat;
+
+	/* Keep any setting that MidiReadRange() chases */
+	if (chase)
+	{
+	    chr = stat & 0x0F;
+	    switch (stat & 0xF0)
+	    {
+		case 0xB0:
+		    if (mf->Data[0] < 120) chase->Ctrl[chr][mf->Data[0]] = mf->Data[1];
+		    break;
+		case 0xC0:
+		    chase->Program[chr] = mf->Data[0];
+		    break;
+		case 0xD0:
+		    chase->Pressure[chr] = mf->Data[0];
+		    break;
+		case 0xE0:
+		    chase->Bend[chr][0] = mf->Data[0];
+		    chase->Bend[chr][1] = mf->Data[1];
+	    }
+	}
+	return(0);
+    }
+
+    switch (chr)
+    {
+	/* SYSEX, or SYSEX CONTINUATION/ESCAPE */
+	case 0xF0:
+	    mf->Flags |= MIDISYSEX;
+	    /* fall through */
+	case 0xF7:
+	    mf->Status = chr;
+	    if ( (result = MidiIOReadVLQ(mf, &len)) ) return(result);
+	    mf->EventSize = len;
+	    func = (mf->SkipEvents & ((chr == 0xF0) ? MIDISKIPSYSEX : MIDISKIPESCAPE)) ? 0 : cb->SysexEvt;
+	    if ( func && mf->Arena && (mf->Flags & MIDIWHOLESYSEX) )
+		result = whole_sysex(mf, chr, func);
+	    else
+		result = call_data(mf, func);
+	    if (result) return(result);
+
+	    /* An ESCAPE may be REALTIME, which can be told not to cancel running status */
+	    if ( chr == 0xF0 || !(mf->Flags & MIDIREALTIME) ) mf->RunStatus = 0;
+	    return(0);
+
+	/* Meta-Event */
+	case 0xFF:
+	    return( read_meta(mf, chase) );
+    }
+
+    return(MIDIERREVENT);
+}
+
+
+
+
+/******************************* read_events() ********************************
+ * Reads the events of an MTrk one at a time, calling the app's callbacks, until an End Of Track,
+ * the end of the chunk, or an event at (or after) the time end. status is the MIDI status that
+ * running status resolves to at first. Until an event's time reaches start, the MIDIFILE's
+ * Callbacks is quiet instead of the app's (app). Meanwhile, if chase isn't 0, the MTrk's state
+ * is stored in it, and then reported before that event.
+ **************************************************************************/
+
+static LONG read_events(MIDIFILE * mf, UCHAR status, ULONG start, ULONG end, CALLBACK * app, CHASE * chase)
+{
+    register CALLBACK * cb = mf->Callbacks;
+    ULONG delta, time;
+    LONG result;
+
+    while (mf->ChunkSize > 0)
+    {
+	/* Get the event's time */
+	if ( (result = MidiIOReadVLQ(mf, &delta)) ) return(result);
+	time = mf->PrevTime + delta;
+
+	/* Reached the first event that the app wants? */
+	if ( cb != app && time >= start )
+	{
+	    mf->Callbacks = cb = app;
+	    if ( chase && (result = send_chase(mf, chase, start)) ) return(result);
+	}
+
+	/* Past the last one? */
+	if (time >= end) return(0);
+
+	mf->Time = (mf->Flags & MIDIDELTA) ? time - mf->PrevTime : time;
+	mf->PrevTime = time;
+	mf->EventSize = 0;
+
+	if ( (result = read_event(mf, &status, (cb != app) ? chase : 0)) )
+	{
+	    if (result == -1) return(0);
+	    return(result);
+	}
+    }
+
+    return(0);
+}
+
+
+
+
+/******************************* read_track() *********************************
+ * Reads the events of an MTrk, calling the app's callbacks. If chk isn't 0, the file is at that
+ * checkpoint within the MTrk (rather than its first event). Events before the time start are
+ * read without calling any of the app's callbacks (other than for file I/O), and reading stops
+ * at the first event at (or after) the time end. If chase is TRUE, the MTrk's state at start is
+ * reported too (see MidiReadRange()).
+ **************************************************************************/
+
+static LONG read_track(MIDIFILE * mf, const MIDICHECKPOINT * chk, ULONG start, ULONG end, BOOL chase)
+{
+    register CALLBACK * cb = mf->Callbacks;
+    CALLBACK quiet;
+    CHASE state;
+    UCHAR status = 0;	/* Last MIDI status, for resolving running status */
+    LONG result;
+
+    mf->PrevTime = 0;
+    mf->RunStatus = 0;
+    mf->Flags &= ~MIDISYSEX;
+    if (mf->Arena) mf->Arena->Sysex = 0;
+
+    if (chk)
+    {
+	mf->PrevTime = chk->Time;
+	mf->RunStatus = chk->RunStatus;
+	status = chk->Status;
+    }
+
+    /* A SYSEX that MIDIWHOLESYSEX is putting together ends with the MTrk */
+    if (!start && !chase)
+    {
+	if ( !(result = read_events(mf, status, 0, end, cb, 0)) ) result = MidiEndSysex(mf);
+	return(result);
+    }
+
+    /* A copy of the app's CALLBACK, with only its file I/O */
+    memset(&quiet, 0, sizeof(CALLBACK));
+    quiet.OpenMidi = cb->OpenMidi;
+    quiet.ReadWriteMidi = cb->ReadWriteMidi;
+    quiet.SeekMidi = cb->SeekMidi;
+    quiet.CloseMidi = cb->CloseMidi;
+    mf->Callbacks = &quiet;
+
+    if (chase) memset(&state, 0xFF, sizeof(CHASE));
+
+    result = read_events(mf, status, start, end, cb, (chase) ? &state : 0);
+
+    /* If the MTrk ended before start, its state is still reported */
+    if ( mf->Callbacks == &quiet )
+    {
+	mf->Callbacks = cb;
+	if ( !result && chase ) result = send_chase(mf, &state, start);
+    }
+
+    mf->Callbacks = cb;
+    if (!result) result = MidiEndSysex(mf);
+    return(result);
+}
+
+
+
+
+/******************************* MidiReadMThd() *******************************
+ * Reads the MThd of a file just opened for reading, setting the MIDIFILE's Format, NumTracks, and
+ * Division, and leaves the file at the chunk after the MThd. If call, the app's StartMThd is
+ * called too (the loaders that don't take a CALLBACK pass FALSE). Returns 0 if success, or an
+ * error number.
+ **************************************************************************/
+
+LONG MidiReadMThd(MIDIFILE * mf, BOOL call)
+{
+    register CALLBACK * cb = mf->Callbacks;
+    UCHAR buf[6];
+    LONG result;
+
+    mf->TrackNum = 0xFF;
+    mf->ChunkSize = mf->EventSize = 0;
+
+    /* Load the MThd */
+    if ( mf->FileSize < 14 ) return(MIDIERRNOMIDI);
+    if ( (result = MidiReadHeader(mf)) ) return(result);
+    if ( !MidiCompareID((UCHAR *)&mf->ID, (UCHAR *)"MThd") ) return(MIDIERRNOMIDI);
+    if ( mf->ChunkSize < 6 || mf->ChunkSize > mf->FileSize ) return(MIDIERRBAD);
+    if ( (result = MidiIORead(mf, &buf[0], 6)) ) return(result);
+    mf->Format = ((USHORT)buf[0] << 8) | buf[1];
+    mf->NumTracks = ((USHORT)buf[2] << 8) | buf[3];
+    mf->Division = ((USHORT)buf[4] << 8) | buf[5];
+
+    if ( call && cb->StartMThd && (result = cb->StartMThd(mf)) ) return(result);
+    MidiSkipChunk(mf);
+
+    return(0);
+}
+
+
+
+
+/******************************* MidiReadEvent() ******************************
+ * Reads one event of an MTrk (starting with its delta-time), calling the app's callbacks, for
+ * MidiParserFeed(). *status is the MIDI status that running status resolves to, and is updated
+ * for the next event. Returns 0 if success, -1 if an End Of Track was read, or an error number.
+ **************************************************************************/
+
+LONG MidiReadEvent(MIDIFILE * mf, UCHAR * status)
+{
+    ULONG delta, time;
+    LONG result;
+
+    if ( (result = MidiIOReadVLQ(mf, &delta)) ) return(result);
+    time = mf->PrevTime + delta;
+    mf->Time = (mf->Flags & MIDIDELTA) ? delta : time;
+    mf->PrevTime = time;
+    mf->EventSize = 0;
+
+    return( read_event(mf, status, 0) );
+}
+
+
+
+
+/******************************* read_file() **********************************
+ * Does the real work of MidiReadFile() and MidiReadRange() once the file is open.
+ **************************************************************************/
+
+static LONG read_file(MIDIFILE * mf, ULONG start, ULONG end, BOOL chase)
+{
+    register CALLBACK * cb = mf->Callbacks;
+    register UCHAR * ptr;
+    LONG result;
+
+    if ( (result = MidiReadMThd(mf, TRUE)) ) return(result);
+
+    /* Load each chunk after it */
+    while ( !(result = MidiNextChunk(mf)) )
+    {
+	if ( MidiCompareID((UCHAR *)&mf->ID, (UCHAR *)"MTrk") )
+	{
+	    mf->TrackNum++;
+	    mf->Time = 0;
+	    MIDIDATAPTR(mf) = 0;
+
+	    /* A -1 from StartMTrk skips this MTrk */
+	    if ( cb->StartMTrk && (result = cb->StartMTrk(mf)) )
+	    {
+		if (result != -1) return(result);
+	    }
+
+	    /* Does the app want the whole MTrk loaded into its buffer? */
+	    else if ( (ptr = MIDIDATAPTR(mf)) )
+	    {
+		if ( (result = MidiIORead(mf, ptr, mf->ChunkSize)) ) return(result);
+		if ( cb->StandardEvt && (result = cb->StandardEvt(mf)) ) return(result);
+	    }
+
+	    else
+	    {
+		if ( (result = read_track(mf, 0, start, end, chase)) ) return(result);
+	    }
+	}
+	else
+	{
+	    mf->EventSize = 0;
+	    if ( cb->UnknownChunk && (result = cb->UnknownChunk(mf)) ) return(result);
+	}
+    }
+
+    return( (result == -1) ? 0 : result );
+}
+
+
+
+
+/****************************** find_checkpoint() *****************************
+ * Returns the last of an MTrk's checkpoints before the time start, or 0 if there's none (ie,
+ * the MTrk must be read from its first event).
+ **************************************************************************/
+
+static const MIDICHECKPOINT * find_checkpoint(const MIDIINDEX * idx, const MIDITRACKINFO * trk, ULONG start)
+{
+    register const MIDICHECKPOINT * chk = &idx->Checks[trk->FirstCheck];
+    register ULONG lo = 0, hi = trk->NumChecks, mid;
+
+    /* A checkpoint's Time is that of the event before it, so an event at start can't be before
+	a checkpoint whose Time is less than start */
+    while (lo < hi)
+    {
+	mid = (lo + hi) >> 1;
+	if (chk[mid].Time < start)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+
+    return( (lo) ? &chk[lo - 1] : 0 );
+}
+
+
+
+
+/******************************** read_from() **********************************
+ * Does the real work of MidiReadFrom() once the file is open.
+ **************************************************************************/
+
+static LONG read_from(MIDIFILE * mf, const MIDIINDEX * idx, ULONG start)
+{
+    register CALLBACK * cb = mf->Callbacks;
+    register const MIDITRACKINFO * trk;
+    register const MIDICHECKPOINT * chk;
+    register UCHAR * ptr;
+    ULONG filesize = mf->FileSize;
+    ULONG num = 0;
+    LONG result;
+
+    /* The index must be for this file */
+    if ( filesize != idx->FileSize ) return(MIDIERRBAD);
+
+    if ( (result = MidiReadMThd(mf, TRUE)) ) return(result);
+
+    while ( !(result = MidiNextChunk(mf)) )
+    {
+	if ( MidiCompareID((UCHAR *)&mf->ID, (UCHAR *)"MTrk") )
+	{
+	    trk = &idx->Tracks[num];
+	    if ( num++ >= idx->NumTracks || trk->Offset != filesize - (ULONG)mf->FileSize ||
+		 trk->Size != (ULONG)mf->ChunkSize ) return(MIDIERRBAD);
+
+	    mf->TrackNum++;
+	    mf->Time = 0;
+	    MIDIDATAPTR(mf) = 0;
+
+	    /* A -1 from StartMTrk skips this MTrk */
+	    if ( cb->StartMTrk && (result = cb->StartMTrk(mf)) )
+	    {
+		if (result != -1) return(result);
+	    }
+
+	    /* Does the app want the whole MTrk loaded into its buffer? */
+	    else if ( (ptr = MIDIDATAPTR(mf)) )
+	    {
+		if ( (result = MidiIORead(mf, ptr, mf->ChunkSize)) ) return(result);
+		if ( cb->StandardEvt && (result = cb->StandardEvt(mf)) ) return(result);
+	    }
+
+	    /* Unless there's nothing at or after start, skip to the checkpoint and read from there */
+	    else if ( !start || trk->EndTime >= start )
+	    {
+		if ( (chk = find_checkpoint(idx, trk, start)) ) MidiSeek(mf, (LONG)(chk->Offset - trk->Offset));
+		if ( (result = read_track(mf, chk, start, NOEND, FALSE)) ) return(result);
+	    }
+	}
+	else
+	{
+	    mf->EventSize = 0;
+	    if ( cb->UnknownChunk && (result = cb->UnknownChunk(mf)) ) return(result);
+	}
+    }
+
+    return( (result == -1) ? 0 : result );
+}
+
+
+
+
+/***************************** MidiMergeChunks() *******************************
+ * Does the MThd and every chunk of a file for MidiReadMerged() (or MidiConvertFile()), except
+ * that for each MTrk, only its StartMTrk is called, and a CURSOR is added to the MERGE for it.
+ * Then the MERGE's Heap is made. Any CURSORs from before are discarded (but their memory is
+ * reused). Returns 0 if success, or an error number.
+ **************************************************************************/
+
+LONG MidiMergeChunks(MIDIFILE * mf, MERGE * mrg)
+{
+    register CALLBACK * cb = mf->Callbacks;
+    register CURSOR * cur;
+    register UCHAR * ptr;
+    ULONG delta, max;
+    LONG result;
+
+    mrg->NumCursors = 0;
+    if ( (result = MidiReadMThd(mf, TRUE)) ) return(result);
+
+    while ( !(result = MidiNextChunk(mf)) )
+    {
+	if ( MidiCompareID((UCHAR *)&mf->ID, (UCHAR *)"MTrk") )
+	{
+	    mf->TrackNum++;
+	    mf->Time = 0;
+	    MIDIDATAPTR(mf) = 0;
+
+	    /* A -1 from StartMTrk skips this MTrk */
+	    if ( cb->StartMTrk && (result = cb->StartMTrk(mf)) )
+	    {
+		if (result != -1) return(result);
+	    }
+
+	    /* Does the app want the whole MTrk loaded into its buffer? */
+	    else if ( (ptr = MIDIDATAPTR(mf)) )
+	    {
+		if ( (result = MidiIORead(mf, ptr, mf->ChunkSize)) ) return(result);
+		if ( cb->StandardEvt && (result = cb->StandardEvt(mf)) ) return(result);
+	    }
+
+	    else if (mf->ChunkSize > 0)
+	    {
+		if (mrg->NumCursors >= mrg->MaxCursors)
+		{
+		    max = (mrg->MaxCursors) ? mrg->MaxCursors << 1 : (mf->NumTracks ? mf->NumTracks : 16);
+		    if ( !(cur = (CURSOR *)realloc(mrg->Cursors, max * sizeof(CURSOR))) ) return(MIDIERRREAD);
+		    mrg->Cursors = cur;
+		    mrg->MaxCursors = max;
+		}
+
+		/* Get the time of its first event, and leave the rest for later */
+		if ( (result = MidiIOReadVLQ(mf, &delta)) ) return(result);
+		cur = &mrg->Cursors[mrg->NumCursors];
+		cur->Offset = mrg->Size - mf->FileSize;
+		cur->Left = mf->ChunkSize;
+		cur->Time = delta;
+		cur->Num = mrg->NumCursors++;
+		cur->Flags = 0;
+		cur->TrackNum = mf->TrackNum;
+		cur->Status = cur->RunStatus = 0;
+	    }
+	}
+	else
+	{
+	    mf->EventSize = 0;
+	    if ( cb->UnknownChunk && (result = cb->UnknownChunk(mf)) ) return(result);
+	}
+    }
+    if (result != -1) return(result);
+
+    /* Make the heap */
+    if (mrg->NumCursors)
+    {
+	free(mrg->Heap);
+	if ( !(mrg->Heap = (CURSOR **)malloc(mrg->NumCursors * sizeof(CURSOR *))) ) return(MIDIERRREAD);
+	for (max = 0; max < mrg->NumCursors; max++) mrg->Heap[max] = &mrg->Cursors[max];
+	for (max = mrg->NumCursors >> 1; max--; ) MidiSiftDown(mrg->Heap, mrg->NumCursors, max);
+    }
+
+    return(0);
+}
+
+
+
+
+/******************************* MidiSiftDown() ********************************
+ * Moves the CURSOR at heap[i] down a min-heap of num CURSORs to where it belongs.
+ **************************************************************************/
+
+VOID MidiSiftDown(CURSOR ** heap, ULONG num, register ULONG i)
+{
+    register CURSOR * cur = heap[i];
+    register ULONG child;
+
+    while ( (child = (i << 1) + 1) < num )
+    {
+	if ( child + 1 < num && EARLIER(heap[child + 1], heap[child]) ) child++;
+	if ( !EARLIER(heap[child], cur) ) break;
+	heap[i] = heap[child];
+	i = child;
+    }
+    heap[i] = cur;
+}
+
+
+
+
+/****************************** merge_events() *********************************
+ * Reads the events of all MTrks in a MERGE in order of time, calling the app's callbacks. Each
+ * time, the CURSOR with the earliest next event is at the top of the heap, so we seek to that
+ * event, read it, and then read the delta-time after it to find when its MTrk's next event is.
+ * Returns 0 if success, or an error number.
+ **************************************************************************/
+
+static LONG merge_events(MIDIFILE * mf, MERGE * mrg)
+{
+    register CURSOR * cur;
+    register CURSOR ** heap = mrg->Heap;
+    register ULONG num = mrg->NumCursors;
+    ULONG delta;
+    LONG result;
+
+    mf->PrevTime = 0;
+    if (mf->Arena) mf->Arena->Sysex = 0;
+
+    while (num)
+    {
+	cur = heap[0];
+
+	/* Pick up where this MTrk left off. Usually, that's right where we are */
+	MidiSeek(mf, (LONG)(cur->Offset - (mrg->Size - mf->FileSize)));
+	mf->ChunkSize = cur->Left;
+	mf->TrackNum = cur->TrackNum;
+	mf->RunStatus = cur->RunStatus;
+	mf->Flags = (mf->Flags & ~MIDISYSEX) | cur->Flags;
+
+	mf->Time = (mf->Flags & MIDIDELTA) ? cur->Time - mf->PrevTime : cur->Time;
+	mf->PrevTime = cur->Time;
+	mf->EventSize = 0;
+
+	if ( (result = read_event(mf, &cur->Status, 0)) && result != -1 ) return(result);
+	if ( mf->ChunkSize < 0 ) return(MIDIERRBAD);
+
+	/* Is this MTrk done? */
+	if ( result == -1 || !mf->ChunkSize )
+	{
+	    if ( mf->Arena && mf->Arena->Sysex && mf->Arena->SysexTrack == mf->TrackNum &&
+		 (result = MidiEndSysex(mf)) ) return(result);
+	    if (!--num) break;
+	    heap[0] = heap[num];
+	}
+	else
+	{
+	    cur->RunStatus = mf->RunStatus;
+	    cur->Flags = mf->Flags & MIDISYSEX;
+	    if ( (result = MidiIOReadVLQ(mf, &delta)) ) return(result);
+	    cur->Time += delta;
+	    cur->Offset = mrg->Size - mf->FileSize;
+	    cur->Left = mf->ChunkSize;
+	}
+
+	MidiSiftDown(heap, num, 0);
+    }
+
+    mf->ChunkSize = 0;
+    return(0);
+}
+
+
+
+
+/******************************** read_merged() ********************************
+ * Does the real work of MidiReadMerged() once the file is open.
+ **************************************************************************/
+
+static LONG read_merged(MIDIFILE * mf)
+{
+    MERGE mrg;
+    LONG result;
+
+    /* We go back and forth between the MTrks, so the app's file I/O must be able to seek */
+    if ( !MIDIOWNIO(mf) && !mf->Callbacks->SeekMidi ) return(MIDIERRREAD);
+
+    memset(&mrg, 0, sizeof(MERGE));
+    mrg.Size = mf->FileSize;
+
+    if ( !(result = MidiMergeChunks(mf, &mrg)) ) result = merge_events(mf, &mrg);
+
+    free(mrg.Heap);
+    free(mrg.Cursors);
+    return(result);
+}
+
+
+
+
+/******************************* MidiReadFile() *******************************
+ * Reads in a MIDI file, calling the app's callbacks to process its contents. Returns 0 if
+ * success, or an error number (ie, one of the MIDIERR values, or a callback's non-zero return).
+ **************************************************************************/
+
+LONG EXPENTRY MidiReadFile(MIDIFILE * mf)
+{
+    LONG result;
+
+    mf->Flags &= ~(MIDIWRITE|MIDISYSEX|MIDIMEMIO);
+
+    if ( (result = MidiIOOpen(mf)) ) return(result);
+
+    result = read_file(mf, 0, NOEND, FALSE);
+
+    MidiCloseFile(mf);
+
+    return(result);
+}
+
+
+
+
+/******************************* MidiReadFrom() *******************************
+ * Like MidiReadFile(), but the app's callbacks aren't called for any event before the time
+ * start. idx is the file's MIDIINDEX (from MidiScanFile() or MidiLoadIndex()), and each MTrk is
+ * read from its last checkpoint before start, rather than its first event. The MThd, each MTrk's
+ * StartMTrk, and any other chunks are handled just as with MidiReadFile(). With the MIDIDELTA
+ * Flag, the first event's Time is still its delta from the event before it, even though the
+ * app didn't see that one. Returns 0 if success, or an error number (MIDIERRBAD if the index
+ * isn't for this file).
+ **************************************************************************/
+
+LONG EXPENTRY MidiReadFrom(MIDIFILE * mf, const MIDIINDEX * idx, ULONG start)
+{
+    LONG result;
+
+    mf->Flags &= ~(MIDIWRITE|MIDISYSEX|MIDIMEMIO);
+
+    if ( (result = MidiIOOpen(mf)) ) return(result);
+
+    result = read_from(mf, idx, start);
+
+    MidiCloseFile(mf);
+
+    return(result);
+}
+
+
+
+
+/****************************** MidiReadRange() *******************************
+ * Like MidiReadFile(), but only the events from the time start up to (but not including) the
+ * time end are passed to the app's callbacks. Events before start are skimmed, just tracking
+ * their times and running status (ie, no SYSEX or variable length Meta-Event data is read).
+ * Reading an MTrk stops at its first event at end, so the app doesn't get its End Of Track
+ * unless that's before end. Pass 0xFFFFFFFF for end to read to the end of each MTrk.
+ *   Before an MTrk's first event at or after start, the MTrk's state at start is reported to
+ * the app as a "chase", with the MIDICHASE Flag set. This is its last Tempo, Time Signature,
+ * and Key Signature Meta-Events, and for each MIDI channel, the last value of each controller
+ * (but not Channel Mode messages), Program Change, Channel Pressure, and Pitch Wheel. Each is
+ * at the time start. (With MIDIDELTA, the first one's Time is the delta from the last event
+ * before start, and the others' are 0). Notes that are still on at start aren't reported. If
+ * an MTrk has no events at or after start, its chase is reported at its end.
+ *   The MThd, each MTrk's StartMTrk, and any other chunks are handled just as with
+ * MidiReadFile(). Returns 0 if success, or an error number.
+ **************************************************************************/
+
+LONG EXPENTRY MidiReadRange(MIDIFILE * mf, ULONG start, ULONG end)
+{
+    LONG result;
+
+    mf->Flags &= ~(MIDIWRITE|MIDISYSEX|MIDIMEMIO|MIDICHASE);
+
+    if ( (result = MidiIOOpen(mf)) ) return(result);
+
+    result = read_file(mf, start, end, TRUE);
+
+    MidiCloseFile(mf);
+
+    return(result);
+}
+
+
+
+
+/****************************** MidiReadMerged() ******************************
+ * Like MidiReadFile(), but the events of all MTrks are passed to the app's callbacks in order of
+ * time, as if the file were Format 0, with TrackNum set to each event's MTrk. Events at the same
+ * time are in the order of their MTrks in the file. Each MTrk's End Of Track is passed to MetaEOT
+ * at its time. With the MIDIDELTA Flag, Time is the delta from the previous event passed to the
+ * app (whichever MTrk that was in). First, the MThd and every other chunk is read, calling
+ * StartMThd, StartMTrk (for each MTrk, which can still skip it or have it loaded whole), and
+ * UnknownChunk. Only then are the events read. MidiReadBytes() works in SysexEvt and MetaText
+ * just as with MidiReadFile().
+ *   Only one small CURSOR per MTrk is kept, rather than any of the events. The file is read
+ * where each MTrk is up to, so if the engine does the file I/O, it's mapped into memory (ie, as
+ * if the MIDIMMAP Flag were set) to make going back and forth between the MTrks cheap. If the
+ * app does the file I/O, its CALLBACK must have a SeekMidi. Returns 0 if success, or an error
+ * number (MIDIERRREAD if the app's file I/O can't seek).
+ **************************************************************************/
+
+LONG EXPENTRY MidiReadMerged(MIDIFILE * mf)
+{
+    USHORT mmap = mf->Flags & MIDIMMAP;
+    LONG result;
+
+    mf->Flags = (mf->Flags & ~(MIDIWRITE|MIDISYSEX|MIDIMEMIO)) | MIDIMMAP;
+
+    if ( !(result = MidiIOOpen(mf)) )
+    {
+	result = read_merged(mf);
+	MidiCloseFile(mf);
+    }
+
+    mf->Flags = (mf->Flags & ~MIDIMMAP) | mmap;
+    return(result);
+}
+
+
+
+
+/****************************** MidiReadMemory() ******************************
+ * Like MidiReadFile(), but reads the MIDI file image of size bytes at buf, instead of a file.
+ * The CALLBACK's OpenMidi, ReadWriteMidi, SeekMidi, and CloseMidi aren't used, and Handle is
+ * ignored. MidiReadBytesView() never copies, since the whole image is already in memory.
+ **************************************************************************/
+
+LONG EXPENTRY MidiReadMemory(MIDIFILE * mf, const VOID * buf, ULONG size)
+{
+    LONG result;
+
+    mf->Flags &= ~(MIDIWRITE|MIDISYSEX);
+
+    if ( (result = MidiIOOpenMemory(mf, (UCHAR *)buf, size)) ) return(result);
+
+    result = read_file(mf, 0, NOEND, FALSE);
+
+    MidiCloseFile(mf);
+
+    return(result);
+}
+
+
+
+
+/******************************* write_data() *********************************
+ * Writes the data bytes of a SYSEX or variable length Meta-Event whose Status (and Type) and
+ * length have already been written. If the app set a buffer pointer at Data[2], that's written.
+ * Otherwise, the app's SysexEvt or MetaText callback (func) is called to MidiWriteBytes() them.
+ **************************************************************************/
+
+static LONG write_data(MIDIFILE * mf, CALL func)
+{
+    register UCHAR * ptr;
+    LONG result;
+
+    if ( (ptr = MIDIDATAPTR(mf)) )
+    {
+	result = MidiIOWrite(mf, ptr, mf->EventSize);
+	mf->EventSize = 0;
+	return(result);
+    }
+
+    if (mf->EventSize)
+    {
+	if (!func) return(MIDIERRWRITE);
+	if ( (result = func(mf)) ) return(result);
+
+	/* The callback must have written all of the bytes that it promised */
+	if (mf->EventSize) return(MIDIERRWRITE);
+    }
+
+    return(0);
+}
+
+
+
+
+/******************************* write_meta() *********************************
+ * Writes a Meta-Event. The event's time has already been formatted into buf, and len is how
+ * many bytes that is.
+ **************************************************************************/
+
+static LONG write_meta(MIDIFILE * mf, UCHAR * buf, ULONG len)
+{
+    register ULONG val;
+    register UCHAR * ptr;
+    UCHAR type = mf->Data[0];
+    LONG result;
+
+    buf[len++] = 0xFF;
+    buf[len++] = type;
+
+    switch (type)
+    {
+	/* Sequence Number, perhaps followed by a Track Name */
+	case 0x00:
+	    ptr = ((METASEQ *)mf)->NamePtr;
+	    buf[len++] = 2;
+	    buf[len++] = (UCHAR)(((METASEQ *)mf)->SeqNum >> 8);
+	    buf[len++] = (UCHAR)((METASEQ *)mf)->SeqNum;
+	    if (ptr)
+	    {
+		val = strlen((char *)ptr);
+		buf[len++] = 0;
+		buf[len++] = 0xFF;
+		buf[len++] = 0x03;
+		len += MidiLongToVLQ(val, &buf[len]);
+		if ( (result = MidiIOWrite(mf, buf, len)) ) return(result);
+		return( MidiIOWrite(mf, ptr, val) );
+	    }
+	    break;
+
+	case 0x2F:
+	    buf[len++] = 0;
+	    break;
+
+	case 0x51:
+	    if (mf->Flags & MIDIBPM)
+	    {
+		val = ((METATEMPO *)mf)->TempoBPM;
+		((METATEMPO *)mf)->Tempo = (val) ? 60000000 / val : 500000;
+	    }
+	    val = ((METATEMPO *)mf)->Tempo;
+	    buf[len++] = 3;
+	    buf[len++] = (UCHAR)(val >> 16);
+	    buf[len++] = (UCHAR)(val >> 8);
+	    buf[len++] = (UCHAR)val;
+	    break;
+
+	case 0x54:
+	    buf[len++] = 5;
+	    memcpy(&buf[len], &((METASMPTE *)mf)->Hours, 5);
+	    len += 5;
+	    break;
+
+	case 0x58:
+	    buf[len++] = 4;
+	    buf[len++] = ((METATIME *)mf)->Nom;
+	    val = ((METATIME *)mf)->Denom;
+	    if (mf->Flags & MIDIDENOM)
+	    {
+		/* Express the true denominator as a power of 2 */
+		for (result = 0; val > 1; result++) val >>= 1;
+		val = result;
+	    }
+	    buf[len++] = (UCHAR)val;
+	    buf[len++] = ((METATIME *)mf)->Clocks;
+	    buf[len++] = ((METATIME *)mf)->_32nds;
+	    break;
+
+	case 0x59:
+	    buf[len++] = 2;
+	    buf[len++] = (UCHAR)((METAKEY *)mf)->Key;
+	    buf[len++] = ((METAKEY *)mf)->Minor;
+	    break;
+
+	/* Variable length. An EventSize of 0 with a buffer means a null-terminated string */
+	default:
+	    if ( (ptr = MIDIDATAPTR(mf)) && !mf->EventSize ) mf->EventSize = strlen((char *)ptr);
+	    if ( (ULONG)mf->EventSize > MIDIVLQMAX ) return(MIDIERRBAD);
+	    len += MidiLongToVLQ(mf->EventSize, &buf[len]);
+	    if ( (result = MidiIOWrite(mf, buf, len)) ) return(result);
+	    return( write_data(mf, mf->Callbacks->MetaText) );
+    }
+
+    return( MidiIOWrite(mf, buf, len) );
+}
+
+
+
+
+/******************************* MidiWriteEvt() *******************************
+ * Writes out the one event that the app has formatted in the MIDIFILE (ie, the same way that
+ * its StandardEvt callback does). The engine calls this for each event that StandardEvt returns,
+ * and an app's MetaSeqNum callback can call it to write additional events at the head of an MTrk.
+ * Returns MIDIERRBAD for a delta-time or EventSize over MIDIVLQMAX, which no reader could get back.
+ **************************************************************************/
+
+LONG EXPENTRY MidiWriteEvt(MIDIFILE * mf)
+{
+    UCHAR buf[24];
+    register ULONG len, delta;
+    register UCHAR status = mf->Status;
+    LONG result;
+
+    /* Format the event's time as a delta from the previous event */
+    if (mf->Flags & MIDIDELTA)
+	delta = mf->Time;
+    else
+	delta = (mf->Time > mf->PrevTime) ? mf->Time - mf->PrevTime : 0;
+    if (delta > MIDIVLQMAX) return(MIDIERRBAD);
+    mf->PrevTime += delta;
+    len = MidiLongToVLQ(delta, &buf[0]);
+
+    if ( !(status & 0x80) ) return(MIDIERREVENT);
+
+    /* MIDI event with Status 0x80 to 0xEF. Use running status where possible */
+    if (status < 0xF0)
+    {
+	if (status != mf->RunStatus) buf[len++] = status;
+	buf[len++] = mf->Data[0];
+	if ( (status & 0xE0) != 0xC0 ) buf[len++] = mf->Data[1];
+	mf->RunStatus = status;
+	return( MidiIOWrite(mf, &buf[0], len) );
+    }
+
+    switch (status)
+    {
+	/* SYSEX, or SYSEX CONTINUATION/ESCAPE */
+	case 0xF0:
+	case 0xF7:
+	    if ( (ULONG)mf->EventSize > MIDIVLQMAX ) return(MIDIERRBAD);
+	    buf[len++] = status;
+	    len += MidiLongToVLQ(mf->EventSize, &buf[len]);
+	    mf->RunStatus = 0;
+	    if ( (result = MidiIOWrite(mf, &buf[0], len)) ) return(result);
+	    return( write_data(mf, mf->Callbacks->SysexEvt) );
+
+	case 0xFF:
+	    mf->RunStatus = 0;
+	    return( write_meta(mf, &buf[0], len) );
+    }
+
+    /* REALTIME and SYSTEM COMMON have to be written as ESCAPE events */
+    buf[len++] = 0xF7;
+    switch (status)
+    {
+	case 0xF2:
+	    buf[len++] = 3;
+	    buf[len++] = status;
+	    buf[len++] = mf->Data[0];
+	    buf[len++] = mf->Data[1];
+	    break;
+
+	case 0xF1:
+	case 0xF3:
+	    buf[len++] = 2;
+	    buf[len++] = status;
+	    buf[len++] = mf->Data[0];
+	    break;
+
+	default:
+	    buf[len++] = 1;
+	    buf[len++] = status;
+    }
+    if ( status < 0xF8 || !(mf->Flags & MIDIREALTIME) ) mf->RunStatus = 0;
+
+    return( MidiIOWrite(mf, &buf[0], len) );
+}
+
+
+
+
+/******************************* write_track() ********************************
+ * Writes the events of an MTrk (whose header has already been written), calling the app's
+ * MetaSeqNum callback once, and then StandardEvt for each event until an End Of Track.
+ **************************************************************************/
+
+static LONG write_track(MIDIFILE * mf)
+{
+    register CALLBACK * cb = mf->Callbacks;
+    register BOOL eot;
+    LONG result;
+
+    mf->PrevTime = 0;
+    mf->RunStatus = 0;
+
+    eot = FALSE;
+    if (cb->MetaSeqNum)
+    {
+	mf->Time = 0;
+	((METASEQ *)mf)->NamePtr = 0;
+	if ( (result = cb->MetaSeqNum(mf)) ) return(result);
+	eot = (mf->Status == 0xFF && mf->Data[0] == 0x2F);
+	if ( (result = MidiWriteEvt(mf)) ) return(result);
+    }
+
+    if (cb->StandardEvt)
+    {
+	while (!eot)
+	{
+	    mf->EventSize = 0;
+	    MIDIDATAPTR(mf) = 0;
+	    if ( (result = cb->StandardEvt(mf)) ) return(result);
+	    eot = (mf->Status == 0xFF && mf->Data[0] == 0x2F);
+	    if ( (result = MidiWriteEvt(mf)) ) return(result);
+	}
+    }
+
+    /* No StandardEvt, so the MTrk gets only an End Of Track */
+    else if (!eot)
+    {
+	mf->Time = (mf->Flags & MIDIDELTA) ? 0 : mf->PrevTime;
+	mf->Status = 0xFF;
+	mf->Data[0] = 0x2F;
+	if ( (result = MidiWriteEvt(mf)) ) return(result);
+    }
+
+    return( MidiCloseChunk(mf) );
+}
+
+
+
+
+/***************************** check_track_events() ****************************
+ * Checks an array of count MIDIEVTs for MidiWriteTrackEvents() before anything is written, so
+ * that a bad array leaves no partial MTrk in the file. Returns 0 if they can all be written, or
+ * MIDIERRBAD.
+ **************************************************************************/
+
+static LONG check_track_events(MIDIFILE * mf, register const MIDIEVT * evts, ULONG count, UCHAR ** payloads)
+{
+    const MIDIEVT * end = evts + count;
+    register ULONG val;
+    register UCHAR status;
+    ULONG prevtime = 0;
+
+    for (; evts < end; evts++)
+    {
+	if (mf->Flags & MIDIDELTA)
+	    val = evts->Time;
+	else
+	    val = (evts->Time > prevtime) ? evts->Time - prevtime : 0;
+	if (val > MIDIVLQMAX) return(MIDIERRBAD);
+	prevtime += val;
+
+	status = evts->Status;
+
+	/* SYSEX, or SYSEX CONTINUATION/ESCAPE, with a Length needs its payload */
+	if (status == 0xF0 || status == 0xF7)
+	{
+	    if ( ((const MIDIXEVT *)evts)->Length &&
+		 (!payloads || !payloads[((const MIDIXEVT *)evts)->Index]) ) return(MIDIERRBAD);
+	}
+
+	/* So does a variable length Meta-Event */
+	else if (status < 0x80)
+	{
+	    switch (status)
+	    {
+		case 0x2F:
+		    if (evts + 1 != end) return(MIDIERRBAD);
+		case 0x00:
+		case 0x51:
+		case 0x58:
+		case 0x59:
+		    break;
+
+		default:
+		    if ( ((const MIDITXTEVT *)evts)->Length &&
+			 (!payloads || !payloads[((const MIDITXTEVT *)evts)->Index]) ) return(MIDIERRBAD);
+	    }
+	}
+    }
+
+    return(0);
+}
+
+
+
+
+/**************************** MidiWriteTrackEvents() **************************
+ * Writes an entire MTrk chunk (header, events, and size) from an array of count MIDIEVTs, with
+ * no callbacks. The events are formatted into a local buffer, with delta-times and running
+ * status, and that is written out in big blocks. For MIDIXEVTs and MIDITXTEVTs, payloads[Index]
+ * points to the data (payloads may be 0 if every Length is 0). If the last MIDIEVT isn't an End
+ * Of Track, one is added. An app typically calls this from its StartMTrk callback, and then
+ * returns -1 so that the DLL doesn't write the MTrk too. Returns MIDIERRBAD (before anything is
+ * written) if two events are more than MIDIVLQMAX apart, if an End Of Track isn't the last
+ * MIDIEVT (rather than silently drop those after it), or if a MIDIXEVT or MIDITXTEVT with a
+ * Length has no payload.
+ **************************************************************************/
+
+LONG EXPENTRY MidiWriteTrackEvents(MIDIFILE * mf, const MIDIEVT * evts, ULONG count, UCHAR ** payloads)
+{
+    UCHAR buf[1024];
+    register ULONG len, val;
+    register UCHAR status;
+    register UCHAR * ptr;
+    const MIDIEVT * end = evts + count;
+    UCHAR runstatus = 0;
+    ULONG prevtime = 0;
+    LONG result;
+
+    if ( (result = check_track_events(mf, evts, count, payloads)) ) return(result);
+
+    memcpy(&mf->ID, "MTrk", 4);
+    mf->ChunkSize = 0;
+    if ( (result = MidiWriteHeader(mf)) ) return(result);
+
+    len = 0;
+    status = 0;
+    while (evts < end)
+    {
+	/* Write out the buffer before it could overflow (an event formats to at most 14 bytes) */
+	if (len > sizeof(buf) - 16)
+	{
+	    if ( (result = MidiIOWrite(mf, &buf[0], len)) ) return(result);
+	    len = 0;
+	}
+
+	/* The event's time as a delta from the previous event */
+	if (mf->Flags & MIDIDELTA)
+	    val = evts->Time;
+	else
+	    val = (evts->Time > prevtime) ? evts->Time - prevtime : 0;
+	prevtime += val;
+	len += MidiLongToVLQ(val, &buf[len]);
+
+	status = evts->Status;
+
+	/* MIDI event with Status 0x80 to 0xEF. Use running status where possible */
+	if (status >= 0x80 && status < 0xF0)
+	{
+	    if (status != runstatus) buf[len++] = runstatus = status;
+	    buf[len++] = evts->Data1;
+	    if ( (status & 0xE0) != 0xC0 ) buf[len++] = evts->Data2;
+	}
+
+	/* SYSEX, or SYSEX CONTINUATION/ESCAPE */
+	else if (status == 0xF0 || status == 0xF7)
+	{
+	    val = ((const MIDIXEVT *)evts)->Length;
+	    ptr = (val) ? payloads[((const MIDIXEVT *)evts)->Index] : 0;
+	    buf[len++] = status;
+	    len += MidiLongToVLQ(val, &buf[len]);
+	    runstatus = 0;
+	    goto payload;
+	}
+
+	/* REALTIME and SYSTEM COMMON have to be written as ESCAPE events */
+	else if (status >= 0x80)
+	{
+	    buf[len++] = 0xF7;
+	    switch (status)
+	    {
+		case 0xF2:
+		    buf[len++] = 3;
+		    buf[len++] = status;
+		    buf[len++] = evts->Data1;
+		    buf[len++] = evts->Data2;
+		    break;
+
+		case 0xF1:
+		case 0xF3:
+		    buf[len++] = 2;
+		    buf[len++] = status;
+		    buf[len++] = evts->Data1;
+		    break;
+
+		default:
+		    buf[len++] = 1;
+		    buf[len++] = status;
+	    }
+	    if ( status < 0xF8 || !(mf->Flags & MIDIREALTIME) ) runstatus = 0;
+	}
+
+	/* Meta-Event, with the type in Status */
+	else
+	{
+	    buf[len++] = 0xFF;
+	    buf[len++] = status;
+	    runstatus = 0;
+
+	    switch (status)
+	    {
+		case 0x00:
+		    buf[len++] = 2;
+		    buf[len++] = (UCHAR)(((const MIDISEQEVT *)evts)->SeqNum >> 8);
+		    buf[len++] = (UCHAR)((const MIDISEQEVT *)evts)->SeqNum;
+		    break;
+
+		case 0x2F:
+		    buf[len++] = 0;
+		    break;
+
+		case 0x51:
+		    val = ((const MIDITEMPOEVT *)evts)->BPM;
+		    val = (val) ? 60000000 / val : 500000;
+		    buf[len++] = 3;
+		    buf[len++] = (UCHAR)(val >> 16);
+		    buf[len++] = (UCHAR)(val >> 8);
+		    buf[len++] = (UCHAR)val;
+		    break;
+
+		case 0x58:
+		    buf[len++] = 4;
+		    buf[len++] = ((const MIDITIMEEVT *)evts)->Nom;
+		    val = ((const MIDITIMEEVT *)evts)->Denom;
+		    if (mf->Flags & MIDIDENOM)
+		    {
+			/* Express the true denominator as a power of 2 */
+			for (result = 0; val > 1; result++) val >>= 1;
+			val = result;
+		    }
+		    buf[len++] = (UCHAR)val;
+		    buf[len++] = ((const MIDITIMEEVT *)evts)->Clocks;
+		    buf[len++] = 8;
+		    break;
+
+		case 0x59:
+		    buf[len++] = 2;
+		    buf[len++] = ((const MIDIKEYEVT *)evts)->Key;
+		    buf[len++] = ((const MIDIKEYEVT *)evts)->Minor;
+		    break;
+
+		/* Variable length (and SMPTE, which doesn't fit in a MIDIEVT) */
+		default:
+		    val = ((const MIDITXTEVT *)evts)->Length;
+		    ptr = (val) ? payloads[((const MIDITXTEVT *)evts)->Index] : 0;
+		    len += MidiLongToVLQ(val, &buf[len]);
+		    goto payload;
+	    }
+	}
+
+	evts++;
+	continue;
+
+	/* Write the SYSEX or Meta-Event's data. Small amounts are just copied into the buffer */
+payload:
+	if (len + val > sizeof(buf))
+	{
+	    if ( (result = MidiIOWrite(mf, &buf[0], len)) ) return(result);
+	    len = 0;
+	    if (val > sizeof(buf))
+	    {
+		if ( (result = MidiIOWrite(mf, ptr, val)) ) return(result);
+		val = 0;
+	    }
+	}
+	if (val) memcpy(&buf[len], ptr, val);
+	len += val;
+	evts++;
+    }
+
+    /* Make sure that the MTrk ends with an End Of Track */
+    if ( !count || status != 0x2F )
+    {
+	if (len > sizeof(buf) - 4)
+	{
+	    if ( (result = MidiIOWrite(mf, &buf[0], len)) ) return(result);
+	    len = 0;
+	}
+	buf[len++] = 0;
+	buf[len++] = 0xFF;
+	buf[len++] = 0x2F;
+	buf[len++] = 0;
+    }
+
+    mf->PrevTime = prevtime;
+    mf->RunStatus = 0;
+
+    if ( len && (result = MidiIOWrite(mf, &buf[0], len)) ) return(result);
+
+    return( MidiCloseChunk(mf) );
+}
+
+
+
+
+/******************************* write_mtrk() *********************************
+ * Writes the MTrk numbered TrackNum, calling the app's StartMTrk first. Returns 0 if success,
+ * -1 if StartMTrk skipped this MTrk, or an error number.
+ **************************************************************************/
+
+static LONG write_mtrk(MIDIFILE * mf)
+{
+    register CALLBACK * cb = mf->Callbacks;
+    register UCHAR * ptr;
+    LONG result;
+
+    mf->Time = 0;
+    mf->EventSize = 0;
+    MIDIDATAPTR(mf) = 0;
+
+    /* A -1 from StartMTrk skips this MTrk */
+    if ( cb->StartMTrk && (result = cb->StartMTrk(mf)) ) return(result);
+
+    /* The app may have supplied a buffer with the entire, preformatted MTrk */
+    ptr = MIDIDATAPTR(mf);
+
+    memcpy(&mf->ID, "MTrk", 4);
+    mf->ChunkSize = 0;
+    if ( (result = MidiWriteHeader(mf)) ) return(result);
+
+    if (ptr)
+    {
+	if ( (result = MidiIOWrite(mf, ptr, mf->EventSize)) ) return(result);
+	if ( (result = MidiCloseChunk(mf)) ) return(result);
+	if ( cb->StandardEvt && (result = cb->StandardEvt(mf)) ) return(result);
+	return(0);
+    }
+
+    return( write_track(mf) );
+}
+
+
+
+
+/* One MTrk of a MIDIPARALLEL write */
+typedef struct _WRITETRK
+{
+    MIDIFILE	Mf;	/* Copy of the app's MIDIFILE that this MTrk's callbacks get */
+    UCHAR *	Ptr;	/* The MTrk's chunk (and anything else the app wrote with it) */
+    ULONG	Len;	/* Its size */
+} WRITETRK;
+
+
+
+
+/******************************** write_one() ********************************
+ * Called by MidiParallel() to write the MTrk numbered item into its own memory image.
+ **************************************************************************/
+
+static LONG write_one(VOID * arg, ULONG item)
+{
+    register WRITETRK * trk = &((WRITETRK *)arg)[item];
+    register MIDIIO * io;
+    LONG result;
+
+    if ( (result = MidiIOOpenMemory(&trk->Mf, 0, 0)) ) return(result);
+
+    result = write_mtrk(&trk->Mf);
+
+    io = MIDIIOPTR(&trk->Mf);
+    trk->Ptr = io->Ptr;
+    trk->Len = io->Len;
+    MidiCloseFile(&trk->Mf);
+
+    return( (result == -1) ? 0 : result );
+}
+
+
+
+
+/****************************** write_parallel() ******************************
+ * Writes all of the MTrks for the MIDIPARALLEL Flag. Each MTrk is written by a worker thread
+ * into its own memory image (so that MidiCloseChunk() simply patches the size there), with its
+ * callbacks getting their own copy of the MIDIFILE (whose Parent is the app's MIDIFILE). Then
+ * the images are written out in order.
+ **************************************************************************/
+
+static LONG write_parallel(MIDIFILE * mf)
+{
+    register WRITETRK * trks;
+    register ULONG i;
+    ULONG num = mf->NumTracks;
+    LONG result;
+
+    if ( !(trks = (WRITETRK *)calloc(num, sizeof(WRITETRK))) ) return(MIDIERRWRITE);
+
+    for (i = 0; i < num; i++)
+    {
+	trks[i].Mf = *mf;
+	trks[i].Mf.TrackNum = (UCHAR)i;
+	trks[i].Mf.Parent = mf;
+    }
+
+    if ( !(result = MidiParallel(num, write_one, trks)) )
+    {
+	for (i = 0; i < num; i++)
+	{
+	    if ( trks[i].Len && (result = MidiIOWrite(mf, trks[i].Ptr, trks[i].Len)) ) break;
+	}
+    }
+
+    for (i = 0; i < num; i++) free(trks[i].Ptr);
+    free(trks);
+
+    mf->TrackNum = (UCHAR)num;
+    return(result);
+}
+
+
+
+
+/******************************* write_file() *********************************
+ * Does the real work of MidiWriteFile() once the file is open.
+ **************************************************************************/
+
+static LONG write_file(MIDIFILE * mf)
+{
+    register CALLBACK * cb = mf->Callbacks;
+    register USHORT i;
+    UCHAR buf[6];
+    LONG result;
+
+    /* Let the app set the Format, NumTracks, and Division, and then write the MThd */
+    if ( cb->StartMThd && (result = cb->StartMThd(mf)) ) return(result);
+
+    memcpy(&mf->ID, "MThd", 4);
+    mf->ChunkSize = 6;
+    if ( (result = MidiWriteHeader(mf)) ) return(result);
+    buf[0] = (UCHAR)(mf->Format >> 8);
+    buf[1] = (UCHAR)mf->Format;
+    buf[2] = (UCHAR)(mf->NumTracks >> 8);
+    buf[3] = (UCHAR)mf->NumTracks;
+    buf[4] = (UCHAR)(mf->Division >> 8);
+    buf[5] = (UCHAR)mf->Division;
+    if ( (result = MidiIOWrite(mf, &buf[0], 6)) ) return(result);
+
+    /* Write each MTrk */
+    if ( (mf->Flags & MIDIPARALLEL) && mf->NumTracks > 1 )
+    {
+	if ( (result = write_parallel(mf)) ) return(result);
+    }
+    else for (i=0, mf->TrackNum=0; i < mf->NumTracks; i++, mf->TrackNum++)
+    {
+	if ( (result = write_mtrk(mf)) && result != -1 ) return(result);
+    }
+
+    /* Let the app write any chunks of its own after the MTrks */
+    if ( cb->UnknownChunk && (result = cb->UnknownChunk(mf)) ) return(result);
+
+    return(0);
+}
+
+
+
+
+/******************************* MidiWriteFile() ******************************
+ * Writes out a MIDI file, calling the app's callbacks to supply its contents. Returns 0 if
+ * success, or an error number (ie, one of the MIDIERR values, or a callback's non-zero return).
+ **************************************************************************/
+
+LONG EXPENTRY MidiWriteFile(MIDIFILE * mf)
+{
+    LONG result;
+
+    mf->Flags = (mf->Flags & ~(MIDISYSEX|MIDIMEMIO)) | MIDIWRITE;
+
+    if ( (result = MidiIOOpen(mf)) ) return(result);
+
+    if ( !(result = write_file(mf)) ) result = MidiIOFlush(mf);
+
+    MidiCloseFile(mf);
+
+    return(result);
+}
+
+
+
+
+/****************************** MidiWriteMemory() *****************************
+ * Like MidiWriteFile(), but writes the MIDI file image into memory, instead of a file. The
+ * CALLBACK's OpenMidi, ReadWriteMidi, SeekMidi, and CloseMidi aren't used, and Handle is ignored.
+ * On entry, *buf is a malloc'ed buffer of *size bytes to write into, or 0 to have the DLL
+ * allocate one. The buffer is realloc'ed as needed. On return (even with an error), *buf is the
+ * buffer, which the app must free(), and *size is the number of bytes written to it.
+ **************************************************************************/
+
+LONG EXPENTRY MidiWriteMemory(MIDIFILE * mf, VOID ** buf, ULONG * size)
+{
+    register MIDIIO * io;
+    LONG result;
+
+    mf->Flags = (mf->Flags & ~MIDISYSEX) | MIDIWRITE;
+
+    if ( (result = MidiIOOpenMemory(mf, (UCHAR *)*buf, *size)) ) return(result);
+
+    result = write_file(mf);
+
+    io = MIDIIOPTR(mf);
+    *buf = io->Ptr;
+    *size = io->Len;
+
+    MidiCloseFile(mf);
+
+    return(result);
+}
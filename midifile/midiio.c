@@ -0,0 +1,953 @@
+/* ===========================================================================
+ * midiio.c
+ *
+ * The MIDIFILE engine's file I/O layer. Everything that moves bytes to or from a MIDI file goes
+ * through here, either to the app's OpenMidi/ReadWriteMidi/SeekMidi/CloseMidi callbacks, or to
+ * the engine's own buffered POSIX file I/O if the app didn't supply those.
+ * =========================================================================
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "midipriv.h"
+
+
+
+
+/******************************** read_fully() ********************************
+ * Reads count bytes from fd into buf, retrying short and interrupted reads. Returns 0 if all
+ * bytes were read, or MIDIERRREAD if not (including if the end of the file was reached). Each
+ * read() is counted in the MIDIFILE's IOStats.
+ **************************************************************************/
+
+static LONG read_fully(MIDIFILE * mf, int fd, UCHAR * buf, ULONG count)
+{
+    ssize_t n;
+
+    while (count)
+    {
+	MIDICOUNT(mf, Reads);
+	if ( (n = read(fd, buf, count)) <= 0 )
+	{
+	    if (n < 0 && errno == EINTR) continue;
+	    return(MIDIERRREAD);
+	}
+	buf += n;
+	count -= n;
+    }
+    return(0);
+}
+
+
+
+
+/******************************** write_fully() *******************************
+ * Writes count bytes from buf to fd, retrying short and interrupted writes. Returns 0 if all
+ * bytes were written, or MIDIERRWRITE if not. Each write() is counted in the MIDIFILE's IOStats.
+ **************************************************************************/
+
+static LONG write_fully(MIDIFILE * mf, int fd, UCHAR * buf, ULONG count)
+{
+    ssize_t n;
+
+    while (count)
+    {
+	MIDICOUNT(mf, Writes);
+	if ( (n = write(fd, buf, count)) <= 0 )
+	{
+	    if (n < 0 && errno == EINTR) continue;
+	    return(MIDIERRWRITE);
+	}
+	buf += n;
+	count -= n;
+    }
+    return(0);
+}
+
+
+
+
+/******************************** MidiIOOpen() *********************************
+ * Opens the MIDI file for MidiReadFile() or MidiWriteFile(). If the app supplied an OpenMidi
+ * callback, that does the opening. Otherwise, Handle points to the filename, and we open it.
+ * If the app didn't supply a ReadWriteMidi callback, then we do the reading/writing, so we
+ * allocate a MIDIIO for this MIDIFILE and replace Handle with a pointer to it. When the app
+ * opens the file itself but lets us do the I/O, Handle must be the POSIX file descriptor. For a
+ * read with the MIDIMMAP Flag, we try to map the whole file into memory instead of buffering it.
+ * For a write with the MIDIHOLD Flag, the whole file is kept in memory until MidiIOFlush().
+ * The MIDIFILE's BufSize (if any) sets the size of the buffer.
+ **************************************************************************/
+
+LONG MidiIOOpen(MIDIFILE * mf)
+{
+    register CALLBACK * cb = mf->Callbacks;
+    register MIDIIO * io;
+    struct stat st;
+    UCHAR * map;
+    ULONG size;
+    LONG result;
+    int fd;
+
+    st.st_size = -1;
+    size = (mf->BufSize) ? mf->BufSize : MIDIBUFSIZE;
+
+    if (cb->OpenMidi)
+    {
+	if ( (result = cb->OpenMidi(mf)) ) return(result);
+
+	/* If the app also does its own reads/writes, there's nothing more for us to do */
+	if (cb->ReadWriteMidi) return(0);
+
+	fd = (int)mf->Handle;
+    }
+    else
+    {
+	MIDICOUNT(mf, Others);
+	if (mf->Flags & MIDIWRITE)
+	{
+	    if ( (fd = open((const char *)mf->Handle, O_WRONLY|O_CREAT|O_TRUNC, 0666)) < 0 ) return(MIDIERRFILE);
+	    mf->FileSize = 0;
+	}
+	else
+	{
+	    if ( (fd = open((const char *)mf->Handle, O_RDONLY)) < 0 ) return(MIDIERRFILE);
+	    MIDICOUNT(mf, Others);
+	    if ( fstat(fd, &st) )
+	    {
+		MIDICOUNT(mf, Others);
+		close(fd);
+		return(MIDIERRINFO);
+	    }
+	    mf->FileSize = (LONG)st.st_size;
+	}
+
+	/* If the app does its own reads/writes, give it the file descriptor */
+	if (cb->ReadWriteMidi)
+	{
+	    mf->Handle = (MIDIHANDLE)fd;
+	    return(0);
+	}
+    }
+
+    mf->Flags &= ~MIDIDIRTY;
+
+    /* Map the file if the app asked for that. If it can't be mapped (ie, it's a pipe or empty),
+	just buffer it */
+    io = 0;
+    if ( (mf->Flags & (MIDIMMAP|MIDIWRITE)) == MIDIMMAP )
+    {
+	if (st.st_size < 0)
+	{
+	    MIDICOUNT(mf, Others);
+	    if ( fstat(fd, &st) ) st.st_size = -1;
+	}
+	if (st.st_size > 0)
+	{
+	    MIDICOUNT(mf, Others);
+	    map = (UCHAR *)mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	    if (map != (UCHAR *)MAP_FAILED)
+	    {
+		if ( (io = (MIDIIO *)malloc(sizeof(MIDIIO))) )
+		{
+		    MIDICOUNT(mf, Others);
+		    madvise(map, st.st_size, MADV_SEQUENTIAL);
+		    io->Mode = MIDIIOMAP;
+		    io->Ptr = map;
+		    io->Len = io->Size = (ULONG)st.st_size;
+		    io->Pos = 0;
+		    if (cb->OpenMidi)
+		    {
+			MIDICOUNT(mf, Seeks);
+			io->Pos = (ULONG)lseek(fd, 0, SEEK_CUR);
+			if (io->Pos > io->Len) io->Pos = io->Len;
+		    }
+		}
+		else
+		{
+		    MIDICOUNT(mf, Others);
+		    munmap(map, st.st_size);
+		}
+	    }
+	}
+    }
+
+    /* Hold the whole file being written in memory, starting with a buffer's worth, and growing
+	as it's written */
+    if ( (mf->Flags & (MIDIHOLD|MIDIWRITE)) == (MIDIHOLD|MIDIWRITE) )
+    {
+	if ( (io = (MIDIIO *)malloc(sizeof(MIDIIO))) && !(io->Ptr = (UCHAR *)malloc(size)) )
+	{
+	    free(io);
+	    io = 0;
+	}
+	if (io)
+	{
+	    io->Mode = MIDIIOHOLD;
+	    io->Size = size;
+	    io->Pos = io->Len = 0;
+	}
+    }
+
+    if (!io)
+    {
+	if ( !(io = (MIDIIO *)malloc(sizeof(MIDIIO) + size)) )
+	{
+	    if (!cb->OpenMidi)
+	    {
+		MIDICOUNT(mf, Others);
+		close(fd);
+	    }
+	    return(MIDIERRFILE);
+	}
+	io->Mode = MIDIIOFILE;
+	io->Ptr = (UCHAR *)(io + 1);
+	io->Size = size;
+	io->Pos = io->Len = 0;
+    }
+
+    io->fd = fd;
+    io->BufStart = 0;
+    if (cb->OpenMidi && io->Mode != MIDIIOMAP)
+    {
+	MIDICOUNT(mf, Seeks);
+	io->BufStart = (LONG)lseek(fd, 0, SEEK_CUR);
+    }
+    mf->Handle = (MIDIHANDLE)io;
+
+    return(0);
+}
+
+
+
+
+/****************************** MidiIOOpenMemory() *****************************
+ * Sets up a MIDIFILE to read/write a memory image instead of a file. For reading, buf is the
+ * image, and size is its length. For writing, buf is a malloc'ed buffer of size bytes to write
+ * into (or 0 to have us allocate one). Either way, we grow it as needed with realloc().
+ **************************************************************************/
+
+LONG MidiIOOpenMemory(MIDIFILE * mf, UCHAR * buf, ULONG size)
+{
+    register MIDIIO * io;
+
+    if ( !(io = (MIDIIO *)malloc(sizeof(MIDIIO))) ) return(MIDIERRFILE);
+
+    io->fd = -1;
+    io->Mode = MIDIIOMEM;
+    io->BufStart = 0;
+    io->Pos = 0;
+    io->Ptr = buf;
+    io->Size = size;
+
+    if (mf->Flags & MIDIWRITE)
+    {
+	io->Len = 0;
+	mf->FileSize = 0;
+	if (!buf) io->Size = 0;
+    }
+    else
+    {
+	io->Len = size;
+	mf->FileSize = (LONG)size;
+    }
+
+    mf->Flags = (mf->Flags & ~MIDIDIRTY) | MIDIMEMIO;
+    mf->Handle = (MIDIHANDLE)io;
+
+    return(0);
+}
+
+
+
+
+/********************************* grow_memory() *******************************
+ * Enlarges a MidiWriteMemory() (or MIDIHOLD) image so that it holds at least size bytes. Returns 0 if success,
+ * or MIDIERRWRITE if out of memory.
+ **************************************************************************/
+
+static LONG grow_memory(MIDIIO * io, ULONG size)
+{
+    register ULONG newsize;
+    register UCHAR * ptr;
+
+    /* Double it each time, so that writing the image costs only a few reallocs */
+    newsize = (io->Size) ? io->Size : MIDIBUFSIZE;
+    while (newsize < size) newsize <<= 1;
+
+    if ( !(ptr = (UCHAR *)realloc(io->Ptr, newsize)) ) return(MIDIERRWRITE);
+    io->Ptr = ptr;
+    io->Size = newsize;
+    return(0);
+}
+
+
+
+
+/******************************** MidiIOFlush() ********************************
+ * Writes out any bytes waiting in the MIDIIO's buffer. Only does anything when we're handling
+ * the I/O for a MidiWriteFile(). For MIDIHOLD, that's the whole file, in one write().
+ **************************************************************************/
+
+LONG MidiIOFlush(MIDIFILE * mf)
+{
+    register MIDIIO * io;
+    LONG result;
+
+    if ( !MIDIOWNIO(mf) || !(mf->Flags & MIDIDIRTY) ) return(0);
+
+    io = MIDIIOPTR(mf);
+    mf->Flags &= ~MIDIDIRTY;
+
+    /* The held file is written out all at once, and then we start over holding whatever is
+	written after it */
+    if (io->Mode == MIDIIOHOLD)
+    {
+	if ( (result = write_fully(mf, io->fd, io->Ptr, io->Len)) ) return(result);
+	io->BufStart += io->Len;
+	io->Pos = io->Len = 0;
+	return(0);
+    }
+
+    /* A memory image is never flushed */
+    if (io->Mode != MIDIIOFILE) return(0);
+
+    if ( (result = write_fully(mf, io->fd, io->Ptr, io->Pos)) ) return(result);
+    io->BufStart += io->Pos;
+    io->Pos = 0;
+    return(0);
+}
+
+
+
+
+/******************************** MidiIORead() *********************************
+ * Reads count bytes into buf, decrementing FileSize and ChunkSize. This is the raw read used by
+ * the engine itself. Unlike MidiReadBytes(), it leaves EventSize alone.
+ **************************************************************************/
+
+LONG MidiIORead(MIDIFILE * mf, UCHAR * buf, ULONG count)
+{
+    register MIDIIO * io;
+    register ULONG avail;
+    LONG result;
+
+    mf->FileSize -= count;
+    mf->ChunkSize -= count;
+
+    if (!MIDIOWNIO(mf))
+    {
+	if ( (result = mf->Callbacks->ReadWriteMidi(mf, buf, count)) ) return(result);
+	return(0);
+    }
+
+    io = MIDIIOPTR(mf);
+    avail = io->Len - io->Pos;
+
+    /* Most reads are a byte or two, and are satisfied from the buffer */
+    while (count > avail)
+    {
+	/* A mapped file or memory image is entirely in memory, so there's nothing more to read */
+	if (io->Mode != MIDIIOFILE) return(MIDIERRREAD);
+
+	memcpy(buf, &io->Ptr[io->Pos], avail);
+	buf += avail;
+	count -= avail;
+	io->BufStart += io->Len;
+	io->Pos = io->Len = 0;
+
+	/* A big read goes straight into the caller's buffer */
+	if (count >= io->Size)
+	{
+	    if ( (result = read_fully(mf, io->fd, buf, count)) ) return(result);
+	    io->BufStart += count;
+	    return(0);
+	}
+
+	/* Refill the buffer */
+	do
+	{
+	    MIDICOUNT(mf, Reads);
+	    result = read(io->fd, io->Ptr, io->Size);
+	} while (result < 0 && errno == EINTR);
+	if (result <= 0) return(MIDIERRREAD);
+	avail = io->Len = result;
+    }
+
+    memcpy(buf, &io->Ptr[io->Pos], count);
+    io->Pos += count;
+    return(0);
+}
+
+
+
+
+/******************************** MidiIOWrite() ********************************
+ * Writes count bytes from buf, incrementing FileSize. This is the raw write used by the engine
+ * itself. Unlike MidiWriteBytes(), it leaves EventSize alone.
+ **************************************************************************/
+
+LONG MidiIOWrite(MIDIFILE * mf, UCHAR * buf, ULONG count)
+{
+    register MIDIIO * io;
+    LONG result;
+
+    mf->FileSize += count;
+
+    if (!MIDIOWNIO(mf))
+    {
+	if ( (result = mf->Callbacks->ReadWriteMidi(mf, buf, count)) ) return(result);
+	return(0);
+    }
+
+    io = MIDIIOPTR(mf);
+
+    if (io->Pos + count > io->Size)
+    {
+	/* A memory image (or held file) just gets bigger */
+	if (io->Mode == MIDIIOMEM || io->Mode == MIDIIOHOLD)
+	{
+	    if ( (result = grow_memory(io, io->Pos + count)) ) return(result);
+	}
+	else
+	{
+	    if ( (result = MidiIOFlush(mf)) ) return(result);
+
+	    /* A big write goes straight from the caller's buffer */
+	    if (count >= io->Size)
+	    {
+		if ( (result = write_fully(mf, io->fd, buf, count)) ) return(result);
+		io->BufStart += count;
+		return(0);
+	    }
+	}
+    }
+
+    memcpy(&io->Ptr[io->Pos], buf, count);
+    io->Pos += count;
+    if (io->Pos > io->Len) io->Len = io->Pos;
+    mf->Flags |= MIDIDIRTY;
+    return(0);
+}
+
+
+
+
+/******************************* MidiIOReadVLQ() *******************************
+ * Reads a variable length quantity, and stores its value in val. Returns 0 if success, or an
+ * error number.
+ **************************************************************************/
+
+LONG MidiIOReadVLQ(MIDIFILE * mf, ULONG * val)
+{
+    register ULONG value = 0;
+    register USHORT i;
+    register MIDIIO * io;
+    register UCHAR * ptr;
+    UCHAR chr;
+    LONG result;
+
+    /* Usually, all 4 bytes that it could be are already in our buffer (or the mapped file), so
+	just look at them there, rather than reading one byte at a time */
+    io = MIDIIOPTR(mf);
+    if ( MIDIOWNIO(mf) && io->Len - io->Pos >= 4 )
+    {
+	ptr = &io->Ptr[io->Pos];
+	for (i=0; i<4; )
+	{
+	    chr = ptr[i++];
+	    value = (value << 7) | (chr & 0x7F);
+	    if ( !(chr & 0x80) )
+	    {
+		io->Pos += i;
+		mf->FileSize -= i;
+		mf->ChunkSize -= i;
+		*val = value;
+		return(0);
+	    }
+	}
+	return(MIDIERRBAD);
+    }
+
+    /* A variable length quantity is never more than 4 bytes in a MIDI file */
+    for (i=0; i<4; i++)
+    {
+	if ( (result = MidiIORead(mf, &chr, 1)) ) return(result);
+	value = (value << 7) | (chr & 0x7F);
+	if ( !(chr & 0x80) )
+	{
+	    *val = value;
+	    return(0);
+	}
+    }
+
+    return(MIDIERRBAD);
+}
+
+
+
+
+/********************************* MidiIOView() *******************************
+ * Returns a pointer to the next count bytes of the file, and skips past them (decrementing
+ * FileSize and ChunkSize, but not EventSize). For a mapped file, this points directly into the
+ * file's image. Otherwise, the bytes are loaded into our buffer (if they fit) and it points there.
+ * The pointer is valid only until the next read. Returns 0 if the bytes can't be viewed (ie, the
+ * app is doing its own I/O, there aren't that many bytes left, or they won't fit in the buffer),
+ * in which case nothing is skipped.
+ **************************************************************************/
+
+UCHAR * MidiIOView(MIDIFILE * mf, ULONG count)
+{
+    register MIDIIO * io;
+    register ULONG avail;
+    register UCHAR * ptr;
+    ssize_t n;
+
+    if (!MIDIOWNIO(mf) || (mf->Flags & MIDIWRITE)) return(0);
+
+    io = MIDIIOPTR(mf);
+    avail = io->Len - io->Pos;
+
+    if (count > avail)
+    {
+	if (io->Mode != MIDIIOFILE || count > io->Size) return(0);
+
+	/* Move the unread bytes to the head of the buffer, and fill in after them */
+	memmove(io->Ptr, &io->Ptr[io->Pos], avail);
+	io->BufStart += io->Pos;
+	io->Pos = 0;
+	io->Len = avail;
+	while (io->Len < count)
+	{
+	    MIDICOUNT(mf, Reads);
+	    if ( (n = read(io->fd, &io->Ptr[io->Len], io->Size - io->Len)) <= 0 )
+	    {
+		if (n < 0 && errno == EINTR) continue;
+		return(0);
+	    }
+	    io->Len += n;
+	}
+    }
+
+    ptr = &io->Ptr[io->Pos];
+    io->Pos += count;
+    mf->FileSize -= count;
+    mf->ChunkSize -= count;
+    return(ptr);
+}
+
+
+
+
+/***************************** MidiReadBytesView() ****************************
+ * Like MidiReadBytes(), but instead of copying count bytes into the app's buffer, returns a
+ * pointer to them. With the MIDIFILE's MIDIMMAP Flag, that points into the mapped file, so
+ * nothing is copied. The bytes may be looked at only until the next read (ie, before returning
+ * from the callback). Returns 0 if the bytes can't be viewed, in which case nothing is read,
+ * and the app should MidiReadBytes() them instead.
+ **************************************************************************/
+
+UCHAR * EXPENTRY MidiReadBytesView(MIDIFILE * mf, ULONG count)
+{
+    register UCHAR * ptr;
+
+    if ( (ptr = MidiIOView(mf, count)) )
+    {
+	if ( mf->EventSize > (LONG)count )
+	    mf->EventSize -= count;
+	else
+	    mf->EventSize = 0;
+    }
+
+    return(ptr);
+}
+
+
+
+
+/******************************* MidiReadBytes() ******************************
+ * Reads count bytes into buf. Decrements FileSize, ChunkSize, and EventSize (but EventSize never
+ * goes below 0, since an app may use this to read a chunk that isn't an event at all).
+ **************************************************************************/
+
+LONG EXPENTRY MidiReadBytes(MIDIFILE * mf, UCHAR * buf, ULONG count)
+{
+    if ( mf->EventSize > (LONG)count )
+	mf->EventSize -= count;
+    else
+	mf->EventSize = 0;
+
+    return( MidiIORead(mf, buf, count) );
+}
+
+
+
+
+/******************************* MidiReadVLQ() *******************************
+ * Reads a variable length quantity and returns its value, or -1 if an error.
+ **************************************************************************/
+
+LONG EXPENTRY MidiReadVLQ(MIDIFILE * mf)
+{
+    ULONG val;
+    LONG size = mf->FileSize;
+
+    if ( MidiIOReadVLQ(mf, &val) ) return(-1);
+
+    /* Account for the bytes just read in EventSize, as MidiReadBytes() would */
+    size -= mf->FileSize;
+    if ( mf->EventSize > size )
+	mf->EventSize -= size;
+    else
+	mf->EventSize = 0;
+
+    return((LONG)val);
+}
+
+
+
+
+/******************************* MidiReadHeader() *****************************
+ * Reads in a chunk header. The ID's 4 bytes are stored in the MIDIFILE's ID as is (ie, Big
+ * Endian order), and the size is stored in ChunkSize (flipped to the CPU's order).
+ **************************************************************************/
+
+LONG EXPENTRY MidiReadHeader(MIDIFILE * mf)
+{
+    UCHAR buf[8];
+    LONG result;
+
+    if ( (result = MidiIORead(mf, &buf[0], 8)) ) return(result);
+
+    memcpy(&mf->ID, &buf[0], 4);
+    mf->ChunkSize = ((ULONG)buf[4] << 24) | ((ULONG)buf[5] << 16) | ((ULONG)buf[6] << 8) | buf[7];
+
+    return(0);
+}
+
+
+
+
+/********************************* MidiSeek() *********************************
+ * Seeks amt bytes forward/backward from the current position. When reading, FileSize, ChunkSize,
+ * and EventSize are adjusted just as if those bytes had been read. Errors are ignored, since a
+ * bad seek shows up as an error on the next read anyway.
+ **************************************************************************/
+
+VOID EXPENTRY MidiSeek(MIDIFILE * mf, LONG amt)
+{
+    register CALLBACK * cb = mf->Callbacks;
+    register MIDIIO * io;
+    register LONG pos;
+    UCHAR buf[256];
+
+    if (!amt) return;
+
+    if (mf->Flags & MIDIWRITE)
+    {
+	mf->FileSize += amt;
+    }
+    else
+    {
+	mf->FileSize -= amt;
+	mf->ChunkSize -= amt;
+	if ( (mf->EventSize -= amt) < 0 ) mf->EventSize = 0;
+    }
+
+    if (!MIDIOWNIO(mf))
+    {
+	if (cb->SeekMidi)
+	{
+	    cb->SeekMidi(mf, amt, FILE_CURRENT);
+	}
+
+	/* No SeekMidi, so the only thing we can do is read and discard bytes */
+	else if ( !(mf->Flags & MIDIWRITE) )
+	{
+	    while (amt > 0)
+	    {
+		pos = (amt > (LONG)sizeof(buf)) ? (LONG)sizeof(buf) : amt;
+		if ( cb->ReadWriteMidi(mf, &buf[0], (ULONG)pos) ) return;
+		amt -= pos;
+	    }
+	}
+	return;
+    }
+
+    io = MIDIIOPTR(mf);
+
+    if (mf->Flags & MIDIWRITE)
+    {
+	/* Seeking past the end of a memory image (or held file) fills the gap with 0, like a file
+	    would */
+	if (io->Mode == MIDIIOMEM || io->Mode == MIDIIOHOLD)
+	{
+	    if ( (pos = (LONG)io->Pos + amt) < 0 ) pos = 0;
+	    if ( (ULONG)pos > io->Size && grow_memory(io, (ULONG)pos) ) return;
+	    if ( (ULONG)pos > io->Len )
+	    {
+		memset(&io->Ptr[io->Len], 0, (ULONG)pos - io->Len);
+		io->Len = (ULONG)pos;
+		mf->Flags |= MIDIDIRTY;
+	    }
+	    io->Pos = (ULONG)pos;
+	    return;
+	}
+
+	if ( MidiIOFlush(mf) ) return;
+	MIDICOUNT(mf, Seeks);
+	io->BufStart = (LONG)lseek(io->fd, amt, SEEK_CUR);
+	return;
+    }
+
+    /* If the destination is still within the buffer, no need to touch the file */
+    pos = (LONG)io->Pos + amt;
+    if (pos >= 0 && pos <= (LONG)io->Len)
+    {
+	io->Pos = (ULONG)pos;
+	return;
+    }
+
+    /* Outside of a mapped file or memory image. The next read fails */
+    if (io->Mode != MIDIIOFILE)
+    {
+	io->Pos = io->Len;
+	return;
+    }
+
+    MIDICOUNT(mf, Seeks);
+    io->BufStart = (LONG)lseek(io->fd, io->BufStart + pos, SEEK_SET);
+    io->Pos = io->Len = 0;
+}
+
+
+
+
+/******************************* MidiSkipEvent() ******************************
+ * Skips any bytes of the current SYSEX or variable length Meta-Event that haven't been read.
+ **************************************************************************/
+
+VOID EXPENTRY MidiSkipEvent(MIDIFILE * mf)
+{
+    if (mf->EventSize > 0) MidiSeek(mf, mf->EventSize);
+}
+
+
+
+
+/******************************* MidiSkipChunk() ******************************
+ * Skips any bytes of the current chunk that haven't been read.
+ **************************************************************************/
+
+VOID EXPENTRY MidiSkipChunk(MIDIFILE * mf)
+{
+    if (mf->ChunkSize > 0) MidiSeek(mf, mf->ChunkSize);
+}
+
+
+
+
+/******************************* MidiNextChunk() ******************************
+ * Skips the rest of the current chunk (if any) and reads the next chunk's header, checking that
+ * neither chunk overruns. Every loop over a file's chunks goes through here. Returns 0 if success,
+ * -1 if there are no more chunks, or an error number.
+ **************************************************************************/
+
+LONG MidiNextChunk(MIDIFILE * mf)
+{
+    LONG result;
+
+    if ( mf->ChunkSize < 0 ) return(MIDIERRBAD);
+    MidiSkipChunk(mf);
+
+    if ( mf->FileSize < 8 ) return(-1);
+    if ( (result = MidiReadHeader(mf)) ) return(result);
+    if ( mf->ChunkSize < 0 || mf->ChunkSize > mf->FileSize ) return(MIDIERRBAD);
+
+    return(0);
+}
+
+
+
+
+/****************************** MidiWriteBytes() ******************************
+ * Writes count bytes from buf. Increments FileSize and decrements EventSize (but never below 0).
+ **************************************************************************/
+
+LONG EXPENTRY MidiWriteBytes(MIDIFILE * mf, UCHAR * buf, ULONG count)
+{
+    if ( mf->EventSize > (LONG)count )
+	mf->EventSize -= count;
+    else
+	mf->EventSize = 0;
+
+    return( MidiIOWrite(mf, buf, count) );
+}
+
+
+
+
+/******************************* MidiWriteVLQ() *******************************
+ * Writes val as a variable length quantity. Returns MIDIERRBAD, without writing anything, if
+ * val is over MIDIVLQMAX (which no reader could get back).
+ **************************************************************************/
+
+LONG EXPENTRY MidiWriteVLQ(MIDIFILE * mf, ULONG val)
+{
+    UCHAR buf[4];
+
+    if (val > MIDIVLQMAX) return(MIDIERRBAD);
+    return( MidiWriteBytes(mf, &buf[0], MidiLongToVLQ(val, &buf[0])) );
+}
+
+
+
+
+/****************************** MidiWriteHeader() *****************************
+ * Writes a chunk header using the MIDIFILE's ID and ChunkSize. Afterward, ChunkSize is used to
+ * remember where the chunk's data starts so that MidiCloseChunk() can fix up the size.
+ **************************************************************************/
+
+LONG EXPENTRY MidiWriteHeader(MIDIFILE * mf)
+{
+    UCHAR buf[8];
+    LONG result;
+
+    memcpy(&buf[0], &mf->ID, 4);
+    buf[4] = (UCHAR)((ULONG)mf->ChunkSize >> 24);
+    buf[5] = (UCHAR)((ULONG)mf->ChunkSize >> 16);
+    buf[6] = (UCHAR)((ULONG)mf->ChunkSize >> 8);
+    buf[7] = (UCHAR)mf->ChunkSize;
+
+    if ( (result = MidiIOWrite(mf, &buf[0], 8)) ) return(result);
+
+    mf->ChunkSize = mf->FileSize;
+    return(0);
+}
+
+
+
+
+/****************************** MidiCloseChunk() ******************************
+ * Sets the size in the header written by the last MidiWriteHeader() to the number of bytes that
+ * have been written since then. If the header is still in our buffer (which it always is with
+ * MIDIHOLD), it's simply patched there.
+ **************************************************************************/
+
+LONG EXPENTRY MidiCloseChunk(MIDIFILE * mf)
+{
+    register CALLBACK * cb = mf->Callbacks;
+    register MIDIIO * io;
+    LONG len, pos, result;
+    UCHAR buf[4];
+
+    len = mf->FileSize - mf->ChunkSize;
+    buf[0] = (UCHAR)((ULONG)len >> 24);
+    buf[1] = (UCHAR)((ULONG)len >> 16);
+    buf[2] = (UCHAR)((ULONG)len >> 8);
+    buf[3] = (UCHAR)len;
+
+    if (!MIDIOWNIO(mf))
+    {
+	/* Seek back to the size, rewrite it, and seek forward again. If no SeekMidi, we can't */
+	if (!cb->SeekMidi) return(MIDIERRWRITE);
+	cb->SeekMidi(mf, -(len + 4), FILE_CURRENT);
+	if ( (result = cb->ReadWriteMidi(mf, &buf[0], 4)) ) return(result);
+	cb->SeekMidi(mf, len, FILE_CURRENT);
+	return(0);
+    }
+
+    io = MIDIIOPTR(mf);
+    pos = io->BufStart + (LONG)io->Pos - len - 4;
+
+    if (pos >= io->BufStart)
+    {
+	memcpy(&io->Ptr[pos - io->BufStart], &buf[0], 4);
+	return(0);
+    }
+
+    if ( (result = MidiIOFlush(mf)) ) return(result);
+    MIDICOUNT(mf, Writes);
+    if ( pwrite(io->fd, &buf[0], 4, pos) != 4 ) return(MIDIERRWRITE);
+    return(0);
+}
+
+
+
+
+/******************************** MidiFileSize() ******************************
+ * Returns the size of the open MIDI file, or -1 if it can't be determined (ie, the app is
+ * doing its own file I/O, so Handle isn't something that we know about).
+ **************************************************************************/
+
+LONG EXPENTRY MidiFileSize(MIDIFILE * mf)
+{
+    struct stat st;
+    int fd;
+
+    if (MIDIOWNIO(mf))
+    {
+	if (MIDIIOPTR(mf)->Mode == MIDIIOMEM) return((LONG)MIDIIOPTR(mf)->Len);
+	if (MIDIIOPTR(mf)->Mode == MIDIIOHOLD) return(MIDIIOPTR(mf)->BufStart + (LONG)MIDIIOPTR(mf)->Len);
+	fd = MIDIIOPTR(mf)->fd;
+    }
+    else if (!mf->Callbacks->OpenMidi)
+	fd = (int)mf->Handle;
+    else
+	return(-1);
+
+    MIDICOUNT(mf, Others);
+    if ( fstat(fd, &st) ) return(-1);
+    return((LONG)st.st_size);
+}
+
+
+
+
+/******************************** MidiCloseFile() *****************************
+ * Closes the MIDI file, via the app's CloseMidi callback if supplied. If we were doing the I/O,
+ * any buffered bytes are written out first, and the MIDIIO is freed.
+ **************************************************************************/
+
+VOID EXPENTRY MidiCloseFile(MIDIFILE * mf)
+{
+    register CALLBACK * cb = mf->Callbacks;
+    register MIDIIO * io;
+
+    if (MIDIOWNIO(mf))
+    {
+	if ( !(io = MIDIIOPTR(mf)) ) return;
+	MidiIOFlush(mf);
+	if (io->Mode == MIDIIOMAP)
+	{
+	    MIDICOUNT(mf, Others);
+	    munmap(io->Ptr, io->Size);
+	}
+	else if (io->Mode == MIDIIOHOLD)
+	    free(io->Ptr);
+	mf->Handle = (MIDIHANDLE)io->fd;
+	free(io);
+
+	/* A memory image belongs to the app, and there's no file to close */
+	if (mf->Flags & MIDIMEMIO)
+	{
+	    mf->Flags &= ~MIDIMEMIO;
+	    mf->Handle = 0;
+	    return;
+	}
+    }
+
+    if (cb->CloseMidi)
+	cb->CloseMidi(mf);
+    else
+    {
+	MIDICOUNT(mf, Others);
+	close((int)mf->Handle);
+	mf->Handle = 0;
+    }
+}
@@ -0,0 +1,185 @@
+/* ===========================================================================
+ * midiiter.c
+ *
+ * The MIDIFILE engine's MidiNextEvent(). This reads a MIDI file's events one at a time for the
+ * app, which pulls each one when it wants it, rather than having the engine call its callbacks.
+ * The events come one MTrk after another, just as with MidiReadFile().
+ * =========================================================================
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "midipriv.h"
+
+
+
+
+/******************************** get_payload() ********************************
+ * Points the MIDIEVENT's Payload to the next len bytes of the file. That's in place if the
+ * bytes can be viewed there, or else a copy in the MIDIREADER's Buf. Returns 0 if success, or
+ * an error number (MIDIERRBAD if len runs past the end of the MTrk).
+ **************************************************************************/
+
+static LONG get_payload(MIDIREADER * rdr, MIDIEVENT * evt, ULONG len)
+{
+    register MIDIFILE * mf = rdr->MidiFile;
+    register ULONG max;
+    UCHAR * ptr;
+
+    evt->Length = len;
+    if (!len)
+    {
+	evt->Payload = 0;
+	return(0);
+    }
+
+    /* A length past the end of the MTrk is bad, so don't allocate for it */
+    if ( mf->ChunkSize < 0 || len > (ULONG)mf->ChunkSize ) return(MIDIERRBAD);
+
+    if ( (evt->Payload = MidiIOView(mf, len)) ) return(0);
+
+    if (len > rdr->MaxBuf)
+    {
+	max = (rdr->MaxBuf) ? rdr->MaxBuf : 256;
+	while (max < len) max <<= 1;
+	if ( !(ptr = (UCHAR *)realloc(rdr->Buf, max)) ) return(MIDIERRREAD);
+	rdr->Buf = ptr;
+	rdr->MaxBuf = max;
+    }
+
+    evt->Payload = rdr->Buf;
+    return( MidiIORead(mf, rdr->Buf, len) );
+}
+
+
+
+
+/******************************* MidiOpenReader() *****************************
+ * Opens the MIDI file of the MIDIREADER's MidiFile (just as MidiReadFile() does), and reads its
+ * MThd, setting the MIDIFILE's Format, NumTracks, and Division, and calling the app's StartMThd
+ * (if its CALLBACK has one). Returns 0 if success (in which case the app must later
+ * MidiCloseReader()), or an error number (in which case the file has been closed).
+ **************************************************************************/
+
+LONG EXPENTRY MidiOpenReader(MIDIREADER * rdr)
+{
+    register MIDIFILE * mf = rdr->MidiFile;
+    LONG result;
+
+    mf->Flags &= ~(MIDIWRITE|MIDISYSEX|MIDIMEMIO);
+
+    if ( (result = MidiIOOpen(mf)) ) return(result);
+
+    if ( (result = MidiReadMThd(mf, TRUE)) )
+    {
+	MidiCloseFile(mf);
+	return(result);
+    }
+
+    rdr->InTrack = 0;
+    return(0);
+}
+
+
+
+
+/******************************* MidiNextEvent() ******************************
+ * Reads the next event of a file opened with MidiOpenReader(), and fills in evt with it. Each
+ * MTrk's events are read in order (including its End Of Track), and then the next MTrk's.
+ * Chunks other than MTrks are skipped. The MIDIFILE's TrackNum, Time, and PrevTime are kept
+ * up to date just as with MidiReadFile(). Returns 0 if success, -1 if there are no more events,
+ * or an error number.
+ **************************************************************************/
+
+LONG EXPENTRY MidiNextEvent(MIDIREADER * rdr, MIDIEVENT * evt)
+{
+    register MIDIFILE * mf = rdr->MidiFile;
+    register UCHAR status;
+    UCHAR buf[2];
+    ULONG delta, time;
+    LONG result;
+
+    /* Find the next MTrk, if this one is done */
+    while ( !rdr->InTrack || mf->ChunkSize <= 0 )
+    {
+	if ( (result = MidiNextChunk(mf)) ) return(result);
+
+	if ( MidiCompareID((UCHAR *)&mf->ID, (UCHAR *)"MTrk") )
+	{
+	    mf->TrackNum++;
+	    mf->Time = mf->PrevTime = 0;
+	    rdr->InTrack = 1;
+	    rdr->Status = 0;
+	}
+	else
+	    rdr->InTrack = 0;
+    }
+
+    /* Get the event's time */
+    if ( (result = MidiIOReadVLQ(mf, &delta)) ) return(result);
+    time = mf->PrevTime + delta;
+    mf->Time = evt->Time = (mf->Flags & MIDIDELTA) ? delta : time;
+    mf->PrevTime = time;
+    evt->Track = mf->TrackNum;
+
+    if ( (result = MidiIORead(mf, &buf[0], 1)) ) return(result);
+    status = buf[0];
+
+    /* MIDI event with Status 0x80 to 0xEF (perhaps via running status) */
+    if (status < 0xF0)
+    {
+	if (status & 0x80)
+	{
+	    rdr->Status = status;
+	    if ( (result = MidiIORead(mf, &buf[0], 1)) ) return(result);
+	}
+	else if ( !(status = rdr->Status) )
+	    return(MIDIERRSTATUS);
+
+	evt->Status = status;
+	evt->Data1 = buf[0];
+	evt->Data2 = 0xFF;
+	evt->Length = 0;
+	evt->Payload = 0;
+
+	/* Program Change and Channel Pressure have only 1 data byte */
+	if ( (status & 0xE0) != 0xC0 )
+	{
+	    if ( (result = MidiIORead(mf, &evt->Data2, 1)) ) return(result);
+	}
+	return(0);
+    }
+
+    evt->Status = status;
+    evt->Data1 = evt->Data2 = 0;
+
+    /* Meta-Event. An End Of Track ends the MTrk */
+    if (status == 0xFF)
+    {
+	if ( (result = MidiIORead(mf, &evt->Data1, 1)) ) return(result);
+	if (evt->Data1 == 0x2F) rdr->InTrack = 0;
+    }
+    else if (status != 0xF0 && status != 0xF7)
+	return(MIDIERREVENT);
+
+    if ( (result = MidiIOReadVLQ(mf, &delta)) ) return(result);
+    return( get_payload(rdr, evt, delta) );
+}
+
+
+
+
+/****************************** MidiCloseReader() *****************************
+ * Closes the file opened with MidiOpenReader(), and frees any memory that the MIDIREADER
+ * allocated. It can then be reused for another file.
+ **************************************************************************/
+
+VOID EXPENTRY MidiCloseReader(MIDIREADER * rdr)
+{
+    MidiCloseFile(rdr->MidiFile);
+    free(rdr->Buf);
+    rdr->Buf = 0;
+    rdr->MaxBuf = 0;
+    rdr->InTrack = 0;
+}
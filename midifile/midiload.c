@@ -0,0 +1,403 @@
+/* ===========================================================================
+ * midiload.c
+ *
+ * The MIDIFILE engine's MidiLoadEvents(). This decodes an entire MIDI file into a MIDIEVENTS
+ * table without calling any of the app's event callbacks. Each MTrk is fetched whole and then
+ * parsed straight out of memory.
+ * =========================================================================
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "midipriv.h"
+
+
+
+
+/******************************* grow_events() *******************************
+ * Enlarges the arrays of a MIDIEVENTS so that they have room for at least count events.
+ * Returns 0 if success, or MIDIERRREAD if out of memory.
+ **************************************************************************/
+
+static LONG grow_events(MIDIEVENTS * evts, ULONG count)
+{
+    register ULONG max;
+    VOID * ptr;
+
+    if (count <= evts->MaxEvents) return(0);
+
+    /* Double it each time, so that loading costs only a few reallocs */
+    max = (evts->MaxEvents) ? evts->MaxEvents : 1024;
+    while (max < count) max <<= 1;
+
+    if ( !(ptr = realloc(evts->Time, max * sizeof(ULONG))) ) return(MIDIERRREAD);
+    evts->Time = (ULONG *)ptr;
+    if ( !(ptr = realloc(evts->Offset, max * sizeof(ULONG))) ) return(MIDIERRREAD);
+    evts->Offset = (ULONG *)ptr;
+    if ( !(ptr = realloc(evts->Length, max * sizeof(ULONG))) ) return(MIDIERRREAD);
+    evts->Length = (ULONG *)ptr;
+    if ( !(ptr = realloc(evts->Track, max)) ) return(MIDIERRREAD);
+    evts->Track = (UCHAR *)ptr;
+    if ( !(ptr = realloc(evts->Status, max)) ) return(MIDIERRREAD);
+    evts->Status = (UCHAR *)ptr;
+    if ( !(ptr = realloc(evts->Data1, max)) ) return(MIDIERRREAD);
+    evts->Data1 = (UCHAR *)ptr;
+    if ( !(ptr = realloc(evts->Data2, max)) ) return(MIDIERRREAD);
+    evts->Data2 = (UCHAR *)ptr;
+
+    evts->MaxEvents = max;
+    return(0);
+}
+
+
+
+
+/****************************** grow_payload() *******************************
+ * Enlarges the Payload of a MIDIEVENTS so that it has room for at least size bytes. Returns 0
+ * if success, or MIDIERRREAD if out of memory.
+ **************************************************************************/
+
+static LONG grow_payload(MIDIEVENTS * evts, ULONG size)
+{
+    register ULONG max;
+    UCHAR * ptr;
+
+    if (size <= evts->MaxPayload) return(0);
+
+    max = (evts->MaxPayload) ? evts->MaxPayload : 4096;
+    while (max < size) max <<= 1;
+
+    if ( !(ptr = (UCHAR *)realloc(evts->Payload, max)) ) return(MIDIERRREAD);
+    evts->Payload = ptr;
+    evts->MaxPayload = max;
+    return(0);
+}
+
+
+
+
+/******************************* load_track() ********************************
+ * Decodes the len bytes of an MTrk's data at ptr, appending its events to the MIDIEVENTS. Stops
+ * at an End Of Track (which is stored), or the end of the data. Returns 0 if success, or an
+ * error number.
+ **************************************************************************/
+
+static LONG load_track(MIDIEVENTS * evts, register UCHAR * ptr, ULONG len, UCHAR track)
+{
+    register UCHAR * end = ptr + len;
+    register ULONG n = evts->NumEvents;
+    register ULONG val;
+    register UCHAR chr;
+    register ULONG i;
+    UCHAR status = 0;	/* Last MIDI status, for resolving running status */
+    ULONG time = 0;
+    UCHAR type;
+    LONG result;
+
+/* Reads a variable length quantity (of no more than 4 bytes) at ptr into val */
+#define LOADVLQ() \
+    val = 0; \
+    i = 4; \
+    do \
+    { \
+	if (ptr >= end || !i--) return(MIDIERRBAD); \
+	chr = *(ptr)++; \
+	val = (val << 7) | (chr & 0x7F); \
+    } while (chr & 0x80)
+
+    /* Most events are at least 3 bytes, so this is usually the only time the arrays grow */
+    if ( (result = grow_events(evts, n + len/3 + 1)) ) return(result);
+
+    while (ptr < end)
+    {
+	if ( n >= evts->MaxEvents && (result = grow_events(evts, n + 1)) ) return(result);
+
+	/* Get the event's time */
+	LOADVLQ();
+	time += val;
+	evts->Time[n] = time;
+	evts->Track[n] = track;
+	evts->Offset[n] = evts->PayloadSize;
+	evts->Length[n] = 0;
+
+	if (ptr >= end) return(MIDIERRBAD);
+	chr = *(ptr)++;
+
+	/* MIDI event with Status 0x80 to 0xEF (perhaps via running status) */
+	if (chr < 0xF0)
+	{
+	    if (chr & 0x80)
+	    {
+		status = chr;
+		if (ptr >= end) return(MIDIERRBAD);
+		chr = *(ptr)++;
+	    }
+	    else if (!status) return(MIDIERRSTATUS);
+
+	    evts->Status[n] = status;
+	    evts->Data1[n] = chr;
+
+	    /* Program Change and Channel Pressure have only 1 data byte */
+	    if ( (status & 0xE0) == 0xC0 )
+		evts->Data2[n] = 0xFF;
+	    else
+	    {
+		if (ptr >= end) return(MIDIERRBAD);
+		evts->Data2[n] = *(ptr)++;
+	    }
+	    n++;
+	    continue;
+	}
+
+	/* SYSEX, or a Meta-Event. Either way, the data goes into the Payload */
+	if (chr == 0xFF)
+	{
+	    if (ptr >= end) return(MIDIERRBAD);
+	    type = *(ptr)++;
+	}
+	else if (chr == 0xF0 || chr == 0xF7)
+	    type = 0;
+	else
+	    return(MIDIERREVENT);
+
+	evts->Status[n] = chr;
+	evts->Data1[n] = type;
+	evts->Data2[n] = 0;
+	LOADVLQ();
+	if ( val > (ULONG)(end - ptr) ) return(MIDIERRBAD);
+	if ( (result = grow_payload(evts, evts->PayloadSize + val)) ) return(result);
+	memcpy(&evts->Payload[evts->PayloadSize], ptr, val);
+	evts->PayloadSize += val;
+	evts->Length[n++] = val;
+	ptr += val;
+
+	if (chr == 0xFF && type == 0x2F) break;
+    }
+
+#undef LOADVLQ
+
+    evts->NumEvents = n;
+    return(0);
+}
+
+
+
+
+/* One MTrk of a MIDIPARALLEL load */
+typedef struct _LOADTRK
+{
+    UCHAR *	Ptr;	/* The MTrk's data */
+    ULONG	Len;	/* Its size */
+    UCHAR *	Buf;	/* If we had to read the data into memory, the buffer to free */
+    UCHAR	Track;	/* Its TrackNum */
+    MIDIEVENTS	Evts;	/* Its events */
+} LOADTRK;
+
+
+
+
+/******************************** load_one() *********************************
+ * Called by MidiParallel() to decode the MTrk numbered item into its own MIDIEVENTS.
+ **************************************************************************/
+
+static LONG load_one(VOID * arg, ULONG item)
+{
+    register LOADTRK * trk = &((LOADTRK *)arg)[item];
+
+    return( load_track(&trk->Evts, trk->Ptr, trk->Len, trk->Track) );
+}
+
+
+
+
+/****************************** load_parallel() ******************************
+ * Does the rest of load_file() (ie, after the MThd) for the MIDIPARALLEL Flag. First, the chunk
+ * headers are scanned to find each MTrk's data. With a mapped file or memory image, the data
+ * is looked at in place. Otherwise, each MTrk is read into its own buffer. Then the MTrks are
+ * decoded on worker threads, each into its own MIDIEVENTS, and those are appended in order to
+ * the app's MIDIEVENTS.
+ **************************************************************************/
+
+static LONG load_parallel(MIDIFILE * mf, MIDIEVENTS * evts)
+{
+    register LOADTRK * trk;
+    register ULONG i, j, n;
+    LOADTRK * trks;
+    ULONG num, max;
+    ULONG events, payload;
+    LONG result;
+
+    max = (mf->NumTracks) ? mf->NumTracks : 16;
+    if ( !(trks = (LOADTRK *)calloc(max, sizeof(LOADTRK))) ) return(MIDIERRREAD);
+    num = 0;
+
+    /* Find each MTrk, and skip any other chunks */
+    while ( !(result = MidiNextChunk(mf)) )
+    {
+	if ( MidiCompareID((UCHAR *)&mf->ID, (UCHAR *)"MTrk") )
+	{
+	    /* A file with more MTrks than its MThd says */
+	    if (num >= max)
+	    {
+		if ( !(trk = (LOADTRK *)realloc(trks, (max << 1) * sizeof(LOADTRK))) )
+		{
+		    result = MIDIERRREAD;
+		    goto out;
+		}
+		memset(&trk[max], 0, max * sizeof(LOADTRK));
+		trks = trk;
+		max <<= 1;
+	    }
+
+	    trk = &trks[num++];
+	    trk->Track = ++mf->TrackNum;
+	    trk->Len = mf->ChunkSize;
+	    if ( !MIDIIOSTABLE(mf) || !(trk->Ptr = MidiIOView(mf, trk->Len)) )
+	    {
+		if ( !(trk->Ptr = trk->Buf = (UCHAR *)malloc(trk->Len ? trk->Len : 1)) )
+		{
+		    result = MIDIERRREAD;
+		    goto out;
+		}
+		if ( (result = MidiIORead(mf, trk->Ptr, trk->Len)) ) goto out;
+	    }
+	}
+    }
+    if ( result != -1 || (result = MidiParallel(num, load_one, trks)) ) goto out;
+
+    /* Append each MTrk's events */
+    events = payload = 0;
+    for (i = 0; i < num; i++)
+    {
+	events += trks[i].Evts.NumEvents;
+	payload += trks[i].Evts.PayloadSize;
+    }
+    if ( (result = grow_events(evts, events)) || (result = grow_payload(evts, payload)) ) goto out;
+
+    for (i = 0; i < num; i++)
+    {
+	trk = &trks[i];
+	n = evts->NumEvents;
+	memcpy(&evts->Time[n], trk->Evts.Time, trk->Evts.NumEvents * sizeof(ULONG));
+	memcpy(&evts->Length[n], trk->Evts.Length, trk->Evts.NumEvents * sizeof(ULONG));
+	memcpy(&evts->Track[n], trk->Evts.Track, trk->Evts.NumEvents);
+	memcpy(&evts->Status[n], trk->Evts.Status, trk->Evts.NumEvents);
+	memcpy(&evts->Data1[n], trk->Evts.Data1, trk->Evts.NumEvents);
+	memcpy(&evts->Data2[n], trk->Evts.Data2, trk->Evts.NumEvents);
+	for (j = 0; j < trk->Evts.NumEvents; j++)
+	    evts->Offset[n + j] = trk->Evts.Offset[j] + evts->PayloadSize;
+	if (trk->Evts.PayloadSize)
+	    memcpy(&evts->Payload[evts->PayloadSize], trk->Evts.Payload, trk->Evts.PayloadSize);
+	evts->NumEvents += trk->Evts.NumEvents;
+	evts->PayloadSize += trk->Evts.PayloadSize;
+    }
+
+out:
+    for (i = 0; i < num; i++)
+    {
+	free(trks[i].Buf);
+	MidiFreeEvents(&trks[i].Evts);
+    }
+    free(trks);
+    return(result);
+}
+
+
+
+
+/******************************* load_file() *********************************
+ * Does the real work of MidiLoadEvents() once the file is open.
+ **************************************************************************/
+
+static LONG load_file(MIDIFILE * mf, MIDIEVENTS * evts)
+{
+    register UCHAR * ptr;
+    UCHAR * buf = 0;
+    ULONG bufsize = 0;
+    ULONG len;
+    LONG result;
+
+    if ( (result = MidiReadMThd(mf, FALSE)) ) return(result);
+
+    if ( (mf->Flags & MIDIPARALLEL) && mf->NumTracks > 1 ) return( load_parallel(mf, evts) );
+
+    /* Decode each MTrk, and skip any other chunks */
+    while ( !(result = MidiNextChunk(mf)) )
+    {
+	if ( MidiCompareID((UCHAR *)&mf->ID, (UCHAR *)"MTrk") )
+	{
+	    mf->TrackNum++;
+
+	    /* Look at the MTrk in place if we can. Otherwise, read it into our own buffer */
+	    len = mf->ChunkSize;
+	    if ( !(ptr = MidiIOView(mf, len)) )
+	    {
+		if (len > bufsize)
+		{
+		    free(buf);
+		    bufsize = len;
+		    if ( !(buf = (UCHAR *)malloc(bufsize)) )
+		    {
+			result = MIDIERRREAD;
+			break;
+		    }
+		}
+		ptr = buf;
+		if ( (result = MidiIORead(mf, ptr, len)) ) break;
+	    }
+
+	    if ( (result = load_track(evts, ptr, len, mf->TrackNum)) ) break;
+	}
+    }
+
+    free(buf);
+    return( (result == -1) ? 0 : result );
+}
+
+
+
+
+/****************************** MidiLoadEvents() ******************************
+ * Reads in a MIDI file, decoding all of its events into the MIDIEVENTS table. None of the app's
+ * callbacks are called, except OpenMidi, ReadWriteMidi, SeekMidi, and CloseMidi (if supplied).
+ * The MThd's Format, NumTracks, and Division are stored in the MIDIFILE. With the MIDIPARALLEL
+ * Flag, the MTrks are decoded on several threads, but the table is exactly the same. Returns 0
+ * if success, or an error number (ie, one of the MIDIERR values).
+ **************************************************************************/
+
+LONG EXPENTRY MidiLoadEvents(MIDIFILE * mf, MIDIEVENTS * evts)
+{
+    LONG result;
+
+    mf->Flags &= ~(MIDIWRITE|MIDISYSEX|MIDIMEMIO);
+    evts->NumEvents = evts->PayloadSize = 0;
+
+    if ( (result = MidiIOOpen(mf)) ) return(result);
+
+    result = load_file(mf, evts);
+
+    MidiCloseFile(mf);
+
+    return(result);
+}
+
+
+
+
+/****************************** MidiFreeEvents() ******************************
+ * Frees the memory of a MIDIEVENTS table loaded by MidiLoadEvents(), and zeroes it.
+ **************************************************************************/
+
+VOID EXPENTRY MidiFreeEvents(MIDIEVENTS * evts)
+{
+    free(evts->Time);
+    free(evts->Track);
+    free(evts->Status);
+    free(evts->Data1);
+    free(evts->Data2);
+    free(evts->Offset);
+    free(evts->Length);
+    free(evts->Payload);
+    memset(evts, 0, sizeof(MIDIEVENTS));
+}
@@ -0,0 +1,409 @@
+/* ===========================================================================
+ * midiparse.c
+ *
+ * The MIDIFILE engine's MidiParserFeed(). This reads a MIDI file that the app pushes to it a
+ * block at a time (eg, as it arrives over a slow link), rather than one that the engine pulls
+ * from the file. Each part of the file (the MThd, an MTrk event, or a whole chunk other than an
+ * MTrk) is read by the same code as MidiReadFile(), once all of its bytes are here. Usually,
+ * that's straight out of the app's block. Only a part that's split between blocks is copied.
+ * =========================================================================
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "midipriv.h"
+
+
+
+/* MIDIPARSER States */
+#define PARSEMTHD  0	/* The MThd (ie, nothing has been read yet) */
+#define PARSECHUNK 1	/* A chunk header */
+#define PARSEEVENT 2	/* An MTrk event */
+#define PARSEOTHER 3	/* The data of a chunk other than an MTrk */
+#define PARSESKIP  4	/* The rest of an MTrk that isn't read (ie, skipped or after its End Of Track) */
+#define PARSELOAD  5	/* The data of an MTrk that's loaded into the app's buffer */
+
+/* What part_size() returns for an MTrk event that claims to be longer than the rest of its MTrk */
+#define PARTBAD 0xFFFFFFFF
+
+
+
+
+/********************************* vlq_end() ***********************************
+ * Returns the offset after the variable length quantity at ptr[pos], and stores its value in
+ * val. If it isn't all here, returns 0. If it's too long, returns the offset after the 4 bytes
+ * that it could be (so that reading it fails just as it does with MidiReadFile()).
+ **************************************************************************/
+
+static ULONG vlq_end(const UCHAR * ptr, ULONG len, register ULONG pos, ULONG * val)
+{
+    register ULONG i, value = 0;
+
+    for (i = 0; i < 4; i++)
+    {
+	if (pos >= len) return(0);
+	value = (value << 7) | (ptr[pos] & 0x7F);
+	if ( !(ptr[pos++] & 0x80) )
+	{
+	    *val = value;
+	    return(pos);
+	}
+    }
+
+    *val = 0;
+    return(pos);
+}
+
+
+
+
+/******************************** part_size() **********************************
+ * Returns the size of the next part of the file, from the len bytes of it at ptr, or 0 if there
+ * aren't enough of them to tell. A part that's bad has the size of the bytes that show it's bad,
+ * so that reading it fails just as it does with MidiReadFile(). An MTrk event that would run
+ * past the end of its MTrk returns PARTBAD instead, so that nothing is held for it.
+ **************************************************************************/
+
+static ULONG part_size(MIDIPARSER * prs, const UCHAR * ptr, ULONG len)
+{
+    register ULONG pos;
+    register UCHAR status;
+    ULONG size;
+
+    switch (prs->State)
+    {
+	case PARSEMTHD:
+	    if (len < 8) return(0);
+	    size = ((ULONG)ptr[4] << 24) | ((ULONG)ptr[5] << 16) | ((ULONG)ptr[6] << 8) | ptr[7];
+	    if ( memcmp(ptr, "MThd", 4) || size < 6 || size > 0x7FFFFF00 ) return(8);
+	    return(8 + size);
+
+	case PARSECHUNK:
+	    return(8);
+
+	case PARSEOTHER:
+	    return( (ULONG)prs->MidiFile->ChunkSize );
+
+	case PARSEEVENT:
+	    if ( !(pos = vlq_end(ptr, len, 0, &size)) || pos >= len ) return(0);
+	    status = ptr[pos++];
+
+	    /* MIDI event with Status 0x80 to 0xEF (perhaps via running status) */
+	    if (status < 0xF0)
+	    {
+		if ( !(status & 0x80) )
+		{
+		    if ( !(status = prs->Status) ) return(pos);
+		    pos--;
+		}
+		return( pos + (((status & 0xE0) == 0xC0) ? 1 : 2) );
+	    }
+
+	    /* SYSEX, ESCAPE, or Meta-Event, with its length */
+	    if (status == 0xFF)
+	    {
+		if (pos >= len) return(0);
+		pos++;
+	    }
+	    else if (status != 0xF0 && status != 0xF7) return(pos);
+	    if ( !(pos = vlq_end(ptr, len, pos, &size)) ) return(0);
+	    if ( size > (ULONG)prs->MidiFile->ChunkSize || pos + size > (ULONG)prs->MidiFile->ChunkSize ) return(PARTBAD);
+	    return(pos + size);
+    }
+
+    return(0);
+}
+
+
+
+
+/******************************** hold_bytes() *********************************
+ * Adds count bytes from buf to the part being held. Hold is only enlarged for the bytes that
+ * have actually arrived (not for the size that the part claims). Returns 0 if success, or
+ * MIDIERRREAD if out of memory.
+ **************************************************************************/
+
+static LONG hold_bytes(MIDIPARSER * prs, const UCHAR * buf, ULONG count)
+{
+    register ULONG size = prs->HoldLen + count;
+    register UCHAR * ptr;
+
+    /* A part too big for Buf gets Hold instead. Double it each time, so a part that arrives in
+	many small blocks costs only a few reallocs */
+    if ( size > MIDIPARSEBUF && size > prs->MaxHold )
+    {
+	size = (prs->MaxHold) ? prs->MaxHold : MIDIPARSEBUF * 4;
+	while (size < prs->HoldLen + count) size <<= 1;
+	if ( !(ptr = (UCHAR *)realloc(prs->Hold, size)) ) return(MIDIERRREAD);
+	if (!prs->MaxHold) memcpy(ptr, &prs->Buf[0], prs->HoldLen);
+	prs->Hold = ptr;
+	prs->MaxHold = size;
+    }
+
+    memcpy( ((prs->MaxHold) ? prs->Hold : &prs->Buf[0]) + prs->HoldLen, buf, count );
+    prs->HoldLen += count;
+    return(0);
+}
+
+
+
+
+/******************************** start_chunk() ********************************
+ * Starts the chunk whose header has just been read, and picks the State for its data. Returns 0
+ * if success, or an error number.
+ **************************************************************************/
+
+static LONG start_chunk(MIDIPARSER * prs)
+{
+    register MIDIFILE * mf = prs->MidiFile;
+    register CALLBACK * cb = mf->Callbacks;
+    LONG result;
+
+    if ( mf->ChunkSize < 0 ) return(MIDIERRBAD);
+
+    if ( !MidiCompareID((UCHAR *)&mf->ID, (UCHAR *)"MTrk") )
+    {
+	/* An empty chunk needn't wait for anything */
+	if (!mf->ChunkSize)
+	{
+	    mf->EventSize = 0;
+	    if ( cb->UnknownChunk && (result = cb->UnknownChunk(mf)) ) return(result);
+	    return(0);
+	}
+
+	/* It's only held if the app wants to read it. Otherwise, it's counted off */
+	prs->State = (cb->UnknownChunk) ? PARSEOTHER : PARSESKIP;
+	return(0);
+    }
+
+    mf->TrackNum++;
+    mf->Time = mf->PrevTime = 0;
+    mf->RunStatus = 0;
+    mf->Flags &= ~MIDISYSEX;
+    if (mf->Arena) mf->Arena->Sysex = 0;
+    prs->Status = 0;
+    MIDIDATAPTR(mf) = 0;
+
+    /* A -1 from StartMTrk skips this MTrk */
+    if ( cb->StartMTrk && (result = cb->StartMTrk(mf)) )
+    {
+	if (result != -1) return(result);
+	prs->State = PARSESKIP;
+    }
+
+    /* Does the app want the whole MTrk loaded into its buffer? HoldLen counts what's loaded */
+    else if ( MIDIDATAPTR(mf) )
+    {
+	prs->State = PARSELOAD;
+	prs->HoldLen = 0;
+    }
+
+    else
+	prs->State = PARSEEVENT;
+
+    /* An empty MTrk is already done */
+    if (!mf->ChunkSize)
+    {
+	if ( prs->State == PARSELOAD && cb->StandardEvt && (result = cb->StandardEvt(mf)) ) return(result);
+	prs->State = PARSECHUNK;
+    }
+    return(0);
+}
+
+
+
+
+/********************************* read_part() *********************************
+ * Reads the next part of the file, whose size bytes are at ptr, calling the app's callbacks.
+ * Returns 0 if success, or an error number.
+ **************************************************************************/
+
+static LONG read_part(MIDIPARSER * prs, const UCHAR * ptr, ULONG size)
+{
+    register MIDIFILE * mf = prs->MidiFile;
+    MIDIIO io;
+    LONG result = 0;
+
+    /* The MIDIFILE reads the part as a memory image */
+    io.fd = -1;
+    io.Mode = MIDIIOMEM;
+    io.BufStart = 0;
+    io.Pos = 0;
+    io.Len = io.Size = size;
+    io.Ptr = (UCHAR *)ptr;
+    mf->Handle = (MIDIHANDLE)&io;
+    mf->Flags |= MIDIMEMIO;
+
+    switch (prs->State)
+    {
+	case PARSEMTHD:
+	    if ( !(result = MidiReadMThd(mf, TRUE)) ) prs->State = PARSECHUNK;
+	    break;
+
+	case PARSECHUNK:
+	    if ( !(result = MidiReadHeader(mf)) ) result = start_chunk(prs);
+	    break;
+
+	case PARSEOTHER:
+	    mf->EventSize = 0;
+	    if ( !mf->Callbacks->UnknownChunk || !(result = mf->Callbacks->UnknownChunk(mf)) )
+	    {
+		MidiSkipChunk(mf);
+		prs->State = PARSECHUNK;
+	    }
+	    break;
+
+	default:
+	    /* The rest of the MTrk after an End Of Track is skipped */
+	    if ( (result = MidiReadEvent(mf, &prs->Status)) == -1 )
+	    {
+		result = 0;
+		prs->State = PARSESKIP;
+	    }
+	    if ( mf->ChunkSize < 0 ) result = MIDIERRBAD;
+	    if ( !mf->ChunkSize )
+	    {
+		/* A SYSEX that MIDIWHOLESYSEX is putting together ends with the MTrk */
+		if (!result) result = MidiEndSysex(mf);
+		prs->State = PARSECHUNK;
+	    }
+    }
+
+    mf->Flags &= ~MIDIMEMIO;
+    return(result);
+}
+
+
+
+
+/****************************** MidiParserFeed() ******************************
+ * Reads the next len bytes of a MIDI file, from buf, calling the callbacks of the MIDIPARSER's
+ * MidiFile for each part of the file that's now complete. The callbacks are called just as with
+ * MidiReadFile(), and can read the bytes of their part with MidiReadBytes() (or
+ * MidiReadBytesView()) as usual, but not any further. StartMTrk can skip an MTrk, or have it
+ * loaded whole into the app's buffer (in which case StandardEvt is called once it's all here).
+ * A chunk other than an MTrk is held until it's all here, and then passed to UnknownChunk (or if
+ * there's no UnknownChunk, it's just counted off as it arrives). The MIDIFILE's FileSize isn't
+ * known, so it starts at 0x7FFFFFFF and counts down. Its Handle is used while parsing, but put
+ * back afterward. Returns 0 if success, or an error number. After an error, that error is
+ * returned for every later block.
+ **************************************************************************/
+
+LONG EXPENTRY MidiParserFeed(MIDIPARSER * prs, const UCHAR * buf, ULONG len)
+{
+    register MIDIFILE * mf = prs->MidiFile;
+    register ULONG count;
+    MIDIHANDLE handle;
+    ULONG need;
+    LONG result = 0;
+
+    if (prs->Error) return(prs->Error);
+
+    /* Start of the file? */
+    if ( prs->State == PARSEMTHD && !prs->HoldLen )
+    {
+	mf->Flags &= ~(MIDIWRITE|MIDISYSEX|MIDIMEMIO);
+	mf->FileSize = 0x7FFFFFFF;
+	prs->Need = 0;
+    }
+
+    handle = mf->Handle;
+
+    while (len && !result)
+    {
+	/* Bytes that don't get parsed are simply counted off */
+	if (prs->State == PARSESKIP || prs->State == PARSELOAD)
+	{
+	    count = ( len < (ULONG)mf->ChunkSize ) ? len : (ULONG)mf->ChunkSize;
+	    if (prs->State == PARSELOAD)
+	    {
+		memcpy(MIDIDATAPTR(mf) + prs->HoldLen, buf, count);
+		prs->HoldLen += count;
+	    }
+	    mf->FileSize -= count;
+	    mf->ChunkSize -= count;
+	    buf += count;
+	    len -= count;
+	    if (!mf->ChunkSize)
+	    {
+		if ( prs->State == PARSELOAD && mf->Callbacks->StandardEvt ) result = mf->Callbacks->StandardEvt(mf);
+		prs->State = PARSECHUNK;
+		prs->HoldLen = 0;
+	    }
+	    continue;
+	}
+
+	/* If the whole part is here, it's read straight out of buf */
+	if (!prs->HoldLen)
+	{
+	    if ( (need = part_size(prs, buf, len)) == PARTBAD )
+	    {
+		result = MIDIERRBAD;
+		break;
+	    }
+	    if ( need && need <= len )
+	    {
+		result = read_part(prs, buf, need);
+		buf += need;
+		len -= need;
+		continue;
+	    }
+	    prs->Need = need;
+	}
+
+	/* Otherwise, it's held until the rest arrives. Until its size is known, that's a byte at
+	    a time (so that nothing after the part is held) */
+	count = (prs->Need) ? prs->Need - prs->HoldLen : 1;
+	if (count > len) count = len;
+	if ( (result = hold_bytes(prs, buf, count)) ) break;
+	buf += count;
+	len -= count;
+	if ( !prs->Need &&
+	     (prs->Need = part_size(prs, (prs->MaxHold) ? prs->Hold : &prs->Buf[0], prs->HoldLen)) == PARTBAD )
+	{
+	    result = MIDIERRBAD;
+	    break;
+	}
+
+	if ( prs->Need && prs->HoldLen >= prs->Need )
+	{
+	    result = read_part(prs, (prs->MaxHold) ? prs->Hold : &prs->Buf[0], prs->Need);
+	    prs->HoldLen = prs->Need = 0;
+	}
+    }
+
+    mf->Handle = handle;
+    return( prs->Error = result );
+}
+
+
+
+
+/******************************* MidiParserEnd() ******************************
+ * Ends the MIDI file being read by MidiParserFeed() (ie, after its last block), frees any
+ * memory that the MIDIPARSER allocated, and readies it for another file. Returns 0 if the file
+ * was complete (ie, didn't end in the middle of a chunk), or an error number (MIDIERRNOMIDI if
+ * there was no MThd, MIDIERRREAD if the file was cut short, or the error from
+ * MidiParserFeed()).
+ **************************************************************************/
+
+LONG EXPENTRY MidiParserEnd(MIDIPARSER * prs)
+{
+    register MIDIFILE * mf = prs->MidiFile;
+    LONG result = prs->Error;
+
+    /* Like MidiReadFile(), a few leftover bytes that can't be a chunk are ignored */
+    if (!result)
+    {
+	if (prs->State == PARSEMTHD)
+	    result = MIDIERRNOMIDI;
+	else if (prs->State != PARSECHUNK)
+	    result = MIDIERRREAD;
+    }
+
+    free(prs->Hold);
+    memset(prs, 0, sizeof(MIDIPARSER));
+    prs->MidiFile = mf;
+    return(result);
+}
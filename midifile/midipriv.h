@@ -0,0 +1,119 @@
+/* ============================== MIDIPRIV.H ================================
+ *  Private definitions shared by the source modules of the MIDIFILE engine. Apps never include
+ *  this. They only need midifile.h.
+ ========================================================================== */
+
+#ifndef MIDIPRIV_H
+#define MIDIPRIV_H
+
+#include "midifile.h"
+
+
+/* Size of the engine's file I/O buffer (ie, when the app doesn't supply its own ReadWriteMidi) */
+#define MIDIBUFSIZE 16384
+
+/* The only seek type that the engine passes to an app's SeekMidi callback. This is the same
+    value as OS/2's FILE_CURRENT for DosSetFilePtr(). */
+#ifndef FILE_CURRENT
+#define FILE_CURRENT 1
+#endif
+
+
+/* ===========================================================================
+    MIDIIO structure -- allocated by the engine when it opens a file itself (ie, the app's
+    CALLBACK has no ReadWriteMidi), or for MidiReadMemory() and MidiWriteMemory(). The MIDIFILE's
+    Handle points to this while the file is open, so all I/O state belongs to that one MIDIFILE.
+    For a file mapped with MIDIMMAP, or a memory image, Ptr points to the whole image, and
+    BufStart stays 0. No buffer is allocated for those. For a MIDIHOLD write, Ptr is a separate
+    allocation that grows to hold the whole file.
+ */
+
+typedef struct _MIDIIO
+{
+    int     fd;        /* POSIX handle of the open file, or -1 for a memory image */
+    UCHAR   Mode;      /* MIDIIOFILE, MIDIIOMAP, MIDIIOMEM, or MIDIIOHOLD */
+    LONG    BufStart;  /* File offset of Ptr[0] */
+    ULONG   Pos;       /* For reads, the next unread byte at Ptr. For writes, the number of
+			  bytes waiting at Ptr to be flushed (or for MIDIIOMEM and MIDIIOHOLD, the
+			  write position) */
+    ULONG   Len;       /* For reads, the number of bytes loaded at Ptr. For MIDIIOMEM and
+			  MIDIIOHOLD writes, the size of the image written so far */
+    ULONG   Size;      /* Number of bytes that Ptr can hold */
+    UCHAR * Ptr;       /* The buffer (allocated right after the MIDIIO), or the memory image */
+} MIDIIO;
+
+/* MIDIIO Modes */
+#define MIDIIOFILE 0   /* Buffered reads/writes of fd */
+#define MIDIIOMAP  1   /* Ptr is fd mapped into memory (read only) */
+#define MIDIIOMEM  2   /* Ptr is the app's memory image (MidiReadMemory/MidiWriteMemory) */
+#define MIDIIOHOLD 3   /* Ptr is the whole file being written to fd, held until flushed */
+
+/* Fetches the MIDIIO from a MIDIFILE whose file the engine is handling */
+#define MIDIIOPTR(mf) ((MIDIIO *)(mf)->Handle)
+
+/* True if the engine (rather than the app's callbacks) is doing the file I/O */
+#define MIDIOWNIO(mf) ( ((mf)->Flags & MIDIMEMIO) || !(mf)->Callbacks->ReadWriteMidi )
+
+/* Counts a system call in the MIDIFILE's MIDIIOSTATS (if the app supplied one) */
+#define MIDICOUNT(mf, field) do { if ((mf)->IOStats) (mf)->IOStats->field++; } while (0)
+
+/* True if a pointer from MidiIOView() stays valid after more reads (ie, it points into a mapped
+    file or memory image, rather than our buffer) */
+#define MIDIIOSTABLE(mf) ( MIDIOWNIO(mf) && MIDIIOPTR(mf)->Mode != MIDIIOFILE )
+
+/* A function that MidiParallel() calls for each item */
+typedef LONG (*MIDIWORK)(VOID * arg, ULONG item);
+
+/* The pointer that an app stores in the ULONG at Data[2] (ie, METATXT's Ptr) */
+#define MIDIDATAPTR(mf) (((METATXT *)(mf))->Ptr)
+
+/* Where MidiReadMerged() (or MidiConvertFile()) is up to in one MTrk */
+typedef struct _CURSOR
+{
+    ULONG   Offset;	/* Where its next event is in the file (ie, after that event's delta-time) */
+    LONG    Left;	/* Number of bytes of the MTrk after Offset */
+    ULONG   Time;	/* Time of its next event, referenced from 0 */
+    ULONG   Num;	/* Its order in the file (ie, which comes first for events at the same time) */
+    USHORT  Flags;	/* Its MIDISYSEX Flag */
+    UCHAR   TrackNum;	/* Its MIDIFILE TrackNum */
+    UCHAR   Status;	/* Last MIDI status, for resolving running status */
+    UCHAR   RunStatus;	/* Its MIDIFILE RunStatus */
+} CURSOR;
+
+/* The MTrks that MidiReadMerged() is reading. Heap is a min-heap of the Cursors, ordered by
+    the time of their next event */
+typedef struct _MERGE
+{
+    ULONG    Size;	/* The MIDIFILE's FileSize when opened (ie, for finding file offsets) */
+    ULONG    NumCursors;
+    ULONG    MaxCursors;
+    CURSOR * Cursors;
+    CURSOR ** Heap;
+} MERGE;
+
+/* True if CURSOR a's next event comes before b's */
+#define EARLIER(a, b) ( (a)->Time < (b)->Time || ((a)->Time == (b)->Time && (a)->Num < (b)->Num) )
+
+
+/* midifile.c */
+extern LONG MidiMergeChunks(MIDIFILE * mf, MERGE * mrg);
+extern VOID MidiSiftDown(CURSOR ** heap, ULONG num, ULONG i);
+extern LONG MidiReadMThd(MIDIFILE * mf, BOOL call);
+extern LONG MidiReadEvent(MIDIFILE * mf, UCHAR * status);
+extern LONG MidiEndSysex(MIDIFILE * mf);
+
+/* midiio.c */
+extern LONG MidiIOOpen(MIDIFILE * mf);
+extern LONG MidiIOOpenMemory(MIDIFILE * mf, UCHAR * buf, ULONG size);
+extern LONG MidiIORead(MIDIFILE * mf, UCHAR * buf, ULONG count);
+extern LONG MidiIOWrite(MIDIFILE * mf, UCHAR * buf, ULONG count);
+extern LONG MidiIOFlush(MIDIFILE * mf);
+extern LONG MidiIOReadVLQ(MIDIFILE * mf, ULONG * val);
+extern UCHAR * MidiIOView(MIDIFILE * mf, ULONG count);
+extern LONG MidiNextChunk(MIDIFILE * mf);
+
+/* midithrd.c */
+extern ULONG MidiNumCPUs(VOID);
+extern LONG MidiParallel(ULONG count, MIDIWORK func, VOID * arg);
+
+#endif /* MIDIPRIV_H */
@@ -0,0 +1,523 @@
+/* ===========================================================================
+ * midiscan.c
+ *
+ * The MIDIFILE engine's MidiScanFile(). This skims a MIDI file to find where each MTrk is, and
+ * counts its events, without decoding them or calling any of the app's event callbacks. An app
+ * can use that to size its memory exactly before loading the file, or to skip MTrks it doesn't
+ * need. It can also make checkpoints within each MTrk, for MidiReadFrom(). MidiSaveIndex() and
+ * MidiLoadIndex() store the resulting MIDIINDEX in a file of its own, and read it back.
+ * =========================================================================
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "midipriv.h"
+
+
+
+
+/* The size of a MIDIINDEX's fields in a saved index, not counting each MTrk and checkpoint */
+#define INDEXHDRSIZE 32
+
+/* The size of an MTrk's MIDITRACKINFO, and a checkpoint, in a saved index */
+#define INDEXTRKSIZE ((7 + MIDICOUNTS) * 4)
+#define INDEXCHKSIZE 10
+
+/* Version of the saved index */
+#define INDEXVERSION 1
+
+
+
+
+/******************************** grow_checks() *******************************
+ * Enlarges the Checks of a MIDIINDEX so that it has room for at least count checkpoints.
+ * Returns 0 if success, or MIDIERRREAD if out of memory.
+ **************************************************************************/
+
+static LONG grow_checks(MIDIINDEX * idx, ULONG count)
+{
+    register ULONG max;
+    MIDICHECKPOINT * ptr;
+
+    if (count <= idx->MaxChecks) return(0);
+
+    max = (idx->MaxChecks) ? idx->MaxChecks : 256;
+    while (max < count) max <<= 1;
+
+    if ( !(ptr = (MIDICHECKPOINT *)realloc(idx->Checks, max * sizeof(MIDICHECKPOINT))) ) return(MIDIERRREAD);
+    idx->Checks = ptr;
+    idx->MaxChecks = max;
+    return(0);
+}
+
+
+
+
+/******************************** scan_track() ********************************
+ * Skims the len bytes of an MTrk's data at ptr, filling in the MIDITRACKINFO's event counts.
+ * Stops at an End Of Track, or the end of the data. The same errors are caught as when the MTrk
+ * is loaded. If the MIDIINDEX has a CheckTicks or CheckBytes, checkpoints are added to its
+ * Checks. Returns 0 if success, or an error number.
+ **************************************************************************/
+
+static LONG scan_track(MIDIINDEX * idx, MIDITRACKINFO * trk, register UCHAR * ptr, ULONG len)
+{
+    register UCHAR * end = ptr + len;
+    register ULONG val;
+    register UCHAR chr;
+    register ULONG i;
+    register MIDICHECKPOINT * chk;
+    UCHAR * start = ptr;
+    UCHAR * lastptr = ptr;
+    UCHAR status = 0;	/* Last MIDI status, for resolving running status */
+    UCHAR runstatus = 0;	/* What the MIDIFILE's RunStatus would be */
+    ULONG time = 0;
+    ULONG lasttime = 0;
+    UCHAR type = 0;
+    BOOL check = FALSE;	/* Can there be a checkpoint before the next event? */
+    LONG result;
+
+    trk->FirstCheck = idx->NumChecks;
+
+/* Reads a variable length quantity (of no more than 4 bytes) at ptr into val */
+#define SCANVLQ() \
+    val = 0; \
+    i = 4; \
+    do \
+    { \
+	if (ptr >= end || !i--) return(MIDIERRBAD); \
+	chr = *(ptr)++; \
+	val = (val << 7) | (chr & 0x7F); \
+    } while (chr & 0x80)
+
+    while (ptr < end)
+    {
+	/* Make a checkpoint here if it's been long enough since the last one (or the start) */
+	if ( check && ((idx->CheckTicks && time - lasttime >= idx->CheckTicks) ||
+		       (idx->CheckBytes && (ULONG)(ptr - lastptr) >= idx->CheckBytes)) )
+	{
+	    if ( (result = grow_checks(idx, idx->NumChecks + 1)) ) return(result);
+	    chk = &idx->Checks[idx->NumChecks++];
+	    chk->Offset = trk->Offset + (ULONG)(ptr - start);
+	    chk->Time = lasttime = time;
+	    chk->Status = status;
+	    chk->RunStatus = runstatus;
+	    chk->UnUsed1 = chk->UnUsed2 = 0;
+	    trk->NumChecks++;
+	    lastptr = ptr;
+	}
+
+	/* Get the event's time */
+	SCANVLQ();
+	time += val;
+	trk->NumEvents++;
+
+	if (ptr >= end) return(MIDIERRBAD);
+	chr = *(ptr)++;
+
+	/* MIDI event with Status 0x80 to 0xEF (perhaps via running status). Skip its data */
+	if (chr < 0xF0)
+	{
+	    if (chr & 0x80)
+	    {
+		status = chr;
+		ptr++;
+	    }
+	    else if (!status) return(MIDIERRSTATUS);
+
+	    /* Program Change and Channel Pressure have only 1 data byte */
+	    if ( (status & 0xE0) != 0xC0 ) ptr++;
+	    if (ptr > end) return(MIDIERRBAD);
+
+	    trk->Counts[(status >> 4) - 8]++;
+	    runstatus = status;
+	    check = TRUE;
+	    continue;
+	}
+
+	/* SYSEX, or a Meta-Event. Skip its data */
+	if (chr == 0xFF)
+	{
+	    if (ptr >= end) return(MIDIERRBAD);
+	    type = *(ptr)++;
+	    trk->Counts[MIDICOUNTMETA]++;
+
+	    /* A Meta-Event cancels running status */
+	    runstatus = 0;
+	    check = TRUE;
+	}
+	else if (chr == 0xF0 || chr == 0xF7)
+	{
+	    trk->Counts[(chr == 0xF0) ? MIDICOUNTSYSEX : MIDICOUNTESCAPE]++;
+
+	    /* Whether a SYSEX cancels running status depends upon the MIDIREALTIME Flag when the
+		file is read, and so does the MIDISYSEX Flag. So no checkpoint right after one */
+	    check = FALSE;
+	}
+	else
+	    return(MIDIERREVENT);
+
+	SCANVLQ();
+	if ( val > (ULONG)(end - ptr) ) return(MIDIERRBAD);
+	trk->PayloadSize += val;
+	ptr += val;
+
+	if (chr == 0xFF && type == 0x2F) break;
+    }
+
+#undef SCANVLQ
+
+    trk->EndTime = time;
+    return(0);
+}
+
+
+
+
+/******************************** scan_file() *********************************
+ * Does the real work of MidiScanFile() once the file is open.
+ **************************************************************************/
+
+static LONG scan_file(MIDIFILE * mf, MIDIINDEX * idx)
+{
+    register MIDITRACKINFO * trk;
+    register UCHAR * ptr;
+    UCHAR * buf = 0;
+    ULONG bufsize = 0;
+    ULONG filesize = mf->FileSize;
+    ULONG len, max;
+    LONG result;
+
+    idx->FileSize = filesize;
+    if ( (result = MidiReadMThd(mf, FALSE)) ) return(result);
+    idx->Format = mf->Format;
+    idx->Division = mf->Division;
+
+    /* Skim each MTrk, and skip any other chunks */
+    while ( !(result = MidiNextChunk(mf)) )
+    {
+	if ( MidiCompareID((UCHAR *)&mf->ID, (UCHAR *)"MTrk") )
+	{
+	    mf->TrackNum++;
+
+	    /* Usually, the MThd says how many MTrks there are, so this is the only time it grows */
+	    if (idx->NumTracks >= idx->MaxTracks)
+	    {
+		max = (idx->MaxTracks) ? idx->MaxTracks << 1 : (mf->NumTracks ? mf->NumTracks : 16);
+		if ( max > 0xFFFF || !(trk = (MIDITRACKINFO *)realloc(idx->Tracks, max * sizeof(MIDITRACKINFO))) )
+		{
+		    result = MIDIERRREAD;
+		    break;
+		}
+		idx->Tracks = trk;
+		idx->MaxTracks = (USHORT)max;
+	    }
+
+	    trk = &idx->Tracks[idx->NumTracks++];
+	    memset(trk, 0, sizeof(MIDITRACKINFO));
+	    len = trk->Size = mf->ChunkSize;
+	    trk->Offset = filesize - mf->FileSize;
+
+	    /* Look at the MTrk in place if we can. Otherwise, read it into our own buffer */
+	    if ( !(ptr = MidiIOView(mf, len)) )
+	    {
+		if (len > bufsize)
+		{
+		    free(buf);
+		    bufsize = len;
+		    if ( !(buf = (UCHAR *)malloc(bufsize)) )
+		    {
+			result = MIDIERRREAD;
+			break;
+		    }
+		}
+		ptr = buf;
+		if ( (result = MidiIORead(mf, ptr, len)) ) break;
+	    }
+
+	    if ( (result = scan_track(idx, trk, ptr, len)) ) break;
+	    idx->NumEvents += trk->NumEvents;
+	    idx->PayloadSize += trk->PayloadSize;
+	}
+    }
+
+    free(buf);
+    return( (result == -1) ? 0 : result );
+}
+
+
+
+
+/******************************* MidiScanFile() *******************************
+ * Skims a MIDI file, filling in the MIDIINDEX with where each MTrk is, and how many events of
+ * each kind it has. None of the app's callbacks are called, except OpenMidi, ReadWriteMidi,
+ * SeekMidi, and CloseMidi (if supplied). The MThd's Format, NumTracks, and Division are stored
+ * in the MIDIFILE. Returns 0 if success, or an error number (ie, one of the MIDIERR values).
+ **************************************************************************/
+
+LONG EXPENTRY MidiScanFile(MIDIFILE * mf, MIDIINDEX * idx)
+{
+    LONG result;
+
+    mf->Flags &= ~(MIDIWRITE|MIDISYSEX|MIDIMEMIO);
+    idx->NumTracks = 0;
+    idx->NumEvents = idx->PayloadSize = idx->NumChecks = 0;
+
+    if ( (result = MidiIOOpen(mf)) ) return(result);
+
+    result = scan_file(mf, idx);
+
+    MidiCloseFile(mf);
+
+    return(result);
+}
+
+
+
+
+/******************************* MidiFreeIndex() ******************************
+ * Frees the memory of a MIDIINDEX filled in by MidiScanFile(), and zeroes it.
+ **************************************************************************/
+
+VOID EXPENTRY MidiFreeIndex(MIDIINDEX * idx)
+{
+    free(idx->Tracks);
+    free(idx->Checks);
+    memset(idx, 0, sizeof(MIDIINDEX));
+}
+
+
+
+
+/********************************* put_long() *********************************
+ * Stores val at ptr as a Big Endian ULONG (ie, the byte order of a MIDI file).
+ **************************************************************************/
+
+static VOID put_long(UCHAR * ptr, ULONG val)
+{
+    ptr[0] = (UCHAR)(val >> 24);
+    ptr[1] = (UCHAR)(val >> 16);
+    ptr[2] = (UCHAR)(val >> 8);
+    ptr[3] = (UCHAR)val;
+}
+
+
+
+
+/********************************* get_long() *********************************
+ * Returns the Big Endian ULONG at ptr.
+ **************************************************************************/
+
+static ULONG get_long(const UCHAR * ptr)
+{
+    return( ((ULONG)ptr[0] << 24) | ((ULONG)ptr[1] << 16) | ((ULONG)ptr[2] << 8) | ptr[3] );
+}
+
+
+
+
+/******************************** save_index() ********************************
+ * Does the real work of MidiSaveIndex() once the file is open. The index is one "MIdx" chunk,
+ * with every field Big Endian. First are the MIDIINDEX's fields (starting with a version
+ * number), then each MTrk's MIDITRACKINFO, then all of the checkpoints.
+ **************************************************************************/
+
+static LONG save_index(MIDIFILE * mf, const MIDIINDEX * idx)
+{
+    register const MIDITRACKINFO * trk;
+    register const MIDICHECKPOINT * chk;
+    register UCHAR * ptr;
+    register ULONG i, j;
+    UCHAR buf[64 * INDEXCHKSIZE];
+    LONG result;
+
+    memcpy(&mf->ID, "MIdx", 4);
+    mf->ChunkSize = INDEXHDRSIZE + idx->NumTracks * INDEXTRKSIZE + idx->NumChecks * INDEXCHKSIZE;
+    if ( (result = MidiWriteHeader(mf)) ) return(result);
+
+    buf[0] = 0;
+    buf[1] = INDEXVERSION;
+    buf[2] = (UCHAR)(idx->Format >> 8);
+    buf[3] = (UCHAR)idx->Format;
+    buf[4] = (UCHAR)(idx->NumTracks >> 8);
+    buf[5] = (UCHAR)idx->NumTracks;
+    buf[6] = (UCHAR)(idx->Division >> 8);
+    buf[7] = (UCHAR)idx->Division;
+    put_long(&buf[8], idx->FileSize);
+    put_long(&buf[12], idx->CheckTicks);
+    put_long(&buf[16], idx->CheckBytes);
+    put_long(&buf[20], idx->NumEvents);
+    put_long(&buf[24], idx->PayloadSize);
+    put_long(&buf[28], idx->NumChecks);
+    if ( (result = MidiIOWrite(mf, &buf[0], INDEXHDRSIZE)) ) return(result);
+
+    for (i = 0; i < idx->NumTracks; i++)
+    {
+	trk = &idx->Tracks[i];
+	put_long(&buf[0], trk->Offset);
+	put_long(&buf[4], trk->Size);
+	put_long(&buf[8], trk->NumEvents);
+	put_long(&buf[12], trk->PayloadSize);
+	put_long(&buf[16], trk->EndTime);
+	for (j = 0; j < MIDICOUNTS; j++) put_long(&buf[20 + (j << 2)], trk->Counts[j]);
+	put_long(&buf[20 + (MIDICOUNTS << 2)], trk->FirstCheck);
+	put_long(&buf[24 + (MIDICOUNTS << 2)], trk->NumChecks);
+	if ( (result = MidiIOWrite(mf, &buf[0], INDEXTRKSIZE)) ) return(result);
+    }
+
+    /* The checkpoints, 64 at a time */
+    for (i = 0; i < idx->NumChecks; )
+    {
+	for (ptr = &buf[0]; ptr < &buf[sizeof(buf)] && i < idx->NumChecks; ptr += INDEXCHKSIZE)
+	{
+	    chk = &idx->Checks[i++];
+	    put_long(ptr, chk->Offset);
+	    put_long(ptr + 4, chk->Time);
+	    ptr[8] = chk->Status;
+	    ptr[9] = chk->RunStatus;
+	}
+	if ( (result = MidiIOWrite(mf, &buf[0], (ULONG)(ptr - &buf[0]))) ) return(result);
+    }
+
+    return(0);
+}
+
+
+
+
+/******************************* MidiSaveIndex() ******************************
+ * Writes a MIDIINDEX filled in by MidiScanFile() to a file. The file is opened just as with
+ * MidiWriteFile() (ie, via the app's OpenMidi callback, or Handle points to the filename), so an
+ * app would typically name it after the MIDI file (eg, "song.mid.idx"). Returns 0 if success, or
+ * an error number.
+ **************************************************************************/
+
+LONG EXPENTRY MidiSaveIndex(MIDIFILE * mf, const MIDIINDEX * idx)
+{
+    LONG result;
+
+    mf->Flags = (mf->Flags & ~(MIDISYSEX|MIDIMEMIO)) | MIDIWRITE;
+
+    if ( (result = MidiIOOpen(mf)) ) return(result);
+
+    if ( !(result = save_index(mf, idx)) ) result = MidiIOFlush(mf);
+
+    MidiCloseFile(mf);
+
+    return(result);
+}
+
+
+
+
+/******************************** load_index() ********************************
+ * Does the real work of MidiLoadIndex() once the file is open.
+ **************************************************************************/
+
+static LONG load_index(MIDIFILE * mf, MIDIINDEX * idx)
+{
+    register MIDITRACKINFO * trk;
+    register MIDICHECKPOINT * chk;
+    register UCHAR * ptr;
+    register ULONG i, j;
+    UCHAR buf[64 * INDEXCHKSIZE];
+    ULONG numtracks, numchecks, size;
+    LONG result;
+
+    if ( mf->FileSize < 8 + INDEXHDRSIZE ) return(MIDIERRBAD);
+    if ( (result = MidiReadHeader(mf)) ) return(result);
+    if ( !MidiCompareID((UCHAR *)&mf->ID, (UCHAR *)"MIdx") ) return(MIDIERRBAD);
+    if ( mf->ChunkSize < INDEXHDRSIZE || mf->ChunkSize > mf->FileSize ) return(MIDIERRBAD);
+    size = mf->ChunkSize;
+    if ( (result = MidiIORead(mf, &buf[0], INDEXHDRSIZE)) ) return(result);
+
+    /* An index from some later version of the engine isn't something we can read */
+    if ( buf[0] || buf[1] != INDEXVERSION ) return(MIDIERRBAD);
+
+    numtracks = ((ULONG)buf[4] << 8) | buf[5];
+    numchecks = get_long(&buf[28]);
+    if ( numchecks > size / INDEXCHKSIZE ||
+	 size != INDEXHDRSIZE + numtracks * INDEXTRKSIZE + numchecks * INDEXCHKSIZE ) return(MIDIERRBAD);
+
+    if (numtracks > idx->MaxTracks)
+    {
+	if ( !(trk = (MIDITRACKINFO *)realloc(idx->Tracks, numtracks * sizeof(MIDITRACKINFO))) ) return(MIDIERRREAD);
+	idx->Tracks = trk;
+	idx->MaxTracks = (USHORT)numtracks;
+    }
+    if ( (result = grow_checks(idx, numchecks)) ) return(result);
+
+    idx->Format = ((USHORT)buf[2] << 8) | buf[3];
+    idx->NumTracks = (USHORT)numtracks;
+    idx->Division = ((USHORT)buf[6] << 8) | buf[7];
+    idx->FileSize = get_long(&buf[8]);
+    idx->CheckTicks = get_long(&buf[12]);
+    idx->CheckBytes = get_long(&buf[16]);
+    idx->NumEvents = get_long(&buf[20]);
+    idx->PayloadSize = get_long(&buf[24]);
+    idx->NumChecks = numchecks;
+
+    for (i = 0; i < numtracks; i++)
+    {
+	if ( (result = MidiIORead(mf, &buf[0], INDEXTRKSIZE)) ) return(result);
+	trk = &idx->Tracks[i];
+	trk->Offset = get_long(&buf[0]);
+	trk->Size = get_long(&buf[4]);
+	trk->NumEvents = get_long(&buf[8]);
+	trk->PayloadSize = get_long(&buf[12]);
+	trk->EndTime = get_long(&buf[16]);
+	for (j = 0; j < MIDICOUNTS; j++) trk->Counts[j] = get_long(&buf[20 + (j << 2)]);
+	trk->FirstCheck = get_long(&buf[20 + (MIDICOUNTS << 2)]);
+	trk->NumChecks = get_long(&buf[24 + (MIDICOUNTS << 2)]);
+
+	/* Its checkpoints must be within Checks */
+	if ( trk->FirstCheck > numchecks || trk->NumChecks > numchecks - trk->FirstCheck ) return(MIDIERRBAD);
+    }
+
+    /* The checkpoints, 64 at a time */
+    for (i = 0; i < numchecks; )
+    {
+	j = numchecks - i;
+	if (j > 64) j = 64;
+	if ( (result = MidiIORead(mf, &buf[0], j * INDEXCHKSIZE)) ) return(result);
+	for (ptr = &buf[0]; j--; ptr += INDEXCHKSIZE)
+	{
+	    chk = &idx->Checks[i++];
+	    chk->Offset = get_long(ptr);
+	    chk->Time = get_long(ptr + 4);
+	    chk->Status = ptr[8];
+	    chk->RunStatus = ptr[9];
+	    chk->UnUsed1 = chk->UnUsed2 = 0;
+	}
+    }
+
+    return(0);
+}
+
+
+
+
+/******************************* MidiLoadIndex() ******************************
+ * Reads a MIDIINDEX saved by MidiSaveIndex(). The file is opened just as with MidiReadFile().
+ * The MIDIINDEX is zeroed (or left from a previous load or scan) beforehand, just as for
+ * MidiScanFile(). Returns 0 if success, or an error number (MIDIERRBAD if the file isn't an
+ * index that this version of the engine made).
+ **************************************************************************/
+
+LONG EXPENTRY MidiLoadIndex(MIDIFILE * mf, MIDIINDEX * idx)
+{
+    LONG result;
+
+    mf->Flags &= ~(MIDIWRITE|MIDISYSEX|MIDIMEMIO);
+    idx->NumTracks = 0;
+    idx->NumEvents = idx->PayloadSize = idx->NumChecks = 0;
+
+    if ( (result = MidiIOOpen(mf)) ) return(result);
+
+    result = load_index(mf, idx);
+
+    MidiCloseFile(mf);
+
+    return(result);
+}
@@ -0,0 +1,350 @@
+/* ===========================================================================
+ * miditempo.c
+ *
+ * The MIDIFILE engine's tempo map. This collects the Tempo Meta-Events of a MIDI file into a
+ * MIDITEMPOMAP, with the microseconds at each tempo change summed in advance, so that a time in
+ * ticks can be converted to microseconds (or back) with a binary search rather than by replaying
+ * every tempo before it.
+ * =========================================================================
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "midipriv.h"
+
+
+
+/* The tempo of a MIDI file before its first Tempo Meta-Event (ie, 120 BPM) */
+#define DEFTEMPO 500000
+
+/* The CALLBACK that MidiLoadTempoMap() reads the file with, and the map that it fills in. The
+    CALLBACK is first, so the MIDIFILE's Callbacks can be recast as this. */
+typedef struct _TEMPOREAD
+{
+    CALLBACK	   cb;
+    MIDITEMPOMAP * map;
+} TEMPOREAD;
+
+
+
+
+/******************************** grow_tempos() *******************************
+ * Enlarges the arrays of a MIDITEMPOMAP so that they have room for at least count tempos.
+ * Returns 0 if success, or MIDIERRREAD if out of memory.
+ **************************************************************************/
+
+static LONG grow_tempos(MIDITEMPOMAP * map, ULONG count)
+{
+    register ULONG max;
+    VOID * ptr;
+
+    if (count <= map->MaxTempos) return(0);
+
+    max = (map->MaxTempos) ? map->MaxTempos : 64;
+    while (max < count) max <<= 1;
+
+    if ( !(ptr = realloc(map->Ticks, max * sizeof(ULONG))) ) return(MIDIERRREAD);
+    map->Ticks = (ULONG *)ptr;
+    if ( !(ptr = realloc(map->Tempo, max * sizeof(ULONG))) ) return(MIDIERRREAD);
+    map->Tempo = (ULONG *)ptr;
+    if ( !(ptr = realloc(map->Micros, max * sizeof(double))) ) return(MIDIERRREAD);
+    map->Micros = (double *)ptr;
+    if ( !(ptr = realloc(map->Scale, max * sizeof(double))) ) return(MIDIERRREAD);
+    map->Scale = (double *)ptr;
+
+    map->MaxTempos = max;
+    return(0);
+}
+
+
+
+
+/******************************** tick_micros() *******************************
+ * Returns the number of microseconds per tick at the specified tempo (micros per quarter), for
+ * the MThd's Division. For SMPTE Division, that's fixed by the frame rate (where 29 means 29.97
+ * drop frame) and the tempo doesn't matter.
+ **************************************************************************/
+
+static double tick_micros(USHORT division, ULONG tempo)
+{
+    register double ticks;
+
+    if (division & 0x8000)
+    {
+	ticks = (double)(0x100 - (division >> 8));
+	if (ticks == 29.0) ticks = 29.97;
+	ticks *= (division & 0xFF);
+	return( (ticks != 0.0) ? 1000000.0 / ticks : 0.0 );
+    }
+
+    return( (division) ? (double)tempo / (double)division : 0.0 );
+}
+
+
+
+
+/******************************** find_ticks() ********************************
+ * Returns the index of the last tempo in a MIDITEMPOMAP (with at least 1 tempo) that starts at
+ * or before the time ticks.
+ **************************************************************************/
+
+static ULONG find_ticks(const MIDITEMPOMAP * map, ULONG ticks)
+{
+    register const ULONG * ptr = map->Ticks;
+    register ULONG lo = 1, hi = map->NumTempos, mid;
+
+    /* Ticks[0] is always 0, so it's the answer if nothing after it is */
+    while (lo < hi)
+    {
+	mid = (lo + hi) >> 1;
+	if (ptr[mid] <= ticks)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+
+    return(lo - 1);
+}
+
+
+
+
+/******************************** first_tempo() *******************************
+ * Gives an empty MIDITEMPOMAP its first tempo (120 BPM at time 0) and the MThd's Division.
+ * Returns 0 if success, or MIDIERRREAD if out of memory.
+ **************************************************************************/
+
+static LONG first_tempo(MIDITEMPOMAP * map, USHORT division)
+{
+    LONG result;
+
+    if ( (result = grow_tempos(map, 1)) ) return(result);
+    map->Division = division;
+    map->Ticks[0] = 0;
+    map->Tempo[0] = DEFTEMPO;
+    map->Micros[0] = 0.0;
+    map->Scale[0] = tick_micros(division, DEFTEMPO);
+    map->NumTempos = 1;
+    return(0);
+}
+
+
+
+
+/******************************* MidiAddTempo() *******************************
+ * Adds the Tempo Meta-Event in mf (ie, as passed to an app's MetaTempo callback while reading)
+ * to a MIDITEMPOMAP. An app can call this from its MetaTempo callback to build the tempo map
+ * while reading a file. The event's time is taken from PrevTime, so this works with the
+ * MIDIDELTA Flag too. The tempos don't need to be added in order of time (ie, they can come from
+ * different MTrks), and if 2 are at the same time, the one added later is used. If the map has
+ * no tempos yet, it first gets a 120 BPM tempo at time 0 (ie, what a MIDI file's tempo is until
+ * its first Tempo Meta-Event), and the MIDIFILE's Division is stored. Returns 0 if success, or
+ * MIDIERRREAD if out of memory.
+ **************************************************************************/
+
+LONG EXPENTRY MidiAddTempo(MIDITEMPOMAP * map, METATEMPO * mf)
+{
+    register ULONG n, num;
+    ULONG time = mf->PrevTime;
+    LONG result;
+
+    if (!map->NumTempos)
+    {
+	if ( (result = first_tempo(map, mf->Division)) ) return(result);
+    }
+
+    num = map->NumTempos;
+
+    /* Usually, it's after all of the others. If not, insert it in order */
+    n = (time >= map->Ticks[num - 1]) ? num - 1 : find_ticks(map, time);
+    if (map->Ticks[n] != time)
+    {
+	if ( (result = grow_tempos(map, num + 1)) ) return(result);
+	n++;
+	if (n < num)
+	{
+	    memmove(&map->Ticks[n + 1], &map->Ticks[n], (num - n) * sizeof(ULONG));
+	    memmove(&map->Tempo[n + 1], &map->Tempo[n], (num - n) * sizeof(ULONG));
+	    memmove(&map->Micros[n + 1], &map->Micros[n], (num - n) * sizeof(double));
+	    memmove(&map->Scale[n + 1], &map->Scale[n], (num - n) * sizeof(double));
+	}
+	map->Ticks[n] = time;
+	map->NumTempos = ++num;
+    }
+    map->Tempo[n] = mf->Tempo;
+
+    /* Redo the sums from this tempo on */
+    for (; n < num; n++)
+    {
+	map->Scale[n] = tick_micros(map->Division, map->Tempo[n]);
+	if (n) map->Micros[n] = map->Micros[n - 1] + (double)(map->Ticks[n] - map->Ticks[n - 1]) * map->Scale[n - 1];
+    }
+
+    return(0);
+}
+
+
+
+
+/****************************** add_tempo() ***********************************
+ * The MetaTempo callback of MidiLoadTempoMap().
+ **************************************************************************/
+
+static LONG EXPENTRY add_tempo(METATEMPO * mf)
+{
+    return( MidiAddTempo(((TEMPOREAD *)mf->Callbacks)->map, mf) );
+}
+
+
+
+
+/***************************** MidiLoadTempoMap() ****************************
+ * Reads all of the Tempo Meta-Events of a MIDI file into a MIDITEMPOMAP. The file is opened
+ * just as with MidiReadFile(), using only the file I/O callbacks of the MIDIFILE's CALLBACK.
+ * All other events are skipped without being loaded. The tempos of all MTrks go into the one
+ * map (which is right for Format 0 and 1, where they're all in the first MTrk anyway). A file
+ * with no Tempo Meta-Events gets just the 120 BPM tempo at time 0. Zero the MIDITEMPOMAP before
+ * the first MidiLoadTempoMap(). It can be reused for another file, and MidiFreeTempoMap() frees
+ * its memory. Returns 0 if success, or an error number.
+ **************************************************************************/
+
+LONG EXPENTRY MidiLoadTempoMap(MIDIFILE * mf, MIDITEMPOMAP * map)
+{
+    CALLBACK * cb = mf->Callbacks;
+    ULONG skipevents = mf->SkipEvents;
+    USHORT skipchans = mf->SkipChans;
+    TEMPOREAD read;
+    LONG result;
+
+    memset(&read, 0, sizeof(TEMPOREAD));
+    read.cb.OpenMidi = cb->OpenMidi;
+    read.cb.ReadWriteMidi = cb->ReadWriteMidi;
+    read.cb.SeekMidi = cb->SeekMidi;
+    read.cb.CloseMidi = cb->CloseMidi;
+    read.cb.MetaTempo = (CALL)add_tempo;
+    read.map = map;
+
+    map->NumTempos = 0;
+    mf->Callbacks = &read.cb;
+    mf->SkipEvents = MIDISKIPMIDI|MIDISKIPSYSEX|MIDISKIPESCAPE|MIDISKIPTEXT|MIDISKIPSEQNUM|
+		     MIDISKIPSMPTE|MIDISKIPTIMESIG|MIDISKIPKEYSIG;
+    mf->SkipChans = 0;
+
+    result = MidiReadFile(mf);
+
+    mf->Callbacks = cb;
+    mf->SkipEvents = skipevents;
+    mf->SkipChans = skipchans;
+
+    /* No Tempo Meta-Events? Then it's the default tempo throughout */
+    if ( !result && !map->NumTempos ) result = first_tempo(map, mf->Division);
+
+    return(result);
+}
+
+
+
+
+/***************************** MidiFreeTempoMap() *****************************
+ * Frees the memory of a MIDITEMPOMAP, and zeroes it.
+ **************************************************************************/
+
+VOID EXPENTRY MidiFreeTempoMap(MIDITEMPOMAP * map)
+{
+    free(map->Ticks);
+    free(map->Tempo);
+    free(map->Micros);
+    free(map->Scale);
+    memset(map, 0, sizeof(MIDITEMPOMAP));
+}
+
+
+
+
+/***************************** MidiTicksToMicros() ****************************
+ * Returns the number of microseconds from time 0 to the time ticks (referenced from 0), or 0 if
+ * the MIDITEMPOMAP has no tempos.
+ **************************************************************************/
+
+double EXPENTRY MidiTicksToMicros(const MIDITEMPOMAP * map, ULONG ticks)
+{
+    register ULONG n;
+
+    if (!map->NumTempos) return(0.0);
+    n = find_ticks(map, ticks);
+    return( map->Micros[n] + (double)(ticks - map->Ticks[n]) * map->Scale[n] );
+}
+
+
+
+
+/***************************** MidiMicrosToTicks() ****************************
+ * Returns the time (in ticks, referenced from 0) that is micros microseconds from time 0,
+ * rounded down to a whole tick. That's the inverse of MidiTicksToMicros(). Returns 0 if the
+ * MIDITEMPOMAP has no tempos.
+ **************************************************************************/
+
+ULONG EXPENTRY MidiMicrosToTicks(const MIDITEMPOMAP * map, double micros)
+{
+    register const double * ptr = map->Micros;
+    register ULONG lo = 1, hi = map->NumTempos, mid;
+    double ticks;
+
+    if (!hi || micros <= 0.0) return(0);
+
+    while (lo < hi)
+    {
+	mid = (lo + hi) >> 1;
+	if (ptr[mid] <= micros)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    lo--;
+
+    if (map->Scale[lo] == 0.0) return(map->Ticks[lo]);
+
+    /* Allow a little rounding error, so that converting a tick's micros back gives that tick */
+    ticks = (micros - ptr[lo]) / map->Scale[lo] + 1e-6;
+    if (ticks >= (double)(0xFFFFFFFF - map->Ticks[lo])) return(0xFFFFFFFF);
+    return( map->Ticks[lo] + (ULONG)ticks );
+}
+
+
+
+
+/**************************** MidiTicksToMicrosN() ****************************
+ * Converts count times (in ticks, referenced from 0) at ticks to microseconds at micros, just as
+ * MidiTicksToMicros() would. For times in ascending order (eg, a MIDIEVENTS' Time column, which
+ * is in order within each MTrk), the map is only searched when a time reaches the next tempo (or
+ * goes backwards to a new MTrk), so each time costs just a multiply and an add.
+ **************************************************************************/
+
+VOID EXPENTRY MidiTicksToMicrosN(const MIDITEMPOMAP * map, const ULONG * ticks, double * micros, ULONG count)
+{
+    register ULONG i, lo, span;
+    register double base, scale;
+    ULONG n;
+
+    if (!map->NumTempos)
+    {
+	for (i = 0; i < count; i++) micros[i] = 0.0;
+	return;
+    }
+
+    for (i = 0; i < count; )
+    {
+	n = find_ticks(map, ticks[i]);
+	lo = map->Ticks[n];
+	span = ((n + 1 < map->NumTempos) ? map->Ticks[n + 1] : 0) - 1 - lo;
+	base = map->Micros[n];
+	scale = map->Scale[n];
+
+	/* Every time within this tempo (ie, no more than span ticks after it starts) */
+	do
+	{
+	    micros[i] = base + (double)(ticks[i] - lo) * scale;
+	} while ( ++i < count && ticks[i] - lo <= span );
+    }
+}
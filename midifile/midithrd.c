@@ -0,0 +1,134 @@
+/* ===========================================================================
+ * midithrd.c
+ *
+ * The MIDIFILE engine's worker threads. When the app sets the MIDIPARALLEL Flag, the engine
+ * uses these to work on several MTrks at once.
+ * =========================================================================
+ */
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "midipriv.h"
+
+
+/* Never start more threads than this, however many CPUs there are */
+#define MIDIMAXTHREADS 64
+
+/* What the workers of one MidiParallel() share */
+typedef struct _MIDIJOB
+{
+    pthread_mutex_t Lock;
+    MIDIWORK	    Func;     /* What to do for each item */
+    VOID *	    Arg;      /* Passed to Func */
+    ULONG	    Count;    /* Number of items */
+    ULONG	    Next;     /* Next item that a worker hasn't taken */
+    ULONG	    ErrItem;  /* Lowest item that returned an error */
+    LONG	    Result;   /* And that error */
+} MIDIJOB;
+
+
+
+
+/******************************** MidiNumCPUs() ********************************
+ * Returns how many CPUs are available, and so, how many threads are worth running.
+ **************************************************************************/
+
+ULONG MidiNumCPUs(VOID)
+{
+    long n;
+
+    if ( (n = sysconf(_SC_NPROCESSORS_ONLN)) < 1 ) return(1);
+    return( (n > MIDIMAXTHREADS) ? MIDIMAXTHREADS : (ULONG)n );
+}
+
+
+
+
+/********************************* worker() ***********************************
+ * A worker thread. Takes the next item not yet taken, and does it, until there are none left.
+ * After an error, items past the one that failed aren't started.
+ **************************************************************************/
+
+static VOID * worker(VOID * arg)
+{
+    register MIDIJOB * job = (MIDIJOB *)arg;
+    register ULONG item;
+    LONG result;
+
+    for (;;)
+    {
+	pthread_mutex_lock(&job->Lock);
+	item = job->Next++;
+	if (item >= job->Count || item > job->ErrItem)
+	{
+	    pthread_mutex_unlock(&job->Lock);
+	    return(0);
+	}
+	pthread_mutex_unlock(&job->Lock);
+
+	if ( (result = job->Func(job->Arg, item)) )
+	{
+	    pthread_mutex_lock(&job->Lock);
+	    if (item < job->ErrItem)
+	    {
+		job->ErrItem = item;
+		job->Result = result;
+	    }
+	    pthread_mutex_unlock(&job->Lock);
+	}
+    }
+}
+
+
+
+
+/******************************** MidiParallel() ******************************
+ * Calls func(arg, item) for each item from 0 to count-1, spread over as many threads as there
+ * are CPUs (the calling thread being one of them). Returns 0 if every call returned 0, or else
+ * the error returned for the lowest numbered item that failed (ie, the same error as if the
+ * items had been done one at a time in order).
+ **************************************************************************/
+
+LONG MidiParallel(ULONG count, MIDIWORK func, VOID * arg)
+{
+    pthread_t threads[MIDIMAXTHREADS];
+    register ULONG i, num;
+    MIDIJOB job;
+
+    num = MidiNumCPUs();
+    if (num > count) num = count;
+
+    /* Not worth a thread */
+    if (num < 2)
+    {
+	for (i = 0; i < count; i++)
+	{
+	    if ( (job.Result = func(arg, i)) ) return(job.Result);
+	}
+	return(0);
+    }
+
+    pthread_mutex_init(&job.Lock, 0);
+    job.Func = func;
+    job.Arg = arg;
+    job.Count = count;
+    job.Next = 0;
+    job.ErrItem = count;
+    job.Result = 0;
+
+    /* If a thread can't be started, the ones that are (and this one) just do more items */
+    for (i = 1; i < num; i++)
+    {
+	if ( pthread_create(&threads[i], 0, worker, &job) ) break;
+    }
+    num = i;
+
+    worker(&job);
+
+    for (i = 1; i < num; i++) pthread_join(threads[i], 0);
+
+    pthread_mutex_destroy(&job.Lock);
+
+    return(job.Result);
+}
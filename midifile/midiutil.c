@@ -0,0 +1,289 @@
+/* ===========================================================================
+ * midiutil.c
+ *
+ * Miscellaneous MIDIFILE engine functions that don't touch the file itself (ie, byte order,
+ * chunk ID, and variable length quantity conversions, and error messages).
+ * =========================================================================
+ */
+
+#include <stdint.h>
+#include <string.h>
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "midipriv.h"
+
+
+/* Descriptions of the MIDIERR numbers, for MidiGetErr() */
+static const CHAR * errstrs[] = {
+    "Can't open the MIDI file\r\n",
+    "Can't determine the size of the MIDI file\r\n",
+    "Not a MIDI file (no MThd chunk)\r\n",
+    "Error reading the MIDI file\r\n",
+    "Error writing the MIDI file\r\n",
+    "Bad MIDI file -- it's garbage\r\n",
+    "Running status without a previous Status\r\n",
+    "Unknown Status in an MTrk\r\n",
+};
+
+
+
+
+/******************************** MidiFlipLong() ******************************
+ * Reverses the order of the 4 bytes at ptr (ie, converts a Big Endian ULONG to Intel order, or
+ * vice versa).
+ **************************************************************************/
+
+VOID EXPENTRY MidiFlipLong(UCHAR * ptr)
+{
+    register UCHAR chr;
+
+    chr = ptr[0];
+    ptr[0] = ptr[3];
+    ptr[3] = chr;
+    chr = ptr[1];
+    ptr[1] = ptr[2];
+    ptr[2] = chr;
+}
+
+
+
+
+/******************************** MidiFlipShort() *****************************
+ * Reverses the order of the 2 bytes at ptr.
+ **************************************************************************/
+
+VOID EXPENTRY MidiFlipShort(UCHAR * ptr)
+{
+    register UCHAR chr;
+
+    chr = ptr[0];
+    ptr[0] = ptr[1];
+    ptr[1] = chr;
+}
+
+
+
+
+/******************************* MidiCompareID() ******************************
+ * Compares the 4 byte chunk ID at id with the 4 bytes at ptr. Returns TRUE if they match.
+ **************************************************************************/
+
+BOOL EXPENTRY MidiCompareID(UCHAR * id, UCHAR * ptr)
+{
+    return( id[0] == ptr[0] && id[1] == ptr[1] && id[2] == ptr[2] && id[3] == ptr[3] );
+}
+
+
+
+
+/******************************* MidiVLQToLong() ******************************
+ * Converts the variable length quantity at ptr into a LONG, which is returned. The number of
+ * bytes that the variable length quantity occupied is stored at len.
+ **************************************************************************/
+
+LONG EXPENTRY MidiVLQToLong(UCHAR * ptr, ULONG * len)
+{
+    register ULONG val = 0;
+    register ULONG i = 0;
+    register UCHAR chr;
+
+    do
+    {
+	chr = ptr[i++];
+	val = (val << 7) | (chr & 0x7F);
+    } while ( (chr & 0x80) && i < 4 );
+
+    *len = i;
+    return((LONG)val);
+}
+
+
+
+
+/******************************** vlq_value() ********************************
+ * Returns the value of the len (1 to 4) byte variable length quantity at ptr, without any
+ * branches. The 4 bytes at ptr must be readable, even if the quantity is shorter.
+ **************************************************************************/
+
+static ULONG vlq_value(const UCHAR * ptr, ULONG len)
+{
+    register ULONG val;
+
+    /* Get the bytes as a Big Endian ULONG, dropping any past the end of the quantity */
+    val = ((ULONG)ptr[0] << 24) | ((ULONG)ptr[1] << 16) | ((ULONG)ptr[2] << 8) | ptr[3];
+    val = (val >> ((4 - len) << 3)) & 0x7F7F7F7F;
+
+    /* Squeeze out bit #7 of each byte */
+    return( (val & 0x7F) | ((val >> 1) & 0x3F80) | ((val >> 2) & 0x1FC000) | ((val >> 3) & 0xFE00000) );
+}
+
+
+
+
+/****************************** MidiVLQToLongN() ******************************
+ * Converts up to count variable length quantities, one after another in the size bytes at ptr,
+ * storing their values in vals. The number of bytes that they occupied is stored at len, and the
+ * number converted is returned (ie, less than count if the bytes run out first). Like
+ * MidiVLQToLong(), a quantity ends after 4 bytes even if the 4th has bit #7 set.
+ *	With SSE2 (or AVX2), 16 (or 32) bytes at a time are checked for bit #7. A run of bytes
+ * without it is a run of 1 byte quantities, which are simply widened. Otherwise, the positions
+ * of the bytes without bit #7 (ie, the last byte of each quantity) give the length of each.
+ **************************************************************************/
+
+ULONG EXPENTRY MidiVLQToLongN(UCHAR * ptr, ULONG size, ULONG * vals, ULONG count, ULONG * len)
+{
+    register const UCHAR * src = ptr;
+    register const UCHAR * end = ptr + size;
+    register ULONG n = 0;
+    register ULONG i, l;
+    UCHAR tail[4];
+#if defined(__SSE2__)
+    register ULONG ends, pos;
+    __m128i v, zero = _mm_setzero_si128();
+#endif
+
+#if defined(__AVX2__)
+    /* Runs of 32 1-byte quantities */
+    while (count - n >= 32 && end - src >= 32)
+    {
+	__m256i w = _mm256_loadu_si256((const __m256i *)src);
+	if (_mm256_movemask_epi8(w)) break;
+	_mm256_storeu_si256((__m256i *)&vals[n], _mm256_cvtepu8_epi32(_mm256_castsi256_si128(w)));
+	_mm256_storeu_si256((__m256i *)&vals[n + 8], _mm256_cvtepu8_epi32(_mm_srli_si128(_mm256_castsi256_si128(w), 8)));
+	_mm256_storeu_si256((__m256i *)&vals[n + 16], _mm256_cvtepu8_epi32(_mm256_extracti128_si256(w, 1)));
+	_mm256_storeu_si256((__m256i *)&vals[n + 24], _mm256_cvtepu8_epi32(_mm_srli_si128(_mm256_extracti128_si256(w, 1), 8)));
+	src += 32;
+	n += 32;
+    }
+#endif
+
+#if defined(__SSE2__)
+    while (count - n >= 16 && end - src >= 16)
+    {
+	v = _mm_loadu_si128((const __m128i *)src);
+	ends = ~(ULONG)_mm_movemask_epi8(v) & 0xFFFF;
+
+	/* 16 1-byte quantities */
+	if (ends == 0xFFFF)
+	{
+	    __m128i lo = _mm_unpacklo_epi8(v, zero), hi = _mm_unpackhi_epi8(v, zero);
+	    _mm_storeu_si128((__m128i *)&vals[n], _mm_unpacklo_epi16(lo, zero));
+	    _mm_storeu_si128((__m128i *)&vals[n + 4], _mm_unpackhi_epi16(lo, zero));
+	    _mm_storeu_si128((__m128i *)&vals[n + 8], _mm_unpacklo_epi16(hi, zero));
+	    _mm_storeu_si128((__m128i *)&vals[n + 12], _mm_unpackhi_epi16(hi, zero));
+	    src += 16;
+	    n += 16;
+	    continue;
+	}
+
+	/* Each quantity that ends within these 16 bytes. (All 16 bytes are readable, so
+	    vlq_value() can read past the end of a quantity, as long as it starts within the
+	    first 12) */
+	pos = 0;
+	while (ends && n < count && pos <= 12)
+	{
+	    l = __builtin_ctz(ends) + 1 - pos;
+	    if (l == 1)
+		vals[n++] = src[pos];
+	    else
+	    {
+		if (l > 4) l = 4;
+		vals[n++] = vlq_value(src + pos, l);
+	    }
+	    pos += l;
+	    ends &= ~0U << pos;
+	}
+	if (!pos) break;
+	src += pos;
+    }
+#endif
+
+    /* One at a time, for what's left */
+    while (n < count && src < end)
+    {
+	/* Find the length. Stop if the quantity runs past the end of the bytes */
+	for (l = 1; l < 4 && (src[l - 1] & 0x80) && src + l < end; l++);
+	if ( (src[l - 1] & 0x80) && l < 4 ) break;
+
+	/* Near the end, copy the bytes so that vlq_value() doesn't read past them */
+	if (end - src < 4)
+	{
+	    for (i = 0; i < 4; i++) tail[i] = (src + i < end) ? src[i] : 0;
+	    vals[n++] = vlq_value(&tail[0], l);
+	}
+	else
+	    vals[n++] = vlq_value(src, l);
+	src += l;
+    }
+
+    *len = src - ptr;
+    return(n);
+}
+
+
+
+
+/******************************* MidiLongToVLQ() ******************************
+ * Converts val into a variable length quantity stored at ptr (which must have room for 4 bytes,
+ * although only the quantity's own bytes are stored). Returns the number of bytes stored. A val
+ * over MIDIVLQMAX doesn't fit in the 4 bytes that a reader accepts, so it's clamped to that (the
+ * engine's own writes return an error for such a val rather than get here). Other than for a
+ * 1 byte quantity, the only branches are in storing the bytes.
+ **************************************************************************/
+
+ULONG EXPENTRY MidiLongToVLQ(ULONG val, UCHAR * ptr)
+{
+    register uint64_t bits;
+    register ULONG len, i;
+
+    /* Most delta-times (and lengths) are 1 byte, and a predictable branch beats the rest */
+    if (val < 0x80)
+    {
+	*ptr = (UCHAR)val;
+	return(1);
+    }
+
+    if (val > MIDIVLQMAX) val = MIDIVLQMAX;
+
+    /* How many 7-bit groups it needs */
+    len = 2 + (val >= (1UL << 14)) + (val >= (1UL << 21));
+
+    /* Spread the 7-bit groups into separate bytes, with bit #7 set on all but the lowest */
+    bits = (uint64_t)(val & 0x7F) | ((uint64_t)(val & 0x3F80) << 1) | ((uint64_t)(val & 0x1FC000) << 2) |
+	   ((uint64_t)(val & 0xFE00000) << 3);
+    bits |= 0x80808000ULL & ((1ULL << (len << 3)) - 1);
+
+    /* Store the highest group first, and so on, ending with the lowest */
+    for (i = len; i--; bits >>= 8) ptr[i] = (UCHAR)bits;
+
+    return(len);
+}
+
+
+
+
+/********************************* MidiGetErr() *******************************
+ * Copies a null-terminated description of err to buf, and returns its length. For 0, this is a
+ * message of a successful load or save (depending upon the MIDIWRITE Flag). For an error number
+ * that isn't one of ours (ie, a callback's error), buf is nulled and 0 returned.
+ **************************************************************************/
+
+ULONG EXPENTRY MidiGetErr(MIDIFILE * mf, LONG err, UCHAR * buf)
+{
+    register const CHAR * str;
+
+    if (!err)
+	str = (mf->Flags & MIDIWRITE) ? "Successful MIDI file save\r\n" : "Successful MIDI file load\r\n";
+    else if (err >= MIDIERRFILE && err < MIDIAPPERR)
+	str = errstrs[err - MIDIERRFILE];
+    else
+    {
+	*buf = 0;
+	return(0);
+    }
+
+    strcpy((char *)buf, str);
+    return(strlen(str));
+}
@@ -0,0 +1,234 @@
+/* ===========================================================================
+ * readbench.c
+ *
+ * Times reading a MIDI file with MIDIFILE.DLL callbacks (MidiReadFile()) against pulling its
+ * events with MidiNextEvent(). Both tally the same things about the events, and the tallies are
+ * checked against each other. The file is mapped into memory (MIDIMMAP) both ways, so it's the
+ * parsing and the calling, rather than the disk, that's timed.
+ * =========================================================================
+ */
+
+#ifdef __OS2__
+#include <os2.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "midifile.h"
+
+
+/* What's tallied about the events: how many, a sum of their times and MIDI data bytes, and a
+    sum of the data bytes of SYSEX and variable length Meta-Events */
+typedef struct _TALLY
+{
+    ULONG Events;
+    ULONG Sum;
+    ULONG DataSum;
+} TALLY;
+
+/* The callbacks have to keep their tally in a global */
+TALLY cbtally;
+
+CALLBACK cb;
+
+
+
+
+/********************************** seconds() ********************************
+ * Returns the time in seconds, for timing the tests.
+ **************************************************************************/
+
+double seconds(VOID)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return(ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+
+
+
+/******************************** add_data() *********************************
+ * Adds count data bytes at ptr to a tally.
+ **************************************************************************/
+
+VOID add_data(TALLY * tally, const UCHAR * ptr, ULONG count)
+{
+    while (count--) tally->DataSum += *(ptr)++;
+}
+
+
+
+
+/***************************** The callbacks *********************************
+ * standardEvt() gets MIDI events, sysexEvt() SYSEX, metaText() variable length Meta-Events,
+ * and metaOther() all other Meta-Events.
+ **************************************************************************/
+
+LONG EXPENTRY standardEvt(MIDIFILE * mf)
+{
+    cbtally.Events++;
+    cbtally.Sum += mf->Time + mf->Status + mf->Data[0] + mf->Data[1];
+    return(0);
+}
+
+LONG EXPENTRY sysexEvt(MIDIFILE * mf)
+{
+    ULONG len = mf->EventSize;
+    UCHAR * ptr;
+
+    cbtally.Events++;
+    cbtally.Sum += mf->Time + mf->Status;
+    if ( len && (ptr = MidiReadBytesView(mf, len)) ) add_data(&cbtally, ptr, len);
+    return(0);
+}
+
+LONG EXPENTRY metaText(METATXT * mf)
+{
+    ULONG len = mf->EventSize;
+    UCHAR * ptr;
+
+    cbtally.Events++;
+    cbtally.Sum += mf->Time + 0xFF;
+    if ( len && (ptr = MidiReadBytesView((MIDIFILE *)mf, len)) ) add_data(&cbtally, ptr, len);
+    return(0);
+}
+
+LONG EXPENTRY metaOther(MIDIFILE * mf)
+{
+    cbtally.Events++;
+    cbtally.Sum += mf->Time + 0xFF;
+    return(0);
+}
+
+
+
+
+/******************************* read_callbacks() *****************************
+ * Reads the file with MidiReadFile(). Returns 0 if success, or an error number.
+ **************************************************************************/
+
+LONG read_callbacks(CHAR * fn, TALLY * tally)
+{
+    MIDIFILE mf;
+    LONG result;
+
+    memset(&cbtally, 0, sizeof(TALLY));
+    memset(&mf, 0, sizeof(MIDIFILE));
+    mf.Callbacks = &cb;
+    mf.Handle = (MIDIHANDLE)fn;
+    mf.Flags = MIDIMMAP;
+    result = MidiReadFile(&mf);
+    *tally = cbtally;
+    return(result);
+}
+
+
+
+
+/******************************* read_iterator() ******************************
+ * Reads the file with MidiNextEvent(). Returns 0 if success, or an error number.
+ **************************************************************************/
+
+LONG read_iterator(CHAR * fn, TALLY * tally)
+{
+    CALLBACK none;
+    MIDIFILE mf;
+    MIDIREADER rdr;
+    MIDIEVENT evt;
+    LONG result;
+
+    memset(tally, 0, sizeof(TALLY));
+    memset(&none, 0, sizeof(CALLBACK));
+    memset(&mf, 0, sizeof(MIDIFILE));
+    memset(&rdr, 0, sizeof(MIDIREADER));
+    mf.Callbacks = &none;
+    mf.Handle = (MIDIHANDLE)fn;
+    mf.Flags = MIDIMMAP;
+    rdr.MidiFile = &mf;
+
+    if ( (result = MidiOpenReader(&rdr)) ) return(result);
+
+    while ( !(result = MidiNextEvent(&rdr, &evt)) )
+    {
+	tally->Events++;
+	if (evt.Status < 0xF0)
+	    tally->Sum += evt.Time + evt.Status + evt.Data1 + evt.Data2;
+	else
+	{
+	    tally->Sum += evt.Time + evt.Status;
+
+	    /* The callbacks get the data of SYSEX, and of Meta-Events that aren't the fixed length
+		kinds (or have the wrong length for one) */
+	    if ( evt.Status != 0xFF ||
+		 !((evt.Data1 == 0x00 && evt.Length == 2) || (evt.Data1 == 0x2F && !evt.Length) ||
+		   (evt.Data1 == 0x51 && evt.Length == 3) || (evt.Data1 == 0x54 && evt.Length == 5) ||
+		   (evt.Data1 == 0x58 && evt.Length == 4) || (evt.Data1 == 0x59 && evt.Length == 2)) )
+		add_data(tally, evt.Payload, evt.Length);
+	}
+    }
+
+    MidiCloseReader(&rdr);
+    return( (result == -1) ? 0 : result );
+}
+
+
+
+
+/*********************************** main() ***********************************
+ * Program entry point. Reads the file each way, the specified number of times, and prints the
+ * time per event.
+ ****************************************************************************/
+
+int main(int argc, char *argv[], char *envp[])
+{
+    TALLY cbt, itt;
+    ULONG i, repeats;
+    double start, cbtime, ittime;
+    LONG result;
+    UCHAR buf[60];
+
+    if ( argc < 2 )
+    {
+	 printf("This program times reading a MIDI file with callbacks, and\r\n");
+	 printf("with MidiNextEvent(). It requires MIDIFILE.DLL to run.\r\n\r\n");
+	 printf("Syntax: READBENCH.EXE [filename] [repeats]\r\n");
+	 exit(1);
+    }
+    repeats = (argc > 2) ? (ULONG)strtoul(argv[2], 0, 10) : 100;
+    if (!repeats) repeats = 1;
+
+    cb.StandardEvt = (CALL)standardEvt;
+    cb.SysexEvt = (CALL)sysexEvt;
+    cb.MetaText = (CALL)metaText;
+    cb.MetaSeqNum = cb.MetaTempo = cb.MetaSMPTE = cb.MetaTimeSig = cb.MetaKeySig = cb.MetaEOT = (CALL)metaOther;
+
+    start = seconds();
+    for (i = 0; i < repeats; i++)
+    {
+	if ( (result = read_callbacks(argv[1], &cbt)) ) goto bad;
+    }
+    cbtime = seconds() - start;
+
+    start = seconds();
+    for (i = 0; i < repeats; i++)
+    {
+	if ( (result = read_iterator(argv[1], &itt)) ) goto bad;
+    }
+    ittime = seconds() - start;
+
+    if ( memcmp(&cbt, &itt, sizeof(TALLY)) ) printf("The callbacks and MidiNextEvent() disagree!\r\n");
+
+    printf("%lu events: callbacks %7.2f ns/event, MidiNextEvent %7.2f ns/event (%.2fx)\r\n",
+	(unsigned long)cbt.Events, cbtime * 1e9 / (cbt.Events * (double)repeats),
+	ittime * 1e9 / (itt.Events * (double)repeats), cbtime / ittime);
+    exit(0);
+
+bad:
+    MidiGetErr(0, result, &buf[0]);
+    printf("%s", (char *)&buf[0]);
+    exit(1);
+}
@@ -0,0 +1,62 @@
+/* ===========================================================================
+ * mftarena.c
+ *
+ * mftest's check of the MIDIARENA.
+ * =========================================================================
+ */
+
+#include "mftest.h"
+
+
+
+
+/******************************** check_arena() ********************************
+ * Reads the song with a MIDIARENA, with and without MIDIMMAP. Each must get what MidiReadFile()
+ * gets. Also checks that each piece MidiArenaAlloc() gives is aligned for a double, however odd
+ * the sizes before it.
+ **************************************************************************/
+
+ULONG check_arena(VOID)
+{
+    MIDIARENA arena;
+    LOG ref, got;
+    UCHAR * buf;
+    ULONG i;
+    ULONG errs = 0;
+    LONG result;
+
+    memset(&arena, 0, sizeof(MIDIARENA));
+    memset(&ref, 0, sizeof(LOG));
+    memset(&got, 0, sizeof(LOG));
+
+    if ( (result = write_song("mftest_arena.mid", 0, FALSE)) )
+	return( fail("arena", "write failed", result) );
+    if ( (result = read_log("mftest_arena.mid", &ref, 0, 0)) )
+	return( fail("arena", "MidiReadFile() failed", result) );
+
+    arena.BlockSize = 1000;
+    if ( (result = read_log("mftest_arena.mid", &got, 0, &arena)) )
+	errs += fail("arena", "MIDIARENA read failed", result);
+    else
+	errs += compare_logs("arena", "MIDIARENA", &got, &ref, 0);
+
+    if ( (result = read_log("mftest_arena.mid", &got, MIDIMMAP, &arena)) )
+	errs += fail("arena", "MIDIMMAP and MIDIARENA read failed", result);
+    else
+	errs += compare_logs("arena", "MIDIMMAP and MIDIARENA", &got, &ref, 0);
+
+    for (i = 1; i < 40; i++)
+    {
+	if ( !(buf = MidiArenaAlloc(&arena, i)) || ((size_t)buf & (sizeof(double) - 1)) )
+	{
+	    errs += fail("arena", "MidiArenaAlloc() memory isn't aligned", 0);
+	    break;
+	}
+    }
+    MidiFreeArena(&arena);
+
+    free_log(&ref);
+    free_log(&got);
+    if (!errs) remove("mftest_arena.mid");
+    return(errs);
+}
@@ -0,0 +1,188 @@
+/* ===========================================================================
+ * mftconv.c
+ *
+ * mftest's checks of MidiConvertFile() and MidiCompactFile().
+ * =========================================================================
+ */
+
+#include "mftest.h"
+
+
+
+
+/******************************* check_convert() *******************************
+ * Converts the song to Format 0 with MidiConvertFile(), which must have the same events in the
+ * same order as MidiReadMerged() gets (other than the End Of Tracks). Then converts that back
+ * to Format 1, which must have the same events (but in different MTrks). A Format 2 can't be
+ * converted, and mustn't touch the file it would have been written to.
+ **************************************************************************/
+
+ULONG check_convert(VOID)
+{
+    static const UCHAR format2[] = { 'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 2, 0, 1, 0, 96,
+				     'M', 'T', 'r', 'k', 0, 0, 0, 4, 0, 0xFF, 0x2F, 0 };
+    TESTFILE in, out;
+    LOG merged, conv;
+    UCHAR * before;
+    UCHAR * after;
+    ULONG size, size2;
+    ULONG errs = 0;
+    LONG result;
+
+    memset(&merged, 0, sizeof(LOG));
+    memset(&conv, 0, sizeof(LOG));
+    memset(&in, 0, sizeof(TESTFILE));
+    memset(&out, 0, sizeof(TESTFILE));
+
+    if ( (result = write_song("mftest_convert.mid", 0, FALSE)) )
+	return( fail("convert", "write failed", result) );
+
+    init_file(&in, "mftest_convert.mid", &merged);
+    if ( (result = MidiReadMerged(&in.mf)) ) return( fail("convert", "MidiReadMerged() failed", result) );
+
+    init_file(&in, "mftest_convert.mid", 0);
+    init_file(&out, "mftest_convert0.mid", 0);
+    if ( (result = MidiConvertFile(&in.mf, &out.mf, 0)) )
+	return( fail("convert", "conversion to Format 0 failed", result) );
+    init_file(&in, "mftest_convert0.mid", &conv);
+    if ( (result = MidiReadFile(&in.mf)) ) return( fail("convert", "reading the Format 0 failed", result) );
+    if (in.mf.Format != 0 || in.mf.NumTracks != 1) errs += fail("convert", "conversion isn't a Format 0", 0);
+    errs += compare_logs("convert", "Format 0 vs MidiReadMerged()", &conv, &merged, NOCHUNKS|NOTRACK|NOEOT);
+
+    /* And back to Format 1, with an MTrk per MIDI channel (9 of them) after the tempo MTrk */
+    init_file(&in, "mftest_convert0.mid", 0);
+    init_file(&out, "mftest_convert1.mid", 0);
+    if ( (result = MidiConvertFile(&in.mf, &out.mf, 1)) )
+	return( fail("convert", "conversion to Format 1 failed", result) );
+    init_file(&in, "mftest_convert1.mid", &merged);
+    if ( (result = MidiReadMerged(&in.mf)) ) return( fail("convert", "reading the Format 1 failed", result) );
+    if (in.mf.Format != 1 || in.mf.NumTracks != 1 + (NUMTRKS - 1) * 3)
+	errs += fail("convert", "conversion isn't a Format 1 with an MTrk per channel", 0);
+    sort_log(&merged);
+    sort_log(&conv);
+    errs += compare_logs("convert", "Format 1 vs Format 0", &merged, &conv, NOCHUNKS|NOTRACK|NOEOT);
+
+    init_file(&in, "mftest_convert.mid", 0);
+    init_file(&out, "mftest_convert2.mid", 0);
+    if ( (result = MidiConvertFile(&in.mf, &out.mf, 2)) != MIDIERRBAD )
+	errs += fail("convert", "conversion to Format 2 isn't MIDIERRBAD", result);
+
+    /* The Format 0 from before is the out that must be left alone */
+    if ( !save_bytes("mftest_format2.mid", &format2[0], sizeof(format2)) )
+	return( fail("convert", "can't write mftest_format2.mid", 0) );
+    before = load_bytes("mftest_convert0.mid", &size);
+    init_file(&in, "mftest_format2.mid", 0);
+    init_file(&out, "mftest_convert0.mid", 0);
+    if ( (result = MidiConvertFile(&in.mf, &out.mf, 0)) != MIDIERRBAD )
+	errs += fail("convert", "conversion of a Format 2 isn't MIDIERRBAD", result);
+    after = load_bytes("mftest_convert0.mid", &size2);
+    if ( !before || !after || size != size2 || memcmp(before, after, size) )
+	errs += fail("convert", "conversion of a Format 2 changed out", 0);
+    free(before);
+    free(after);
+
+    done_file(&in);
+    free_log(&merged);
+    free_log(&conv);
+    if (!errs)
+    {
+	remove("mftest_convert.mid");
+	remove("mftest_convert0.mid");
+	remove("mftest_convert1.mid");
+	remove("mftest_format2.mid");
+    }
+    return(errs);
+}
+
+
+
+
+/******************************** check_compact() ******************************
+ * Compacts the song with MidiCompactFile(). With no MIDICOMPACT Flags, it must read back just
+ * as it was. With all of them, every Note Off must be rewritten, and the SYSEX must be the same
+ * once put back together.
+ **************************************************************************/
+
+ULONG check_compact(VOID)
+{
+    register const REC * rec;
+    MIDICOMPACT stats;
+    MIDIARENA arena;
+    TESTFILE in, out;
+    LOG ref, got, whole, expect;
+    ULONG noteoffs;
+    ULONG errs = 0;
+    LONG result;
+
+    memset(&ref, 0, sizeof(LOG));
+    memset(&got, 0, sizeof(LOG));
+    memset(&whole, 0, sizeof(LOG));
+    memset(&expect, 0, sizeof(LOG));
+    memset(&in, 0, sizeof(TESTFILE));
+    memset(&out, 0, sizeof(TESTFILE));
+    memset(&arena, 0, sizeof(MIDIARENA));
+
+    if ( (result = write_song("mftest_compact.mid", 0, FALSE)) )
+	return( fail("compact", "write failed", result) );
+    if ( (result = read_log("mftest_compact.mid", &ref, 0, 0)) )
+	return( fail("compact", "MidiReadFile() failed", result) );
+
+    init_file(&in, "mftest_compact.mid", 0);
+    init_file(&out, "mftest_compact1.mid", 0);
+    memset(&stats, 0, sizeof(MIDICOMPACT));
+    if ( (result = MidiCompactFile(&in.mf, &out.mf, &stats)) )
+	errs += fail("compact", "MidiCompactFile() failed", result);
+    else if ( (result = read_log("mftest_compact1.mid", &got, 0, 0)) )
+	errs += fail("compact", "reading the compacted file failed", result);
+    else
+    {
+	if (stats.OutSize > stats.InSize) errs += fail("compact", "the compacted file is bigger", 0);
+	errs += compare_logs("compact", "MidiCompactFile()", &got, &ref, 0);
+    }
+
+    /* Everything. Only the SYSEX are compared, once put back together */
+    noteoffs = 0;
+    for (rec = &ref.Recs[0]; rec < &ref.Recs[ref.Num]; rec++)
+    {
+	if ( (rec->Status & 0xF0) == 0x80 ) noteoffs++;
+    }
+    whole_log(&whole, &ref);
+    for (rec = &whole.Recs[0]; rec < &whole.Recs[whole.Num]; rec++)
+    {
+	if ( !skip_event(rec, MIDISKIPMIDI, 0) ) copy_rec(&expect, &whole, rec);
+    }
+
+    init_file(&in, "mftest_compact.mid", 0);
+    init_file(&out, "mftest_compact2.mid", 0);
+    memset(&stats, 0, sizeof(MIDICOMPACT));
+    stats.Flags = MIDICOMPACTALL;
+    if ( (result = MidiCompactFile(&in.mf, &out.mf, &stats)) )
+	errs += fail("compact", "MidiCompactFile() with MIDICOMPACTALL failed", result);
+    else
+    {
+	if (stats.NoteOffs != noteoffs || !stats.Packets || stats.OutSize >= stats.InSize)
+	    errs += fail("compact", "MidiCompactFile() with MIDICOMPACTALL didn't do everything", 0);
+	init_file(&in, "mftest_compact2.mid", &got);
+	in.mf.SkipEvents = MIDISKIPMIDI;
+	in.mf.Flags = MIDIWHOLESYSEX;
+	in.mf.Arena = &arena;
+	if ( (result = MidiReadFile(&in.mf)) )
+	    errs += fail("compact", "reading the MIDICOMPACTALL file failed", result);
+	else
+	    errs += compare_logs("compact", "MidiCompactFile() with MIDICOMPACTALL", &got, &expect, 0);
+	MidiFreeArena(&arena);
+    }
+
+    done_file(&in);
+    free_log(&ref);
+    free_log(&got);
+    free_log(&whole);
+    free_log(&expect);
+    if (!errs)
+    {
+	remove("mftest_compact.mid");
+	remove("mftest_compact1.mid");
+	remove("mftest_compact2.mid");
+    }
+    return(errs);
+}
@@ -0,0 +1,1129 @@
+/* ===========================================================================
+ * mftest.c
+ *
+ * The MIDIFILE engine's regression tests, run by CTest. Makes up a song (a Format 1 with a tempo
+ * MTrk and several MTrks of MIDI events, SYSEX in one piece and in packets, ESCAPEs, text of all
+ * lengths, and chunks other than MTrks), writes it every way that the engine can, and reads it
+ * back every way that the engine can. Each way of reading is compared against what
+ * MidiReadFile() gets, and MidiReadFile() against the song itself. This file has the song, the
+ * LOGs, the callbacks, and main(). The checks for each part of the engine are in an mft*.c file
+ * of their own.
+ *
+ * Syntax: mftest [check]
+ *
+ * Runs just the named check (see Checks below), or all of them. The files go in the current
+ * directory, each check's named after it, so that checks may run at the same time. Exits with 0
+ * if every check passed, or 1 if any failed (after printing what differed).
+ * =========================================================================
+ */
+
+#include "mftest.h"
+
+
+/* One of the checks */
+typedef struct _CHECK
+{
+    const CHAR * Name;
+    ULONG (*Func)(VOID);
+} CHECK;
+
+/* The callbacks for writing, and reading. Shared by all of the TESTFILEs */
+CALLBACK wcb, rcb;
+
+/* The song */
+SONG Song;
+BOOL SongMade;
+
+/* For the made up song */
+ULONG Seed = 12345;
+
+/* The LOG that sort_log() is sorting */
+const LOG * SortLog;
+
+
+
+
+/********************************** fail() ***********************************
+ * Reports a check's failure, and returns 1 (ie, for adding to the check's count of failures).
+ **************************************************************************/
+
+ULONG fail(const CHAR * check, const CHAR * what, LONG result)
+{
+    if (result)
+	printf("%s: %s (error %ld)\r\n", check, what, (long)result);
+    else
+	printf("%s: %s\r\n", check, what);
+    return(1);
+}
+
+
+
+
+/******************************** need_mem() *********************************
+ * Returns ptr, or if that's 0 (ie, an allocation failed), gives up on all of the checks.
+ **************************************************************************/
+
+VOID * need_mem(VOID * ptr)
+{
+    if (!ptr)
+    {
+	printf("Out of memory\r\n");
+	exit(1);
+    }
+    return(ptr);
+}
+
+
+
+
+/*********************************** rnd() ***********************************
+ * Returns a made up number from 0 to num - 1. Always the same sequence, so that the song is
+ * too.
+ **************************************************************************/
+
+ULONG rnd(ULONG num)
+{
+    Seed = Seed * 1103515245 + 12345;
+    return( (Seed >> 8) % num );
+}
+
+
+
+
+/********************************* add_evt() *********************************
+ * Appends a MIDIEVT with the specified time and Status to MTrk trk of the song, and returns it
+ * (with its other fields zeroed).
+ **************************************************************************/
+
+MIDIEVT * add_evt(ULONG trk, ULONG time, UCHAR status)
+{
+    register MIDIEVT * evt = &Song.Evts[trk][Song.NumEvts[trk]++];
+
+    memset(evt, 0, sizeof(MIDIEVT));
+    evt->Time = time;
+    evt->Status = status;
+    return(evt);
+}
+
+VOID add_sysex(ULONG trk, ULONG time, UCHAR status, UCHAR index)
+{
+    register MIDIXEVT * evt = (MIDIXEVT *)add_evt(trk, time, status);
+
+    evt->Index = index;
+    evt->Length = Song.Lens[index];
+}
+
+VOID add_text(ULONG trk, ULONG time, UCHAR type, USHORT index)
+{
+    register MIDITXTEVT * evt = (MIDITXTEVT *)add_evt(trk, time, type);
+
+    evt->Index = index;
+    evt->Length = (UCHAR)Song.Lens[index];
+}
+
+/* An ESCAPE of a REALTIME or SYSTEM COMMON message */
+VOID add_escape(ULONG trk, ULONG time)
+{
+    static const UCHAR escapes[] = {0xF8, 0xFA, 0xFC, 0xFE, 0xF1, 0xF2, 0xF3, 0xF6};
+    register MIDIEVT * evt = add_evt(trk, time, escapes[rnd(sizeof(escapes))]);
+
+    evt->Data1 = (UCHAR)rnd(128);
+    evt->Data2 = (UCHAR)rnd(128);
+}
+
+
+
+
+/******************************** make_payload() *******************************
+ * Makes up payload num of the song, of len bytes, each from 0 to max. If last isn't 0, that's
+ * the last byte instead.
+ **************************************************************************/
+
+VOID make_payload(ULONG num, ULONG len, UCHAR max, UCHAR last)
+{
+    register UCHAR * ptr;
+    register ULONG i;
+
+    Song.Payloads[num] = ptr = (UCHAR *)need_mem(malloc(len + 1));
+    Song.Lens[num] = (USHORT)len;
+    for (i = 0; i < len; i++) ptr[i] = (UCHAR)(rnd(max) + ((max == 0x5F) ? 0x20 : 0));
+    if (len && last) ptr[len - 1] = last;
+}
+
+
+
+
+/********************************* make_song() *********************************
+ * Makes up the song (once). The tempo MTrk has the Sequence Number, SMPTE Offset, and Tempo,
+ * Time Signature, Key Signature, and text Meta-Events. The other MTrks have MIDI events on 3
+ * MIDI channels each, with some SYSEX (whole, or in packets, perhaps with an ESCAPE between
+ * them), ESCAPEs, and text. Now and then, there's a long gap between events.
+ **************************************************************************/
+
+VOID make_song(VOID)
+{
+    register MIDIEVT * evt;
+    register ULONG trk, time, n, r;
+
+    if (SongMade) return;
+    SongMade = TRUE;
+
+    /* The SYSEX. One's bigger than the engine's buffers */
+    for (n = 0; n < PAYFIRST - PAYWHOLE; n++)
+    {
+	make_payload(PAYWHOLE + n, (n) ? 2 + rnd(300) : 40000, 0x7F, 0xF7);
+	make_payload(PAYFIRST + n, 1 + rnd(100), 0x7F, 0);
+	make_payload(PAYMIDDLE + n, 1 + rnd(100), 0x7F, 0);
+	make_payload(PAYLAST + n, 1 + rnd(100), 0x7F, 0xF7);
+    }
+
+    /* The text, from empty to as long as a MIDITXTEVT allows */
+    for (n = 0; n < NUMTEXT; n++) make_payload(PAYTEXT + n, (n < 2) ? n * 255 : rnd(256), 0x5F, 0);
+
+    make_payload(PAYSMPTE, 5, 24, 0);
+
+    for (trk = 0; trk < NUMTRKS; trk++)
+    {
+	time = 0;
+	Song.NumEvts[trk] = 0;
+
+	if (!trk)
+	{
+	    ((MIDISEQEVT *)add_evt(0, 0, 0x00))->SeqNum = 0x1234;
+	    add_text(0, 0, 0x54, PAYSMPTE);
+	    ((MIDITEMPOEVT *)add_evt(0, 0, 0x51))->BPM = 120;
+	    evt = add_evt(0, 0, 0x58);
+	    ((MIDITIMEEVT *)evt)->Nom = 4;
+	    ((MIDITIMEEVT *)evt)->Denom = 2;
+	    ((MIDITIMEEVT *)evt)->Clocks = 24;
+	    add_text(0, 0, 0x03, PAYTEXT + 1);
+	}
+
+	while (Song.NumEvts[trk] < NUMEVENTS)
+	{
+	    /* Tempos in the same MTrk at the same time would leave it up to the engine which is
+		used, so the tempo MTrk's events are always at least 1 tick apart */
+	    if ( !rnd(50) )
+		time += 10000 + rnd(300000);
+	    else
+		time += ( (trk) ? 0 : 1 ) + rnd(60);
+
+	    r = rnd(100);
+	    if (!trk)
+	    {
+		if (r < 40)
+		    ((MIDITEMPOEVT *)add_evt(0, time, 0x51))->BPM = (UCHAR)(30 + rnd(200));
+		else if (r < 60)
+		{
+		    evt = add_evt(0, time, 0x58);
+		    ((MIDITIMEEVT *)evt)->Nom = (UCHAR)(1 + rnd(12));
+		    ((MIDITIMEEVT *)evt)->Denom = (UCHAR)rnd(6);
+		    ((MIDITIMEEVT *)evt)->Clocks = 24;
+		}
+		else if (r < 75)
+		{
+		    evt = add_evt(0, time, 0x59);
+		    ((MIDIKEYEVT *)evt)->Key = (UCHAR)((LONG)rnd(15) - 7);
+		    ((MIDIKEYEVT *)evt)->Minor = (UCHAR)rnd(2);
+		}
+		else
+		    add_text(0, time, (UCHAR)(1 + rnd(7)), (USHORT)(PAYTEXT + rnd(NUMTEXT)));
+	    }
+	    else if (r < 80)
+	    {
+		evt = add_evt(trk, time, (UCHAR)((0x80 + (rnd(7) << 4)) | ((trk - 1) * 3 + rnd(3))));
+		evt->Data1 = (UCHAR)rnd(128);
+		evt->Data2 = (UCHAR)rnd(128);
+	    }
+	    else if (r < 84)
+		add_sysex(trk, time, 0xF0, (UCHAR)(PAYWHOLE + rnd(PAYFIRST - PAYWHOLE)));
+	    else if (r < 87)
+	    {
+		/* A SYSEX in packets, all at the same time */
+		add_sysex(trk, time, 0xF0, (UCHAR)(PAYFIRST + rnd(50)));
+		for (n = rnd(3); n; n--)
+		{
+		    if ( !rnd(4) ) add_escape(trk, time);
+		    add_sysex(trk, time, 0xF7, (UCHAR)(PAYMIDDLE + rnd(50)));
+		}
+		if ( !rnd(4) ) add_escape(trk, time);
+		add_sysex(trk, time, 0xF7, (UCHAR)(PAYLAST + rnd(50)));
+	    }
+	    else if (r < 92)
+		add_escape(trk, time);
+	    else
+		add_text(trk, time, (UCHAR)((r < 96) ? 1 + rnd(7) : 0x7F), (USHORT)(PAYTEXT + rnd(NUMTEXT)));
+	}
+
+	add_evt(trk, time + rnd(100), 0x2F);
+    }
+}
+
+
+
+
+/********************************* add_rec() **********************************
+ * Appends an event to a LOG. ptr is its len data bytes.
+ **************************************************************************/
+
+VOID add_rec(LOG * log, ULONG time, UCHAR track, UCHAR status, UCHAR data1, UCHAR data2, UCHAR chase,
+	     const UCHAR * ptr, ULONG len)
+{
+    register REC * rec;
+
+    if (log->Num >= log->Max)
+    {
+	log->Max = (log->Max) ? log->Max << 1 : 4096;
+	log->Recs = (REC *)need_mem(realloc(log->Recs, log->Max * sizeof(REC)));
+    }
+    if (log->Size + len > log->MaxSize)
+    {
+	log->MaxSize = (log->Size + len) << 1;
+	log->Bytes = (UCHAR *)need_mem(realloc(log->Bytes, log->MaxSize));
+    }
+
+    rec = &log->Recs[log->Num++];
+    rec->Time = time;
+    rec->Track = track;
+    rec->Status = status;
+    rec->Data1 = data1;
+    rec->Data2 = data2;
+    rec->Chase = chase;
+    rec->Len = len;
+    rec->Offset = log->Size;
+    if (len) memcpy(&log->Bytes[log->Size], ptr, len);
+    log->Size += len;
+}
+
+/* Appends a copy of another LOG's event */
+VOID copy_rec(LOG * log, const LOG * from, const REC * rec)
+{
+    add_rec(log, rec->Time, rec->Track, rec->Status, rec->Data1, rec->Data2, rec->Chase,
+	    &from->Bytes[rec->Offset], rec->Len);
+}
+
+VOID free_log(LOG * log)
+{
+    free(log->Recs);
+    free(log->Bytes);
+    memset(log, 0, sizeof(LOG));
+}
+
+
+
+
+/********************************* song_log() *********************************
+ * Fills in a LOG with what reading the song should get.
+ **************************************************************************/
+
+VOID song_log(LOG * log)
+{
+    register const MIDIEVT * evt;
+    register ULONG trk, i, len;
+    register UCHAR status;
+    const UCHAR * ptr;
+    UCHAR buf[XTRASIZE + 4];
+    ULONG val;
+
+    make_song();
+    log->Num = log->Size = 0;
+
+    for (trk = 0; trk < NUMTRKS; trk++)
+    {
+	for (i = 0; i < Song.NumEvts[trk]; i++)
+	{
+	    evt = &Song.Evts[trk][i];
+	    status = evt->Status;
+	    ptr = &buf[0];
+	    len = 0;
+
+	    if (status >= 0x80 && status < 0xF0)
+	    {
+		add_rec(log, evt->Time, (UCHAR)trk, status, evt->Data1,
+			((status & 0xE0) == 0xC0) ? 0xFF : evt->Data2, 0, 0, 0);
+		continue;
+	    }
+
+	    if (status == 0xF0 || status == 0xF7)
+	    {
+		add_rec(log, evt->Time, (UCHAR)trk, status, 0, 0, 0,
+			Song.Payloads[((const MIDIXEVT *)evt)->Index], ((const MIDIXEVT *)evt)->Length);
+		continue;
+	    }
+
+	    /* An ESCAPE reads back as its MIDI message */
+	    if (status >= 0x80)
+	    {
+		buf[0] = status;
+		buf[1] = evt->Data1;
+		buf[2] = evt->Data2;
+		len = (status == 0xF2) ? 3 : (status == 0xF1 || status == 0xF3) ? 2 : 1;
+		add_rec(log, evt->Time, (UCHAR)trk, 0xF7, 0, 0, 0, &buf[0], len);
+		continue;
+	    }
+
+	    switch (status)
+	    {
+		case 0x00:
+		    buf[0] = (UCHAR)(((const MIDISEQEVT *)evt)->SeqNum >> 8);
+		    buf[1] = (UCHAR)((const MIDISEQEVT *)evt)->SeqNum;
+		    len = 2;
+		    break;
+
+		case 0x2F:
+		    break;
+
+		case 0x51:
+		    val = 60000000 / ((const MIDITEMPOEVT *)evt)->BPM;
+		    buf[0] = (UCHAR)(val >> 16);
+		    buf[1] = (UCHAR)(val >> 8);
+		    buf[2] = (UCHAR)val;
+		    len = 3;
+		    break;
+
+		case 0x58:
+		    buf[0] = ((const MIDITIMEEVT *)evt)->Nom;
+		    buf[1] = ((const MIDITIMEEVT *)evt)->Denom;
+		    buf[2] = ((const MIDITIMEEVT *)evt)->Clocks;
+		    buf[3] = 8;
+		    len = 4;
+		    break;
+
+		case 0x59:
+		    buf[0] = ((const MIDIKEYEVT *)evt)->Key;
+		    buf[1] = ((const MIDIKEYEVT *)evt)->Minor;
+		    len = 2;
+		    break;
+
+		default:
+		    ptr = Song.Payloads[((const MIDITXTEVT *)evt)->Index];
+		    len = ((const MIDITXTEVT *)evt)->Length;
+	    }
+	    add_rec(log, evt->Time, (UCHAR)trk, 0xFF, status, 0, 0, ptr, len);
+	}
+    }
+
+    /* The chunks that w_chunks() writes */
+    memcpy(&buf[0], "XTRA", 4);
+    for (i = 0; i < XTRASIZE; i++) buf[4 + i] = (UCHAR)(i * 7);
+    add_rec(log, 0, 0xFF, 0, 0, 0, 0, &buf[0], 4 + XTRASIZE);
+    memcpy(&buf[0], "XTRB", 4);
+    add_rec(log, 0, 0xFF, 0, 0, 0, 0, &buf[0], 4 + XTRBSIZE);
+}
+
+
+
+
+/******************************* compare_logs() *******************************
+ * Compares the events read back (got) with what was expected, leaving out whatever flags says
+ * to. Prints the first difference, if any. Returns 1 if there was one, or 0 if not.
+ **************************************************************************/
+
+BOOL left_out(const REC * rec, ULONG flags)
+{
+    if ( (flags & NOCHUNKS) && !rec->Status ) return(TRUE);
+    if ( (flags & NOEOT) && rec->Status == 0xFF && rec->Data1 == 0x2F ) return(TRUE);
+    return(FALSE);
+}
+
+ULONG compare_logs(const CHAR * check, const CHAR * what, const LOG * got, const LOG * expect, ULONG flags)
+{
+    register const REC * a;
+    register const REC * b;
+    register ULONG i, j, n;
+
+    for (i = j = n = 0; ; i++, j++, n++)
+    {
+	while ( i < got->Num && left_out(&got->Recs[i], flags) ) i++;
+	while ( j < expect->Num && left_out(&expect->Recs[j], flags) ) j++;
+	if ( i >= got->Num || j >= expect->Num ) break;
+
+	a = &got->Recs[i];
+	b = &expect->Recs[j];
+	if ( a->Time != b->Time || a->Status != b->Status || a->Data1 != b->Data1 ||
+	     a->Data2 != b->Data2 || a->Chase != b->Chase || a->Len != b->Len ||
+	     ( !(flags & NOTRACK) && a->Track != b->Track ) ||
+	     memcmp(&got->Bytes[a->Offset], &expect->Bytes[b->Offset], a->Len) )
+	{
+	    printf("%s: %s: event %lu is time %lu, MTrk %u, %02X %02X %02X%s, %lu bytes, but should be "
+		   "time %lu, MTrk %u, %02X %02X %02X%s, %lu bytes\r\n", check, what, (unsigned long)n,
+		   (unsigned long)a->Time, a->Track, a->Status, a->Data1, a->Data2,
+		   (a->Chase) ? " (chase)" : "",
+		   (unsigned long)a->Len, (unsigned long)b->Time, b->Track, b->Status, b->Data1, b->Data2,
+		   (b->Chase) ? " (chase)" : "", (unsigned long)b->Len);
+	    return(1);
+	}
+    }
+
+    if ( i < got->Num || j < expect->Num )
+    {
+	printf("%s: %s: %s after %lu events\r\n", check, what,
+	       (i < got->Num) ? "extra events" : "events missing", (unsigned long)n);
+	return(1);
+    }
+
+    return(0);
+}
+
+
+
+
+/********************************* sort_log() *********************************
+ * Sorts a LOG's events by time, and then by everything else but their MTrk, so that two LOGs
+ * with the same events in a different order (or MTrks) compare the same.
+ **************************************************************************/
+
+int compare_recs(const void * p1, const void * p2)
+{
+    register const REC * a = (const REC *)p1;
+    register const REC * b = (const REC *)p2;
+    register int diff;
+
+    if (a->Time != b->Time) return( (a->Time < b->Time) ? -1 : 1 );
+    if (a->Status != b->Status) return( (int)a->Status - (int)b->Status );
+    if (a->Data1 != b->Data1) return( (int)a->Data1 - (int)b->Data1 );
+    if (a->Data2 != b->Data2) return( (int)a->Data2 - (int)b->Data2 );
+    if (a->Len != b->Len) return( (a->Len < b->Len) ? -1 : 1 );
+    if ( (diff = memcmp(&SortLog->Bytes[a->Offset], &SortLog->Bytes[b->Offset], a->Len)) ) return(diff);
+    return(0);
+}
+
+VOID sort_log(LOG * log)
+{
+    SortLog = log;
+    qsort(log->Recs, log->Num, sizeof(REC), compare_recs);
+}
+
+
+
+
+/****************************** whole_log() ************************************
+ * Fills in a LOG with what reading with MIDIWHOLESYSEX should get, given what reading without
+ * it got (from). Each SYSEX's CONTINUATION packets are put back onto it, and it's passed once
+ * it ends with 0xF7 (at the time of its last packet), or at the next event (in its MTrk) that
+ * isn't an 0xF7. An ESCAPE (ie, whose first byte is a status) is passed as is.
+ **************************************************************************/
+
+VOID whole_log(LOG * log, const LOG * from)
+{
+    register const REC * rec;
+    register ULONG i;
+    UCHAR * buf;
+    ULONG len, max, time;
+    UCHAR track, first;
+    BOOL open;
+
+/* Passes the SYSEX that's been put together, if any */
+#define ENDSYSEX() \
+    if (open) add_rec(log, time, track, 0xF0, 0, 0, 0, buf, len); \
+    open = FALSE
+
+    log->Num = log->Size = 0;
+    buf = 0;
+    len = max = time = 0;
+    track = 0;
+    open = FALSE;
+
+    for (i = 0; i < from->Num; i++)
+    {
+	rec = &from->Recs[i];
+
+	if (rec->Status == 0xF7 && open && rec->Track == track)
+	{
+	    if (!rec->Len)
+	    {
+		time = rec->Time;
+		continue;
+	    }
+	    first = from->Bytes[rec->Offset];
+	    if ( (first & 0x80) && first != 0xF7 )
+	    {
+		copy_rec(log, from, rec);
+		continue;
+	    }
+	}
+	else if (rec->Status == 0xF0)
+	{
+	    ENDSYSEX();
+	    len = 0;
+	    open = TRUE;
+	}
+	else
+	{
+	    if (rec->Status != 0xF7 || rec->Track == track)
+	    {
+		ENDSYSEX();
+	    }
+	    copy_rec(log, from, rec);
+	    continue;
+	}
+
+	/* Add the packet onto the SYSEX */
+	if (len + rec->Len > max)
+	{
+	    max = (len + rec->Len) << 1;
+	    buf = (UCHAR *)need_mem(realloc(buf, max));
+	}
+	memcpy(&buf[len], &from->Bytes[rec->Offset], rec->Len);
+	len += rec->Len;
+	time = rec->Time;
+	track = rec->Track;
+	if ( len && buf[len - 1] == 0xF7 )
+	{
+	    ENDSYSEX();
+	}
+    }
+
+    ENDSYSEX();
+#undef ENDSYSEX
+
+    free(buf);
+}
+
+
+
+
+/******************************** skip_event() ********************************
+ * Returns TRUE if an event would be skipped with the specified SkipEvents and SkipChans.
+ **************************************************************************/
+
+BOOL skip_event(const REC * rec, ULONG events, USHORT chans)
+{
+    register UCHAR status = rec->Status;
+
+    if (!status) return(FALSE);
+    if (status < 0xF0) return( (((events >> ((status >> 4) - 8)) | (chans >> (status & 0x0F))) & 1) != 0 );
+    if (status == 0xF0) return( (events & MIDISKIPSYSEX) != 0 );
+    if (status == 0xF7) return( (events & MIDISKIPESCAPE) != 0 );
+
+    switch (rec->Data1)
+    {
+	case 0x00:
+	    return( (events & MIDISKIPSEQNUM) != 0 );
+	case 0x2F:
+	    return(FALSE);
+	case 0x51:
+	    return( (events & MIDISKIPTEMPO) != 0 );
+	case 0x54:
+	    return( (events & MIDISKIPSMPTE) != 0 );
+	case 0x58:
+	    return( (events & MIDISKIPTIMESIG) != 0 );
+	case 0x59:
+	    return( (events & MIDISKIPKEYSIG) != 0 );
+    }
+    return( (events & MIDISKIPTEXT) != 0 );
+}
+
+
+
+
+/******************************** load_bytes() ********************************
+ * Reads a whole file into memory (which the caller must free()), and sets size to its size.
+ * Returns 0 if the file can't be read.
+ **************************************************************************/
+
+UCHAR * load_bytes(const CHAR * name, ULONG * size)
+{
+    register FILE * fp;
+    register UCHAR * buf;
+    long len;
+
+    if ( !(fp = fopen(name, "rb")) ) return(0);
+    fseek(fp, 0, SEEK_END);
+    len = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    buf = (UCHAR *)need_mem(malloc(len + 1));
+    if ( fread(buf, 1, len, fp) != (size_t)len )
+    {
+	free(buf);
+	buf = 0;
+    }
+    fclose(fp);
+    *size = (ULONG)len;
+    return(buf);
+}
+
+
+
+
+/******************************** save_bytes() ********************************
+ * Writes size bytes at buf to a file. Returns FALSE if the file can't be written.
+ **************************************************************************/
+
+BOOL save_bytes(const CHAR * name, const UCHAR * buf, ULONG size)
+{
+    register FILE * fp;
+    register BOOL ok;
+
+    if ( !(fp = fopen(name, "wb")) ) return(FALSE);
+    ok = ( fwrite(buf, 1, size, fp) == size );
+    if ( fclose(fp) ) ok = FALSE;
+    return(ok);
+}
+
+
+
+
+/********************************* file_of() **********************************
+ * Returns the TESTFILE whose MIDIFILE a callback got (which, for a MIDIPARALLEL write, is the
+ * DLL's copy of it).
+ **************************************************************************/
+
+TESTFILE * file_of(VOID * mf)
+{
+    return( (TESTFILE *)MIDIAPPFILE(mf) );
+}
+
+
+
+
+/***************************** The write callbacks *****************************
+ * w_startMTrk() writes the whole MTrk with MidiWriteTrackEvents() if the TESTFILE's Bulk is
+ * set. Otherwise, w_standardEvt() supplies each of its MIDIEVTs in turn. The data of odd
+ * numbered payloads is given to the DLL by pointer, and w_data() writes that of the even ones.
+ * w_chunks() writes 2 chunks that aren't MTrks, after the MTrks.
+ **************************************************************************/
+
+LONG EXPENTRY w_startMTrk(MIDIFILE * mf)
+{
+    register LONG result;
+
+    if ( !file_of(mf)->Bulk ) return(0);
+
+    if ( (result = MidiWriteTrackEvents(mf, &Song.Evts[mf->TrackNum][0], Song.NumEvts[mf->TrackNum],
+					&Song.Payloads[0])) ) return(result);
+    return(-1);
+}
+
+LONG EXPENTRY w_standardEvt(MIDIFILE * mf)
+{
+    register TESTFILE * tf = file_of(mf);
+    register const MIDIEVT * evt = &Song.Evts[mf->TrackNum][tf->Next[mf->TrackNum]++];
+    register USHORT index;
+
+    mf->Time = evt->Time;
+    mf->Status = evt->Status;
+
+    /* MIDI event, REALTIME, or SYSTEM COMMON */
+    if ( evt->Status >= 0x80 && evt->Status != 0xF0 && evt->Status != 0xF7 )
+    {
+	mf->Data[0] = evt->Data1;
+	mf->Data[1] = evt->Data2;
+	return(0);
+    }
+
+    /* SYSEX */
+    if (evt->Status >= 0x80)
+    {
+	index = ((const MIDIXEVT *)evt)->Index;
+	mf->EventSize = ((const MIDIXEVT *)evt)->Length;
+    }
+
+    /* Meta-Event */
+    else
+    {
+	mf->Status = 0xFF;
+	mf->Data[0] = evt->Status;
+	switch (evt->Status)
+	{
+	    case 0x00:
+		((METASEQ *)mf)->SeqNum = ((const MIDISEQEVT *)evt)->SeqNum;
+		((METASEQ *)mf)->NamePtr = 0;
+		return(0);
+
+	    case 0x2F:
+		return(0);
+
+	    case 0x51:
+		((METATEMPO *)mf)->TempoBPM = ((const MIDITEMPOEVT *)evt)->BPM;
+		return(0);
+
+	    case 0x54:
+		memcpy(&((METASMPTE *)mf)->Hours, Song.Payloads[((const MIDITXTEVT *)evt)->Index], 5);
+		return(0);
+
+	    case 0x58:
+		((METATIME *)mf)->Nom = ((const MIDITIMEEVT *)evt)->Nom;
+		((METATIME *)mf)->Denom = ((const MIDITIMEEVT *)evt)->Denom;
+		((METATIME *)mf)->Clocks = ((const MIDITIMEEVT *)evt)->Clocks;
+		((METATIME *)mf)->_32nds = 8;
+		return(0);
+
+	    case 0x59:
+		((METAKEY *)mf)->Key = (CHAR)((const MIDIKEYEVT *)evt)->Key;
+		((METAKEY *)mf)->Minor = ((const MIDIKEYEVT *)evt)->Minor;
+		return(0);
+	}
+	index = ((const MIDITXTEVT *)evt)->Index;
+	mf->EventSize = ((const MIDITXTEVT *)evt)->Length;
+    }
+
+    /* A pointer with an EventSize of 0 would mean a null-terminated string, so empty text
+	gets no pointer */
+    if ( (index & 1) && mf->EventSize )
+	((METATXT *)mf)->Ptr = Song.Payloads[index];
+    else
+	tf->Pay[mf->TrackNum] = index;
+    return(0);
+}
+
+LONG EXPENTRY w_data(MIDIFILE * mf)
+{
+    register UCHAR * ptr = Song.Payloads[file_of(mf)->Pay[mf->TrackNum]];
+    register ULONG len = mf->EventSize;
+    LONG result;
+
+    /* In 2 pieces, to check that the DLL counts them off */
+    if ( (result = MidiWriteBytes(mf, ptr, len >> 1)) ) return(result);
+    return( MidiWriteBytes(mf, ptr + (len >> 1), len - (len >> 1)) );
+}
+
+LONG EXPENTRY w_chunks(MIDIFILE * mf)
+{
+    UCHAR buf[XTRASIZE];
+    ULONG i;
+    LONG result;
+
+    for (i = 0; i < XTRASIZE; i++) buf[i] = (UCHAR)(i * 7);
+
+    memcpy(&mf->ID, "XTRA", 4);
+    mf->ChunkSize = 0;
+    if ( (result = MidiWriteHeader(mf)) ) return(result);
+    if ( (result = MidiWriteBytes(mf, &buf[0], XTRASIZE)) ) return(result);
+    if ( (result = MidiCloseChunk(mf)) ) return(result);
+
+    memcpy(&mf->ID, "XTRB", 4);
+    mf->ChunkSize = 0;
+    if ( (result = MidiWriteHeader(mf)) ) return(result);
+    if ( (result = MidiWriteBytes(mf, &buf[0], XTRBSIZE)) ) return(result);
+    return( MidiCloseChunk(mf) );
+}
+
+
+
+
+/***************************** The read callbacks ******************************
+ * Each adds the event read to the TESTFILE's Log. With a MIDIARENA, the DLL has already read
+ * the data of SYSEX and variable length Meta-Events, and get_data() just looks at it.
+ * Otherwise, it reads it, with MidiReadBytesView() for odd lengths and MidiReadBytes() for
+ * even ones.
+ **************************************************************************/
+
+LONG add_event(MIDIFILE * mf, UCHAR status, UCHAR data1, UCHAR data2, const UCHAR * ptr, ULONG len)
+{
+    add_rec(file_of(mf)->Log, mf->Time, mf->TrackNum, status, data1, data2,
+	    (mf->Flags & MIDICHASE) ? 1 : 0, ptr, len);
+    return(0);
+}
+
+LONG get_data(MIDIFILE * mf, UCHAR ** ptr, ULONG * len)
+{
+    register TESTFILE * tf = file_of(mf);
+
+    *len = mf->EventSize;
+
+    if (mf->Arena)
+    {
+	*ptr = ((METATXT *)mf)->Ptr;
+	return(0);
+    }
+
+    if ( (*len & 1) && (*ptr = MidiReadBytesView(mf, *len)) ) return(0);
+
+    if (*len > tf->MaxBuf)
+    {
+	tf->MaxBuf = *len;
+	tf->Buf = (UCHAR *)need_mem(realloc(tf->Buf, *len));
+    }
+    *ptr = tf->Buf;
+    return( MidiReadBytes(mf, tf->Buf, *len) );
+}
+
+LONG EXPENTRY r_standardEvt(MIDIFILE * mf)
+{
+    return( add_event(mf, mf->Status, mf->Data[0], mf->Data[1], 0, 0) );
+}
+
+LONG EXPENTRY r_sysexEvt(MIDIFILE * mf)
+{
+    UCHAR * ptr;
+    ULONG len;
+    LONG result;
+
+    if ( (result = get_data(mf, &ptr, &len)) ) return(result);
+    return( add_event(mf, mf->Status, 0, 0, ptr, len) );
+}
+
+LONG EXPENTRY r_metaText(METATXT * mf)
+{
+    UCHAR * ptr;
+    ULONG len;
+    LONG result;
+
+    if ( (result = get_data((MIDIFILE *)mf, &ptr, &len)) ) return(result);
+    return( add_event((MIDIFILE *)mf, 0xFF, mf->Type, 0, ptr, len) );
+}
+
+LONG EXPENTRY r_metaseq(METASEQ * mf)
+{
+    UCHAR buf[2];
+
+    buf[0] = (UCHAR)(mf->SeqNum >> 8);
+    buf[1] = (UCHAR)mf->SeqNum;
+    return( add_event((MIDIFILE *)mf, 0xFF, 0x00, 0, &buf[0], 2) );
+}
+
+LONG EXPENTRY r_metaTempo(METATEMPO * mf)
+{
+    UCHAR buf[3];
+
+    buf[0] = (UCHAR)(mf->Tempo >> 16);
+    buf[1] = (UCHAR)(mf->Tempo >> 8);
+    buf[2] = (UCHAR)mf->Tempo;
+    return( add_event((MIDIFILE *)mf, 0xFF, 0x51, 0, &buf[0], 3) );
+}
+
+LONG EXPENTRY r_metaTimeSig(METATIME * mf)
+{
+    return( add_event((MIDIFILE *)mf, 0xFF, 0x58, 0, &mf->Nom, 4) );
+}
+
+LONG EXPENTRY r_metaKeySig(METAKEY * mf)
+{
+    UCHAR buf[2];
+
+    buf[0] = (UCHAR)mf->Key;
+    buf[1] = mf->Minor;
+    return( add_event((MIDIFILE *)mf, 0xFF, 0x59, 0, &buf[0], 2) );
+}
+
+LONG EXPENTRY r_metaSMPTE(METASMPTE * mf)
+{
+    return( add_event((MIDIFILE *)mf, 0xFF, 0x54, 0, &mf->Hours, 5) );
+}
+
+LONG EXPENTRY r_metaEOT(METAEND * mf)
+{
+    return( add_event((MIDIFILE *)mf, 0xFF, 0x2F, 0, 0, 0) );
+}
+
+LONG EXPENTRY r_chunk(MIDIFILE * mf)
+{
+    register TESTFILE * tf = file_of(mf);
+    register ULONG len = mf->ChunkSize;
+    LONG result;
+
+    if (len + 4 > tf->MaxBuf)
+    {
+	tf->MaxBuf = len + 4;
+	tf->Buf = (UCHAR *)need_mem(realloc(tf->Buf, len + 4));
+    }
+    memcpy(tf->Buf, &mf->ID, 4);
+    if ( (result = MidiReadBytes(mf, tf->Buf + 4, len)) ) return(result);
+    add_rec(tf->Log, 0, 0xFF, 0, 0, 0, 0, tf->Buf, len + 4);
+    return(0);
+}
+
+
+
+
+/******************************** init_file() *********************************
+ * Readies a TESTFILE for writing or reading (ie, with log) the named file.
+ **************************************************************************/
+
+VOID init_file(TESTFILE * tf, const CHAR * name, LOG * log)
+{
+    free(tf->Buf);
+    memset(tf, 0, sizeof(TESTFILE));
+    tf->mf.Callbacks = (log) ? &rcb : &wcb;
+    tf->mf.Handle = (MIDIHANDLE)name;
+    tf->Log = log;
+    if (log) log->Num = log->Size = 0;
+}
+
+VOID done_file(TESTFILE * tf)
+{
+    free(tf->Buf);
+    tf->Buf = 0;
+    tf->MaxBuf = 0;
+}
+
+
+
+
+/******************************** write_song() ********************************
+ * Writes the song to the named file, with the specified MIDIFILE Flags (and MIDIBPM), with
+ * MidiWriteTrackEvents() if bulk is set, or else a MIDIEVT at a time. Returns 0 if success, or
+ * an error number.
+ **************************************************************************/
+
+LONG write_song(const CHAR * name, USHORT flags, BOOL bulk)
+{
+    TESTFILE tf;
+
+    make_song();
+    memset(&tf, 0, sizeof(TESTFILE));
+    init_file(&tf, name, 0);
+    tf.mf.Format = 1;
+    tf.mf.NumTracks = NUMTRKS;
+    tf.mf.Division = DIVISION;
+    tf.mf.Flags = flags | MIDIBPM;
+    tf.Bulk = bulk;
+    return( MidiWriteFile(&tf.mf) );
+}
+
+
+
+
+/******************************** same_write() ********************************
+ * Writes the song to the named file with the specified MIDIFILE Flags (and with
+ * MidiWriteTrackEvents() if bulk is set), which must give the firstsize bytes at first. Returns
+ * 0 if it does, or 1 (after printing why) if not.
+ **************************************************************************/
+
+ULONG same_write(const CHAR * check, const CHAR * what, const CHAR * name, USHORT flags, BOOL bulk,
+		 const UCHAR * first, ULONG firstsize)
+{
+    CHAR msg[100];
+    UCHAR * buf;
+    ULONG size;
+    LONG result;
+
+    if ( (result = write_song(name, flags, bulk)) )
+    {
+	sprintf(&msg[0], "%s write", what);
+	return( fail(check, &msg[0], result) );
+    }
+    if ( !(buf = load_bytes(name, &size)) || size != firstsize || memcmp(buf, first, size) )
+    {
+	free(buf);
+	sprintf(&msg[0], "%s write differs from a MIDIEVT at a time", what);
+	return( fail(check, &msg[0], 0) );
+    }
+    free(buf);
+    return(0);
+}
+
+
+
+
+/********************************* read_log() *********************************
+ * Reads the named file with MidiReadFile(), with the specified MIDIFILE Flags, and an Arena if
+ * one is passed, into log. Returns 0 if success, or an error number.
+ **************************************************************************/
+
+LONG read_log(const CHAR * name, LOG * log, USHORT flags, MIDIARENA * arena)
+{
+    TESTFILE tf;
+    LONG result;
+
+    memset(&tf, 0, sizeof(TESTFILE));
+    init_file(&tf, name, log);
+    tf.mf.Flags = flags;
+    tf.mf.Arena = arena;
+    result = MidiReadFile(&tf.mf);
+    done_file(&tf);
+    if (arena) MidiFreeArena(arena);
+    return(result);
+}
+
+/* Adds a MIDIEVENT (or the Nth event of a MIDIEVENTS) to a LOG */
+VOID event_rec(LOG * log, const MIDIEVENT * evt)
+{
+    add_rec(log, evt->Time, evt->Track, evt->Status, evt->Data1, evt->Data2, 0, evt->Payload, evt->Length);
+}
+
+VOID events_log(LOG * log, const MIDIEVENTS * evts)
+{
+    register ULONG i;
+
+    log->Num = log->Size = 0;
+    for (i = 0; i < evts->NumEvents; i++)
+    {
+	add_rec(log, evts->Time[i], evts->Track[i], evts->Status[i], evts->Data1[i], evts->Data2[i], 0,
+		&evts->Payload[evts->Offset[i]], evts->Length[i]);
+    }
+}
+
+
+
+
+CHECK Checks[] =
+{
+    {"write", check_write},
+    {"mmap", check_mmap},
+    {"memory", check_memory},
+    {"load", check_load},
+    {"trackevents", check_trackevents},
+    {"parallelload", check_parallelload},
+    {"parallelwrite", check_parallelwrite},
+    {"vlq", check_vlq},
+    {"scan", check_scan},
+    {"index", check_index},
+    {"range", check_range},
+    {"skip", check_skip},
+    {"tempo", check_tempo},
+    {"merged", check_merged},
+    {"convert", check_convert},
+    {"compact", check_compact},
+    {"parser", check_parser},
+    {"reader", check_reader},
+    {"arena", check_arena},
+    {"wholesysex", check_wholesysex},
+    {"hold", check_hold},
+    {"files", check_files},
+};
+
+#define NUMCHECKS (sizeof(Checks) / sizeof(Checks[0]))
+
+
+
+
+/*********************************** main() ***********************************
+ * Program entry point. Runs the named check, or all of them.
+ ****************************************************************************/
+
+int main(int argc, char *argv[], char *envp[])
+{
+    ULONG i, ran, errs;
+
+    (VOID)envp;
+
+    wcb.StartMTrk = (CALL)w_startMTrk;
+    wcb.StandardEvt = (CALL)w_standardEvt;
+    wcb.SysexEvt = (CALL)w_data;
+    wcb.MetaText = (CALL)w_data;
+    wcb.UnknownChunk = (CALL)w_chunks;
+
+    rcb.StandardEvt = (CALL)r_standardEvt;
+    rcb.SysexEvt = (CALL)r_sysexEvt;
+    rcb.MetaText = (CALL)r_metaText;
+    rcb.MetaSeqNum = (CALL)r_metaseq;
+    rcb.MetaTempo = (CALL)r_metaTempo;
+    rcb.MetaTimeSig = (CALL)r_metaTimeSig;
+    rcb.MetaKeySig = (CALL)r_metaKeySig;
+    rcb.MetaSMPTE = (CALL)r_metaSMPTE;
+    rcb.MetaEOT = (CALL)r_metaEOT;
+    rcb.UnknownChunk = (CALL)r_chunk;
+
+    ran = errs = 0;
+    for (i = 0; i < NUMCHECKS; i++)
+    {
+	if ( argc > 1 && strcmp(argv[1], Checks[i].Name) ) continue;
+	ran++;
+	errs += Checks[i].Func();
+    }
+
+    if (!ran)
+    {
+	printf("This program runs the MIDIFILE engine's regression tests.\r\n\r\n");
+	printf("Syntax: mftest [check]\r\n\r\nThe checks are:");
+	for (i = 0; i < NUMCHECKS; i++) printf(" %s", Checks[i].Name);
+	printf("\r\n");
+	exit(1);
+    }
+
+    printf("%lu check%s, %lu failure%s\r\n", (unsigned long)ran, (ran == 1) ? "" : "s",
+	(unsigned long)errs, (errs == 1) ? "" : "s");
+    exit( (errs) ? 1 : 0 );
+}
@@ -0,0 +1,184 @@
+/* ============================== MFTEST.H ==================================
+ *  Definitions shared by mftest.c (the song, the LOGs, and the callbacks that every check
+ *  uses, and main()) and the mft*.c files, each of which has the checks for one part of the
+ *  engine.
+ ========================================================================== */
+
+#ifndef MFTEST_H
+#define MFTEST_H
+
+#ifdef __OS2__
+#include <os2.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "midifile.h"
+
+
+/* How many MTrks the song has (the first being the tempo MTrk) */
+#define NUMTRKS 4
+
+/* How many events each MTrk has, not counting the End Of Track (or a few more, since a SYSEX
+    in packets isn't split up) */
+#define NUMEVENTS 2000
+#define MAXEVENTS (NUMEVENTS + 16)
+
+/* The song's payloads. SYSEX data is 0 to 199 (because a MIDIXEVT's Index is a UCHAR):
+    whole messages, then the first, middle, and last packets of ones split up. Text is after
+    that, and then the SMPTE Offset */
+#define PAYWHOLE  0
+#define PAYFIRST  50
+#define PAYMIDDLE 100
+#define PAYLAST   150
+#define PAYTEXT   200
+#define NUMTEXT   100
+#define PAYSMPTE  (PAYTEXT + NUMTEXT)
+#define NUMPAYLOADS (PAYSMPTE + 1)
+
+/* The song's Division, and the sizes of its 2 chunks that aren't MTrks */
+#define DIVISION 480
+#define XTRASIZE 300
+#define XTRBSIZE 5
+
+/* The song, as the MIDIEVTs of each MTrk (for MidiWriteTrackEvents()) and their payloads */
+typedef struct _SONG
+{
+    MIDIEVT   Evts[NUMTRKS][MAXEVENTS];
+    ULONG     NumEvts[NUMTRKS];
+    UCHAR *   Payloads[NUMPAYLOADS];
+    USHORT    Lens[NUMPAYLOADS];
+} SONG;
+
+/* An event, as read back */
+typedef struct _REC
+{
+    ULONG     Time;
+    UCHAR     Track;	 /* 0xFF for a chunk that isn't an MTrk */
+    UCHAR     Status;	 /* MIDI status, 0xF0 or 0xF7 for SYSEX, 0xFF for a Meta-Event, or 0 for
+			    a chunk that isn't an MTrk */
+    UCHAR     Data1;	 /* First MIDI data byte, or the Meta-Event's type */
+    UCHAR     Data2;	 /* Second MIDI data byte (0xFF if only 1) */
+    UCHAR     Chase;	 /* Set if the event was reported with MIDICHASE */
+    ULONG     Len;	 /* Number of data bytes. For a chunk, its ID and data */
+    ULONG     Offset;	 /* Where they are in the LOG's Bytes */
+} REC;
+
+/* All of the events read back from a file, in the order that they were read */
+typedef struct _LOG
+{
+    REC *     Recs;
+    ULONG     Num, Max;
+    UCHAR *   Bytes;
+    ULONG     Size, MaxSize;
+} LOG;
+
+/* What compare_logs() leaves out */
+#define NOCHUNKS 0x0001  /* Chunks that aren't MTrks */
+#define NOTRACK  0x0002  /* Which MTrk each event is in */
+#define NOEOT	 0x0004  /* End Of Tracks */
+
+/* A MIDIFILE, and what its callbacks need */
+typedef struct _TESTFILE
+{
+    MIDIFILE  mf;	 /* Must be first, so the callbacks can recast it to the TESTFILE */
+    ULONG     Next[NUMTRKS]; /* Writing: next MIDIEVT of each MTrk. A MIDIPARALLEL write calls
+			    each MTrk's callbacks on a different thread, so each MTrk needs its
+			    own */
+    USHORT    Pay[NUMTRKS]; /* Writing: the payload that w_data() writes, for each MTrk */
+    BOOL      Bulk;	 /* Writing: set to write each MTrk with MidiWriteTrackEvents() */
+    LOG *     Log;	 /* Reading: where the events go */
+    const LOG * Expect;  /* MidiReadFiles(): what each file should read back as */
+    ULONG     Errors;	 /* MidiReadFiles(): how many files didn't */
+    UCHAR *   Buf;	 /* Reading: for MidiReadBytes() */
+    ULONG     MaxBuf;
+} TESTFILE;
+
+
+/* mftest.c */
+extern ULONG fail(const CHAR * check, const CHAR * what, LONG result);
+extern VOID * need_mem(VOID * ptr);
+extern ULONG rnd(ULONG num);
+extern VOID add_rec(LOG * log, ULONG time, UCHAR track, UCHAR status, UCHAR data1, UCHAR data2, UCHAR chase,
+		    const UCHAR * ptr, ULONG len);
+extern VOID copy_rec(LOG * log, const LOG * from, const REC * rec);
+extern VOID free_log(LOG * log);
+extern VOID song_log(LOG * log);
+extern ULONG compare_logs(const CHAR * check, const CHAR * what, const LOG * got, const LOG * expect, ULONG flags);
+extern VOID sort_log(LOG * log);
+extern VOID whole_log(LOG * log, const LOG * from);
+extern BOOL skip_event(const REC * rec, ULONG events, USHORT chans);
+extern UCHAR * load_bytes(const CHAR * name, ULONG * size);
+extern BOOL save_bytes(const CHAR * name, const UCHAR * buf, ULONG size);
+extern VOID init_file(TESTFILE * tf, const CHAR * name, LOG * log);
+extern VOID done_file(TESTFILE * tf);
+extern LONG write_song(const CHAR * name, USHORT flags, BOOL bulk);
+extern ULONG same_write(const CHAR * check, const CHAR * what, const CHAR * name, USHORT flags, BOOL bulk,
+			const UCHAR * first, ULONG firstsize);
+extern LONG read_log(const CHAR * name, LOG * log, USHORT flags, MIDIARENA * arena);
+extern VOID event_rec(LOG * log, const MIDIEVENT * evt);
+extern VOID events_log(LOG * log, const MIDIEVENTS * evts);
+
+/* mftwrite.c */
+extern ULONG check_write(VOID);
+
+/* mftmmap.c */
+extern ULONG check_mmap(VOID);
+
+/* mftmemory.c */
+extern ULONG check_memory(VOID);
+
+/* mftload.c */
+extern ULONG check_load(VOID);
+
+/* mfttrack.c */
+extern ULONG check_trackevents(VOID);
+
+/* mftparallel.c */
+extern ULONG check_parallelload(VOID);
+extern ULONG check_parallelwrite(VOID);
+
+/* mftvlq.c */
+extern ULONG check_vlq(VOID);
+
+/* mftindex.c */
+extern ULONG check_scan(VOID);
+extern ULONG check_index(VOID);
+
+/* mftrange.c */
+extern ULONG check_range(VOID);
+
+/* mftskip.c */
+extern ULONG check_skip(VOID);
+
+/* mfttempo.c */
+extern ULONG check_tempo(VOID);
+
+/* mftmerge.c */
+extern ULONG check_merged(VOID);
+
+/* mftconv.c */
+extern ULONG check_convert(VOID);
+extern ULONG check_compact(VOID);
+
+/* mftparse.c */
+extern ULONG check_parser(VOID);
+
+/* mftreader.c */
+extern ULONG check_reader(VOID);
+
+/* mftarena.c */
+extern ULONG check_arena(VOID);
+
+/* mftwhole.c */
+extern ULONG check_wholesysex(VOID);
+
+/* mfthold.c */
+extern ULONG check_hold(VOID);
+
+/* mftfiles.c */
+extern ULONG check_files(VOID);
+
+#endif /* MFTEST_H */
@@ -0,0 +1,82 @@
+/* ===========================================================================
+ * mftfiles.c
+ *
+ * mftest's check of MidiReadFiles().
+ * =========================================================================
+ */
+
+#include "mftest.h"
+
+
+
+
+/******************************** check_files() ********************************
+ * Reads the song with MidiReadFiles(), as a batch of 6 on 3 MIDIFILEs, with one file that isn't
+ * there. Only that one must fail, and each of the others must get what MidiReadFile() gets.
+ **************************************************************************/
+
+static LONG EXPENTRY done_file_cb(MIDIBATCH * batch, MIDIFILE * mf, ULONG item, LONG result)
+{
+    register TESTFILE * tf = (TESTFILE *)mf;
+
+    (VOID)batch;
+    (VOID)item;
+    if ( !result && compare_logs("files", "MidiReadFiles()", tf->Log, tf->Expect, 0) ) tf->Errors++;
+    tf->Log->Num = tf->Log->Size = 0;
+    return(0);
+}
+
+ULONG check_files(VOID)
+{
+    static const CHAR * paths[] = {"mftest_files.mid", "mftest_files.mid", "mftest_files_none.mid",
+				   "mftest_files.mid", "mftest_files.mid", "mftest_files.mid"};
+    MIDIBATCH batch;
+    MIDIFILE * files[3];
+    TESTFILE tfs[3];
+    LONG results[6];
+    LOG ref, logs[3];
+    ULONG i;
+    ULONG errs = 0;
+    LONG result;
+
+    memset(&ref, 0, sizeof(LOG));
+    memset(&logs[0], 0, sizeof(logs));
+    memset(&tfs[0], 0, sizeof(tfs));
+
+    if ( (result = write_song("mftest_files.mid", 0, FALSE)) )
+	return( fail("files", "write failed", result) );
+    if ( (result = read_log("mftest_files.mid", &ref, 0, 0)) )
+	return( fail("files", "MidiReadFile() failed", result) );
+
+    memset(&batch, 0, sizeof(MIDIBATCH));
+    for (i = 0; i < 3; i++)
+    {
+	init_file(&tfs[i], 0, &logs[i]);
+	tfs[i].Expect = &ref;
+	files[i] = &tfs[i].mf;
+    }
+    batch.Paths = &paths[0];
+    batch.Count = 6;
+    batch.NumFiles = 3;
+    batch.Files = &files[0];
+    batch.Results = &results[0];
+    batch.DoneFile = done_file_cb;
+    result = MidiReadFiles(&batch);
+    if (result != MIDIERRFILE || batch.Failed != 1)
+	errs += fail("files", "MidiReadFiles() didn't fail just the missing file", result);
+    for (i = 0; i < 6; i++)
+    {
+	if ( results[i] != ((i == 2) ? MIDIERRFILE : 0) )
+	    errs += fail("files", "MidiReadFiles() result", results[i]);
+    }
+    for (i = 0; i < 3; i++)
+    {
+	errs += tfs[i].Errors;
+	done_file(&tfs[i]);
+	free_log(&logs[i]);
+    }
+
+    free_log(&ref);
+    if (!errs) remove("mftest_files.mid");
+    return(errs);
+}
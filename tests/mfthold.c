@@ -0,0 +1,63 @@
+/* ===========================================================================
+ * mfthold.c
+ *
+ * mftest's check of MIDIHOLD, and of writing with a small buffer.
+ * =========================================================================
+ */
+
+#include "mftest.h"
+
+
+
+
+/********************************* check_hold() ********************************
+ * Writes the song with MIDIHOLD (and MIDIPARALLEL), with MidiWriteTrackEvents() with MIDIHOLD,
+ * and with a small buffer. Each must give the same bytes as a serial write.
+ **************************************************************************/
+
+ULONG check_hold(VOID)
+{
+    TESTFILE tf;
+    UCHAR * first, * buf;
+    ULONG size, firstsize;
+    ULONG errs = 0;
+    LONG result;
+
+    memset(&tf, 0, sizeof(TESTFILE));
+
+    if ( (result = write_song("mftest_hold.mid", 0, FALSE)) )
+	return( fail("hold", "serial write failed", result) );
+    if ( !(first = load_bytes("mftest_hold.mid", &firstsize)) )
+	return( fail("hold", "can't load the file", 0) );
+
+    errs += same_write("hold", "MIDIHOLD", "mftest_hold2.mid", MIDIHOLD, FALSE, first, firstsize);
+    errs += same_write("hold", "MIDIPARALLEL and MIDIHOLD", "mftest_hold2.mid", MIDIPARALLEL|MIDIHOLD, FALSE,
+		       first, firstsize);
+    errs += same_write("hold", "MidiWriteTrackEvents() with MIDIHOLD", "mftest_hold2.mid", MIDIHOLD, TRUE,
+		       first, firstsize);
+
+    /* A small buffer, so that most MidiCloseChunk()s have to seek back to the header */
+    init_file(&tf, "mftest_hold2.mid", 0);
+    tf.mf.Format = 1;
+    tf.mf.NumTracks = NUMTRKS;
+    tf.mf.Division = DIVISION;
+    tf.mf.Flags = MIDIBPM;
+    tf.mf.BufSize = 100;
+    if ( (result = MidiWriteFile(&tf.mf)) )
+	errs += fail("hold", "write with a 100 byte buffer failed", result);
+    else if ( !(buf = load_bytes("mftest_hold2.mid", &size)) || size != firstsize || memcmp(buf, first, size) )
+    {
+	errs += fail("hold", "write with a 100 byte buffer differs from a serial one", 0);
+	free(buf);
+    }
+    else
+	free(buf);
+
+    free(first);
+    if (!errs)
+    {
+	remove("mftest_hold.mid");
+	remove("mftest_hold2.mid");
+    }
+    return(errs);
+}
@@ -0,0 +1,202 @@
+/* ===========================================================================
+ * mftindex.c
+ *
+ * mftest's checks of MidiScanFile(), and of saving, loading, and reading from the MIDIINDEX that
+ * it makes.
+ * =========================================================================
+ */
+
+#include "mftest.h"
+
+
+
+
+/********************************* check_scan() *********************************
+ * Scans the song with MidiScanFile(), and checks its totals, and each MTrk's counts, against what
+ * MidiReadFile() gets. MidiLoadEvents() must load as many events and bytes as it counts.
+ **************************************************************************/
+
+ULONG check_scan(VOID)
+{
+    register const REC * rec;
+    register ULONG i;
+    MIDIINDEX idx;
+    MIDIEVENTS evts;
+    ULONG counts[NUMTRKS][MIDICOUNTS], payload, events;
+    TESTFILE tf;
+    LOG ref;
+    ULONG errs = 0;
+    LONG result;
+
+    memset(&ref, 0, sizeof(LOG));
+    memset(&tf, 0, sizeof(TESTFILE));
+    memset(&idx, 0, sizeof(MIDIINDEX));
+    memset(&evts, 0, sizeof(MIDIEVENTS));
+
+    if ( (result = write_song("mftest_scan.mid", 0, FALSE)) ) return( fail("scan", "write failed", result) );
+    if ( (result = read_log("mftest_scan.mid", &ref, 0, 0)) )
+	return( fail("scan", "MidiReadFile() failed", result) );
+
+    /* What the counts should be */
+    memset(&counts[0][0], 0, sizeof(counts));
+    payload = events = 0;
+    for (rec = &ref.Recs[0]; rec < &ref.Recs[ref.Num]; rec++)
+    {
+	if (!rec->Status) continue;
+	events++;
+	if (rec->Status < 0xF0)
+	    counts[rec->Track][(rec->Status >> 4) - 8]++;
+	else
+	{
+	    counts[rec->Track][(rec->Status == 0xF0) ? MIDICOUNTSYSEX :
+			       (rec->Status == 0xF7) ? MIDICOUNTESCAPE : MIDICOUNTMETA]++;
+	    payload += rec->Len;
+	}
+    }
+
+    init_file(&tf, "mftest_scan.mid", 0);
+    if ( (result = MidiScanFile(&tf.mf, &idx)) ) return( fail("scan", "MidiScanFile() failed", result) );
+    if ( idx.NumTracks != NUMTRKS || idx.Format != 1 || idx.Division != DIVISION || idx.NumEvents != events ||
+	 idx.PayloadSize != payload )
+	errs += fail("scan", "MidiScanFile()'s totals are wrong", 0);
+    for (i = 0; i < idx.NumTracks && i < NUMTRKS; i++)
+    {
+	if ( memcmp(&idx.Tracks[i].Counts[0], &counts[i][0], sizeof(counts[i])) )
+	    errs += fail("scan", "MidiScanFile()'s counts are wrong", 0);
+    }
+
+    init_file(&tf, "mftest_scan.mid", 0);
+    if ( (result = MidiLoadEvents(&tf.mf, &evts)) )
+	errs += fail("scan", "MidiLoadEvents() failed", result);
+    else if (evts.NumEvents != idx.NumEvents || evts.PayloadSize != idx.PayloadSize)
+	errs += fail("scan", "MidiLoadEvents() doesn't match MidiScanFile()'s counts", 0);
+
+    done_file(&tf);
+    MidiFreeEvents(&evts);
+    MidiFreeIndex(&idx);
+    free_log(&ref);
+    if (!errs) remove("mftest_scan.mid");
+    return(errs);
+}
+
+
+
+
+/******************************** check_index() ********************************
+ * Scans the song with MidiScanFile() (with checkpoints). Saves the MIDIINDEX with
+ * MidiSaveIndex(), and loads it back with MidiLoadIndex(), which must give the same MIDIINDEX. Then reads the song from several times
+ * with MidiReadFrom(), which must get what MidiReadFile() gets from then on. Also checks that
+ * MidiReadFrom() won't use the index for a different file.
+ **************************************************************************/
+
+ULONG check_index(VOID)
+{
+    register const REC * rec;
+    register ULONG i, j;
+    MIDIINDEX idx, loaded;
+    ULONG endtime;
+    ULONG starts[4];
+    TESTFILE tf;
+    LOG ref, got, expect;
+    CHAR what[60];
+    ULONG errs = 0;
+    LONG result;
+
+    memset(&ref, 0, sizeof(LOG));
+    memset(&got, 0, sizeof(LOG));
+    memset(&expect, 0, sizeof(LOG));
+    memset(&tf, 0, sizeof(TESTFILE));
+    memset(&idx, 0, sizeof(MIDIINDEX));
+    memset(&loaded, 0, sizeof(MIDIINDEX));
+
+    if ( (result = write_song("mftest_index.mid", 0, FALSE)) ) return( fail("index", "write failed", result) );
+    if ( (result = read_log("mftest_index.mid", &ref, 0, 0)) )
+	return( fail("index", "MidiReadFile() failed", result) );
+
+    endtime = 0;
+    for (rec = &ref.Recs[0]; rec < &ref.Recs[ref.Num]; rec++)
+    {
+	if (rec->Status && rec->Time > endtime) endtime = rec->Time;
+    }
+
+    init_file(&tf, "mftest_index.mid", 0);
+    idx.CheckTicks = 5000;
+    if ( (result = MidiScanFile(&tf.mf, &idx)) ) return( fail("index", "MidiScanFile() failed", result) );
+    if (!idx.NumChecks) errs += fail("index", "MidiScanFile() made no checkpoints", 0);
+
+    /* Saved and loaded back */
+    init_file(&tf, "mftest_index.idx", 0);
+    if ( (result = MidiSaveIndex(&tf.mf, &idx)) ) return( fail("index", "MidiSaveIndex() failed", result) );
+    init_file(&tf, "mftest_index.idx", 0);
+    if ( (result = MidiLoadIndex(&tf.mf, &loaded)) ) return( fail("index", "MidiLoadIndex() failed", result) );
+    if ( loaded.Format != idx.Format || loaded.NumTracks != idx.NumTracks || loaded.Division != idx.Division ||
+	 loaded.NumEvents != idx.NumEvents || loaded.PayloadSize != idx.PayloadSize ||
+	 loaded.FileSize != idx.FileSize || loaded.CheckTicks != idx.CheckTicks ||
+	 loaded.CheckBytes != idx.CheckBytes || loaded.NumChecks != idx.NumChecks )
+	errs += fail("index", "MidiLoadIndex()'s totals differ from MidiScanFile()'s", 0);
+    else
+    {
+	for (i = 0; i < idx.NumTracks; i++)
+	{
+	    if ( memcmp(&loaded.Tracks[i], &idx.Tracks[i], sizeof(MIDITRACKINFO)) )
+		errs += fail("index", "MidiLoadIndex()'s MTrk differs from MidiScanFile()'s", 0);
+	}
+	for (i = 0; i < idx.NumChecks; i++)
+	{
+	    if ( loaded.Checks[i].Offset != idx.Checks[i].Offset ||
+		 loaded.Checks[i].Time != idx.Checks[i].Time ||
+		 loaded.Checks[i].Status != idx.Checks[i].Status ||
+		 loaded.Checks[i].RunStatus != idx.Checks[i].RunStatus )
+	    {
+		errs += fail("index", "MidiLoadIndex()'s checkpoint differs from MidiScanFile()'s", 0);
+		break;
+	    }
+	}
+    }
+
+    /* Reading from several times, including between checkpoints and after the end */
+    starts[0] = 0;
+    starts[1] = endtime / 3 + 1;
+    starts[2] = endtime / 2 + 2500;
+    starts[3] = endtime + 1;
+    for (i = 0; i < 4; i++)
+    {
+	sprintf(&what[0], "MidiReadFrom() time %lu", (unsigned long)starts[i]);
+	expect.Num = expect.Size = 0;
+	for (j = 0; j < NUMTRKS; j++)
+	{
+	    for (rec = &ref.Recs[0]; rec < &ref.Recs[ref.Num]; rec++)
+	    {
+		if ( rec->Status && rec->Track == j && rec->Time >= starts[i] ) copy_rec(&expect, &ref, rec);
+	    }
+	}
+	for (rec = &ref.Recs[0]; rec < &ref.Recs[ref.Num]; rec++)
+	{
+	    if (!rec->Status) copy_rec(&expect, &ref, rec);
+	}
+	init_file(&tf, "mftest_index.mid", &got);
+	if ( (result = MidiReadFrom(&tf.mf, &loaded, starts[i])) )
+	    errs += fail("index", &what[0], result);
+	else
+	    errs += compare_logs("index", &what[0], &got, &expect, 0);
+    }
+
+    /* The index of a different file. Just make it a size off */
+    loaded.FileSize++;
+    init_file(&tf, "mftest_index.mid", &got);
+    if ( (result = MidiReadFrom(&tf.mf, &loaded, starts[1])) != MIDIERRBAD )
+	errs += fail("index", "MidiReadFrom() with the wrong index isn't MIDIERRBAD", result);
+
+    done_file(&tf);
+    MidiFreeIndex(&idx);
+    MidiFreeIndex(&loaded);
+    free_log(&ref);
+    free_log(&got);
+    free_log(&expect);
+    if (!errs)
+    {
+	remove("mftest_index.mid");
+	remove("mftest_index.idx");
+    }
+    return(errs);
+}
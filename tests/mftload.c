@@ -0,0 +1,57 @@
+/* ===========================================================================
+ * mftload.c
+ *
+ * mftest's check of MidiLoadEvents().
+ * =========================================================================
+ */
+
+#include "mftest.h"
+
+
+
+
+/******************************** check_load() *********************************
+ * Loads the song with MidiLoadEvents(), with and without MIDIMMAP. Both must get what
+ * MidiReadFile() gets.
+ **************************************************************************/
+
+ULONG check_load(VOID)
+{
+    MIDIEVENTS evts;
+    TESTFILE tf;
+    LOG ref, got;
+    CHAR what[60];
+    ULONG i;
+    ULONG errs = 0;
+    LONG result;
+
+    memset(&ref, 0, sizeof(LOG));
+    memset(&got, 0, sizeof(LOG));
+    memset(&tf, 0, sizeof(TESTFILE));
+    memset(&evts, 0, sizeof(MIDIEVENTS));
+
+    if ( (result = write_song("mftest_load.mid", 0, FALSE)) ) return( fail("load", "write failed", result) );
+    if ( (result = read_log("mftest_load.mid", &ref, 0, 0)) )
+	return( fail("load", "MidiReadFile() failed", result) );
+
+    /* The same MIDIEVENTS is reused for each */
+    for (i = 0; i < 2; i++)
+    {
+	init_file(&tf, "mftest_load.mid", 0);
+	tf.mf.Flags = (i) ? MIDIMMAP : 0;
+	sprintf(&what[0], "MidiLoadEvents()%s", (i) ? " with MIDIMMAP" : "");
+	if ( (result = MidiLoadEvents(&tf.mf, &evts)) )
+	{
+	    errs += fail("load", "MidiLoadEvents() failed", result);
+	    continue;
+	}
+	events_log(&got, &evts);
+	errs += compare_logs("load", &what[0], &got, &ref, NOCHUNKS);
+    }
+
+    MidiFreeEvents(&evts);
+    free_log(&ref);
+    free_log(&got);
+    if (!errs) remove("mftest_load.mid");
+    return(errs);
+}
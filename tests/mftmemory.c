@@ -0,0 +1,62 @@
+/* ===========================================================================
+ * mftmemory.c
+ *
+ * mftest's check of MidiReadMemory() and MidiWriteMemory().
+ * =========================================================================
+ */
+
+#include "mftest.h"
+
+
+
+
+/******************************** check_memory() ********************************
+ * Reads the song from memory with MidiReadMemory(), which must get what MidiReadFile() gets, and
+ * writes it into memory with MidiWriteMemory(), which must give the same bytes as MidiWriteFile().
+ **************************************************************************/
+
+ULONG check_memory(VOID)
+{
+    TESTFILE tf;
+    LOG ref, got;
+    UCHAR * buf;
+    VOID * mem;
+    ULONG size, memsize;
+    ULONG errs = 0;
+    LONG result;
+
+    memset(&ref, 0, sizeof(LOG));
+    memset(&got, 0, sizeof(LOG));
+    memset(&tf, 0, sizeof(TESTFILE));
+
+    if ( (result = write_song("mftest_memory.mid", 0, FALSE)) ) return( fail("memory", "write failed", result) );
+    if ( (result = read_log("mftest_memory.mid", &ref, 0, 0)) )
+	return( fail("memory", "MidiReadFile() failed", result) );
+    if ( !(buf = load_bytes("mftest_memory.mid", &size)) ) return( fail("memory", "can't load the file", 0) );
+
+    init_file(&tf, 0, &got);
+    if ( (result = MidiReadMemory(&tf.mf, buf, size)) )
+	errs += fail("memory", "MidiReadMemory() failed", result);
+    else
+	errs += compare_logs("memory", "MidiReadMemory()", &got, &ref, 0);
+
+    init_file(&tf, 0, 0);
+    tf.mf.Format = 1;
+    tf.mf.NumTracks = NUMTRKS;
+    tf.mf.Division = DIVISION;
+    tf.mf.Flags = MIDIBPM;
+    mem = 0;
+    memsize = 0;
+    if ( (result = MidiWriteMemory(&tf.mf, &mem, &memsize)) )
+	errs += fail("memory", "MidiWriteMemory() failed", result);
+    else if ( memsize != size || memcmp(mem, buf, memsize) )
+	errs += fail("memory", "MidiWriteMemory() differs from MidiWriteFile()", 0);
+    free(mem);
+
+    done_file(&tf);
+    free(buf);
+    free_log(&ref);
+    free_log(&got);
+    if (!errs) remove("mftest_memory.mid");
+    return(errs);
+}
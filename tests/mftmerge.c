@@ -0,0 +1,55 @@
+/* ===========================================================================
+ * mftmerge.c
+ *
+ * mftest's check of MidiReadMerged().
+ * =========================================================================
+ */
+
+#include "mftest.h"
+
+
+
+
+/******************************* check_merged() ********************************
+ * Reads the song with MidiReadMerged(), which must get its events in order of time, and (other
+ * than the order) the same events as MidiReadFile().
+ **************************************************************************/
+
+ULONG check_merged(VOID)
+{
+    TESTFILE in;
+    LOG merged, ref;
+    ULONG i;
+    ULONG errs = 0;
+    LONG result;
+
+    memset(&merged, 0, sizeof(LOG));
+    memset(&ref, 0, sizeof(LOG));
+    memset(&in, 0, sizeof(TESTFILE));
+
+    if ( (result = write_song("mftest_merged.mid", 0, FALSE)) )
+	return( fail("merged", "write failed", result) );
+    if ( (result = read_log("mftest_merged.mid", &ref, 0, 0)) )
+	return( fail("merged", "MidiReadFile() failed", result) );
+
+    init_file(&in, "mftest_merged.mid", &merged);
+    if ( (result = MidiReadMerged(&in.mf)) ) return( fail("merged", "MidiReadMerged() failed", result) );
+    for (i = 1; i < merged.Num; i++)
+    {
+	if (merged.Recs[i].Status && merged.Recs[i].Time < merged.Recs[i - 1].Time)
+	{
+	    errs += fail("merged", "MidiReadMerged() isn't in order of time", 0);
+	    break;
+	}
+    }
+
+    sort_log(&merged);
+    sort_log(&ref);
+    errs += compare_logs("merged", "MidiReadMerged() vs MidiReadFile()", &merged, &ref, NOCHUNKS);
+
+    done_file(&in);
+    free_log(&merged);
+    free_log(&ref);
+    if (!errs) remove("mftest_merged.mid");
+    return(errs);
+}
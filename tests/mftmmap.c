@@ -0,0 +1,40 @@
+/* ===========================================================================
+ * mftmmap.c
+ *
+ * mftest's check of the MIDIMMAP read mode.
+ * =========================================================================
+ */
+
+#include "mftest.h"
+
+
+
+
+/********************************* check_mmap() *********************************
+ * Reads the song with MIDIMMAP, which must get what MidiReadFile() gets through its buffer (and
+ * so must MidiReadBytesView(), which the read callbacks use for odd lengths).
+ **************************************************************************/
+
+ULONG check_mmap(VOID)
+{
+    LOG ref, got;
+    ULONG errs = 0;
+    LONG result;
+
+    memset(&ref, 0, sizeof(LOG));
+    memset(&got, 0, sizeof(LOG));
+
+    if ( (result = write_song("mftest_mmap.mid", 0, FALSE)) ) return( fail("mmap", "write failed", result) );
+    if ( (result = read_log("mftest_mmap.mid", &ref, 0, 0)) )
+	return( fail("mmap", "MidiReadFile() failed", result) );
+
+    if ( (result = read_log("mftest_mmap.mid", &got, MIDIMMAP, 0)) )
+	errs += fail("mmap", "MIDIMMAP read failed", result);
+    else
+	errs += compare_logs("mmap", "MIDIMMAP", &got, &ref, 0);
+
+    free_log(&ref);
+    free_log(&got);
+    if (!errs) remove("mftest_mmap.mid");
+    return(errs);
+}
@@ -0,0 +1,110 @@
+/* ===========================================================================
+ * mftparallel.c
+ *
+ * mftest's checks of MIDIPARALLEL, which must give just what doing one MTrk at a time does.
+ * =========================================================================
+ */
+
+#include "mftest.h"
+
+
+
+
+/****************************** check_parallelload() ****************************
+ * Loads the song with MidiLoadEvents() with MIDIPARALLEL (with and without MIDIMMAP). The
+ * MIDIEVENTS table must be just as a serial load makes it, ie, get what MidiReadFile() gets.
+ **************************************************************************/
+
+ULONG check_parallelload(VOID)
+{
+    MIDIEVENTS evts;
+    TESTFILE tf;
+    LOG ref, got;
+    CHAR what[60];
+    ULONG i;
+    ULONG errs = 0;
+    LONG result;
+
+    memset(&ref, 0, sizeof(LOG));
+    memset(&got, 0, sizeof(LOG));
+    memset(&tf, 0, sizeof(TESTFILE));
+    memset(&evts, 0, sizeof(MIDIEVENTS));
+
+    if ( (result = write_song("mftest_parallelload.mid", 0, FALSE)) )
+	return( fail("parallelload", "write failed", result) );
+    if ( (result = read_log("mftest_parallelload.mid", &ref, 0, 0)) )
+	return( fail("parallelload", "MidiReadFile() failed", result) );
+
+    /* The same MIDIEVENTS is reused for each */
+    for (i = 0; i < 2; i++)
+    {
+	init_file(&tf, "mftest_parallelload.mid", 0);
+	tf.mf.Flags = MIDIPARALLEL | ((i) ? MIDIMMAP : 0);
+	sprintf(&what[0], "MidiLoadEvents() with MIDIPARALLEL%s", (i) ? " and MIDIMMAP" : "");
+	if ( (result = MidiLoadEvents(&tf.mf, &evts)) )
+	{
+	    errs += fail("parallelload", &what[0], result);
+	    continue;
+	}
+	events_log(&got, &evts);
+	errs += compare_logs("parallelload", &what[0], &got, &ref, NOCHUNKS);
+    }
+
+    MidiFreeEvents(&evts);
+    free_log(&ref);
+    free_log(&got);
+    if (!errs) remove("mftest_parallelload.mid");
+    return(errs);
+}
+
+
+
+
+/***************************** check_parallelwrite() ****************************
+ * Writes the song with MIDIPARALLEL, a MIDIEVT at a time and with MidiWriteTrackEvents(), and
+ * into memory with MidiWriteMemory(). Each must give the same bytes as a serial write.
+ **************************************************************************/
+
+ULONG check_parallelwrite(VOID)
+{
+    TESTFILE tf;
+    UCHAR * first;
+    VOID * mem;
+    ULONG firstsize, memsize;
+    ULONG errs = 0;
+    LONG result;
+
+    memset(&tf, 0, sizeof(TESTFILE));
+
+    if ( (result = write_song("mftest_parallelwrite.mid", 0, FALSE)) )
+	return( fail("parallelwrite", "serial write failed", result) );
+    if ( !(first = load_bytes("mftest_parallelwrite.mid", &firstsize)) )
+	return( fail("parallelwrite", "can't load the file", 0) );
+
+    errs += same_write("parallelwrite", "MIDIPARALLEL", "mftest_parallelwrite2.mid", MIDIPARALLEL, FALSE,
+		       first, firstsize);
+    errs += same_write("parallelwrite", "MidiWriteTrackEvents() with MIDIPARALLEL", "mftest_parallelwrite2.mid",
+		       MIDIPARALLEL, TRUE, first, firstsize);
+
+    init_file(&tf, 0, 0);
+    tf.mf.Format = 1;
+    tf.mf.NumTracks = NUMTRKS;
+    tf.mf.Division = DIVISION;
+    tf.mf.Flags = MIDIBPM | MIDIPARALLEL;
+    mem = 0;
+    memsize = 0;
+    if ( (result = MidiWriteMemory(&tf.mf, &mem, &memsize)) )
+	errs += fail("parallelwrite", "MidiWriteMemory() with MIDIPARALLEL failed", result);
+    else if ( memsize != firstsize || memcmp(mem, first, memsize) )
+	errs += fail("parallelwrite", "MidiWriteMemory() with MIDIPARALLEL differs from MidiWriteFile()", 0);
+    free(mem);
+
+    done_file(&tf);
+    free(first);
+    if (!errs)
+    {
+	remove("mftest_parallelwrite.mid");
+	remove("mftest_parallelwrite2.mid");
+    }
+    return(errs);
+}
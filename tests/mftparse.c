@@ -0,0 +1,86 @@
+/* ===========================================================================
+ * mftparse.c
+ *
+ * mftest's check of the MIDIPARSER.
+ * =========================================================================
+ */
+
+#include "mftest.h"
+
+
+
+
+/******************************* check_parser() ********************************
+ * Feeds the song to a MIDIPARSER in blocks of 1, 2, 7, 64 (ie, MIDIPARSEBUF), and 65 bytes, and
+ * all at once. Each must get what MidiReadFile() gets. Also checks that a cut short file, and
+ * an event claiming to be longer than its MTrk, are errors (without the latter holding memory
+ * for it).
+ **************************************************************************/
+
+ULONG check_parser(VOID)
+{
+    static const ULONG feeds[] = {1, 2, 7, 64, 65, 0};
+    static const UCHAR bad[] = {'M','T','h','d', 0,0,0,6, 0,0, 0,1, 0,96,
+				'M','T','r','k', 0,0,0,100, 0, 0xF0, 0xFF,0xFF,0xFF,0x7F};
+    MIDIPARSER prs;
+    TESTFILE tf;
+    LOG ref, got;
+    UCHAR * buf;
+    CHAR what[40];
+    ULONG i, pos, len, size;
+    ULONG errs = 0;
+    LONG result;
+
+    memset(&ref, 0, sizeof(LOG));
+    memset(&got, 0, sizeof(LOG));
+    memset(&tf, 0, sizeof(TESTFILE));
+
+    if ( (result = write_song("mftest_parser.mid", 0, FALSE)) )
+	return( fail("parser", "write failed", result) );
+    if ( (result = read_log("mftest_parser.mid", &ref, 0, 0)) )
+	return( fail("parser", "MidiReadFile() failed", result) );
+    if ( !(buf = load_bytes("mftest_parser.mid", &size)) ) return( fail("parser", "can't load the file", 0) );
+
+    for (i = 0; i < sizeof(feeds) / sizeof(feeds[0]); i++)
+    {
+	sprintf(&what[0], "%lu byte blocks", (unsigned long)((feeds[i]) ? feeds[i] : size));
+	init_file(&tf, 0, &got);
+	memset(&prs, 0, sizeof(MIDIPARSER));
+	prs.MidiFile = &tf.mf;
+	result = 0;
+	for (pos = 0; pos < size && !result; pos += len)
+	{
+	    len = (feeds[i] && feeds[i] < size - pos) ? feeds[i] : size - pos;
+	    result = MidiParserFeed(&prs, &buf[pos], len);
+	}
+	if ( (len = MidiParserEnd(&prs)) && !result ) result = len;
+	if (result)
+	    errs += fail("parser", &what[0], result);
+	else
+	    errs += compare_logs("parser", &what[0], &got, &ref, 0);
+    }
+
+    /* Cut short */
+    init_file(&tf, 0, &got);
+    memset(&prs, 0, sizeof(MIDIPARSER));
+    prs.MidiFile = &tf.mf;
+    MidiParserFeed(&prs, buf, size - 3);
+    if ( (result = MidiParserEnd(&prs)) != MIDIERRREAD )
+	errs += fail("parser", "a cut short file isn't MIDIERRREAD", result);
+
+    /* A SYSEX that claims to be 256MB */
+    init_file(&tf, 0, &got);
+    memset(&prs, 0, sizeof(MIDIPARSER));
+    prs.MidiFile = &tf.mf;
+    for (pos = 0; pos < sizeof(bad); pos++) MidiParserFeed(&prs, &bad[pos], 1);
+    if (prs.MaxHold > 1024) errs += fail("parser", "held memory for a SYSEX longer than its MTrk", 0);
+    if ( (result = MidiParserEnd(&prs)) != MIDIERRBAD )
+	errs += fail("parser", "a SYSEX longer than its MTrk isn't MIDIERRBAD", result);
+
+    done_file(&tf);
+    free(buf);
+    free_log(&ref);
+    free_log(&got);
+    if (!errs) remove("mftest_parser.mid");
+    return(errs);
+}
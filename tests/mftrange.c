@@ -0,0 +1,142 @@
+/* ===========================================================================
+ * mftrange.c
+ *
+ * mftest's check of MidiReadRange().
+ * =========================================================================
+ */
+
+#include "mftest.h"
+
+
+
+
+/******************************** check_range() ********************************
+ * Reads the middle third of the song with MidiReadRange(). Each MTrk must start with its chase
+ * (ie, the state at the start of the range, made from what MidiReadFile() got before then), and
+ * then have what MidiReadFile() got within the range.
+ **************************************************************************/
+
+static VOID chase_log(LOG * log, const LOG * ref, UCHAR trk, ULONG start)
+{
+    static const UCHAR metas[] = {0x51, 0x58, 0x59};
+    const REC * last[3];
+    UCHAR ctrl[16][120], program[16], pressure[16], bend[16][2];
+    register const REC * rec;
+    register ULONG i, chan;
+
+    memset(&last[0], 0, sizeof(last));
+    memset(&ctrl[0][0], 0xFF, sizeof(ctrl));
+    memset(&program[0], 0xFF, sizeof(program));
+    memset(&pressure[0], 0xFF, sizeof(pressure));
+    memset(&bend[0][0], 0xFF, sizeof(bend));
+
+    for (rec = &ref->Recs[0]; rec < &ref->Recs[ref->Num]; rec++)
+    {
+	if (rec->Track != trk || rec->Time >= start) continue;
+	chan = rec->Status & 0x0F;
+	switch (rec->Status & 0xF0)
+	{
+	    case 0xB0:
+		if (rec->Data1 < 120) ctrl[chan][rec->Data1] = rec->Data2;
+		break;
+	    case 0xC0:
+		program[chan] = rec->Data1;
+		break;
+	    case 0xD0:
+		pressure[chan] = rec->Data1;
+		break;
+	    case 0xE0:
+		bend[chan][0] = rec->Data1;
+		bend[chan][1] = rec->Data2;
+		break;
+	    case 0xF0:
+		if (rec->Status != 0xFF) break;
+		for (i = 0; i < 3; i++)
+		{
+		    if (rec->Data1 == metas[i]) last[i] = rec;
+		}
+	}
+    }
+
+    for (i = 0; i < 3; i++)
+    {
+	if ( (rec = last[i]) )
+	    add_rec(log, start, trk, 0xFF, rec->Data1, 0, 1, &ref->Bytes[rec->Offset], rec->Len);
+    }
+    for (chan = 0; chan < 16; chan++)
+    {
+	for (i = 0; i < 120; i++)
+	{
+	    if (ctrl[chan][i] != 0xFF)
+		add_rec(log, start, trk, (UCHAR)(0xB0 | chan), (UCHAR)i, ctrl[chan][i], 1, 0, 0);
+	}
+	if (program[chan] != 0xFF) add_rec(log, start, trk, (UCHAR)(0xC0 | chan), program[chan], 0xFF, 1, 0, 0);
+	if (pressure[chan] != 0xFF)
+	    add_rec(log, start, trk, (UCHAR)(0xD0 | chan), pressure[chan], 0xFF, 1, 0, 0);
+	if (bend[chan][0] != 0xFF)
+	    add_rec(log, start, trk, (UCHAR)(0xE0 | chan), bend[chan][0], bend[chan][1], 1, 0, 0);
+    }
+}
+
+ULONG check_range(VOID)
+{
+    register const REC * rec;
+    TESTFILE tf;
+    LOG ref, got, expect;
+    ULONG trk, start, end, endtime;
+    ULONG errs = 0;
+    LONG result;
+
+    memset(&ref, 0, sizeof(LOG));
+    memset(&got, 0, sizeof(LOG));
+    memset(&expect, 0, sizeof(LOG));
+    memset(&tf, 0, sizeof(TESTFILE));
+
+    if ( (result = write_song("mftest_range.mid", 0, FALSE)) ) return( fail("range", "write failed", result) );
+    if ( (result = read_log("mftest_range.mid", &ref, 0, 0)) )
+	return( fail("range", "MidiReadFile() failed", result) );
+
+    endtime = 0;
+    for (rec = &ref.Recs[0]; rec < &ref.Recs[ref.Num]; rec++)
+    {
+	if (rec->Time > endtime) endtime = rec->Time;
+    }
+    start = endtime / 3;
+    end = start * 2;
+
+    for (trk = 0; trk < NUMTRKS; trk++)
+    {
+	chase_log(&expect, &ref, (UCHAR)trk, start);
+	for (rec = &ref.Recs[0]; rec < &ref.Recs[ref.Num]; rec++)
+	{
+	    if (rec->Track == trk && rec->Status && rec->Time >= start && rec->Time < end)
+		copy_rec(&expect, &ref, rec);
+	}
+    }
+    for (rec = &ref.Recs[0]; rec < &ref.Recs[ref.Num]; rec++)
+    {
+	if (!rec->Status) copy_rec(&expect, &ref, rec);
+    }
+
+    init_file(&tf, "mftest_range.mid", &got);
+    if ( (result = MidiReadRange(&tf.mf, start, end)) )
+	errs += fail("range", "MidiReadRange() failed", result);
+    else
+	errs += compare_logs("range", "MidiReadRange()", &got, &expect, 0);
+
+    /* A range after the end of every MTrk gets just the chases */
+    expect.Num = expect.Size = 0;
+    for (trk = 0; trk < NUMTRKS; trk++) chase_log(&expect, &ref, (UCHAR)trk, endtime + 1000);
+    init_file(&tf, "mftest_range.mid", &got);
+    if ( (result = MidiReadRange(&tf.mf, endtime + 1000, 0xFFFFFFFF)) )
+	errs += fail("range", "MidiReadRange() past the end failed", result);
+    else
+	errs += compare_logs("range", "MidiReadRange() past the end", &got, &expect, NOCHUNKS);
+
+    done_file(&tf);
+    free_log(&ref);
+    free_log(&got);
+    free_log(&expect);
+    if (!errs) remove("mftest_range.mid");
+    return(errs);
+}
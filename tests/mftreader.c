@@ -0,0 +1,64 @@
+/* ===========================================================================
+ * mftreader.c
+ *
+ * mftest's check of MidiNextEvent().
+ * =========================================================================
+ */
+
+#include "mftest.h"
+
+
+
+
+/******************************** check_reader() *******************************
+ * Reads the song a MIDIEVENT at a time with MidiNextEvent(), through the buffer and with
+ * MIDIMMAP. Each must get what MidiReadFile() gets (other than the chunks that aren't MTrks,
+ * which are skipped).
+ **************************************************************************/
+
+ULONG check_reader(VOID)
+{
+    MIDIREADER rdr;
+    MIDIEVENT evt;
+    TESTFILE tf;
+    LOG ref, got;
+    ULONG i;
+    ULONG errs = 0;
+    LONG result;
+
+    memset(&ref, 0, sizeof(LOG));
+    memset(&got, 0, sizeof(LOG));
+    memset(&tf, 0, sizeof(TESTFILE));
+
+    if ( (result = write_song("mftest_reader.mid", 0, FALSE)) )
+	return( fail("reader", "write failed", result) );
+    if ( (result = read_log("mftest_reader.mid", &ref, 0, 0)) )
+	return( fail("reader", "MidiReadFile() failed", result) );
+
+    for (i = 0; i < 2; i++)
+    {
+	init_file(&tf, "mftest_reader.mid", 0);
+	tf.mf.Flags = (i) ? MIDIMMAP : 0;
+	memset(&rdr, 0, sizeof(MIDIREADER));
+	rdr.MidiFile = &tf.mf;
+	got.Num = got.Size = 0;
+	if ( (result = MidiOpenReader(&rdr)) )
+	{
+	    errs += fail("reader", "MidiOpenReader() failed", result);
+	    continue;
+	}
+	while ( !(result = MidiNextEvent(&rdr, &evt)) ) event_rec(&got, &evt);
+	MidiCloseReader(&rdr);
+	if (result != -1)
+	    errs += fail("reader", "MidiNextEvent() failed", result);
+	else
+	    errs += compare_logs("reader", (i) ? "MidiNextEvent() with MIDIMMAP" : "MidiNextEvent()", &got,
+				 &ref, NOCHUNKS);
+    }
+
+    done_file(&tf);
+    free_log(&ref);
+    free_log(&got);
+    if (!errs) remove("mftest_reader.mid");
+    return(errs);
+}
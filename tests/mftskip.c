@@ -0,0 +1,84 @@
+/* ===========================================================================
+ * mftskip.c
+ *
+ * mftest's check of the SkipEvents and SkipChans masks.
+ * =========================================================================
+ */
+
+#include "mftest.h"
+
+
+
+
+/********************************* check_skip() *********************************
+ * Reads the song with various SkipEvents and SkipChans, with and without a MIDIARENA. Each must
+ * get what MidiReadFile() gets, less the events skipped.
+ **************************************************************************/
+
+ULONG check_skip(VOID)
+{
+    static const struct
+    {
+	ULONG  Events;
+	USHORT Chans;
+    } skips[] =
+    {
+	{MIDISKIPNOTEON|MIDISKIPSYSEX|MIDISKIPTEXT|MIDISKIPTEMPO, 0x0012},
+	{MIDISKIPMIDI|MIDISKIPESCAPE|MIDISKIPKEYSIG|MIDISKIPTIMESIG|MIDISKIPSEQNUM|MIDISKIPSMPTE, 0},
+	{MIDISKIPNOTEOFF|MIDISKIPAFTER|MIDISKIPCTL|MIDISKIPPGM|MIDISKIPPRESS|MIDISKIPPITCH, 0x0100},
+	{0, 0xFFFF},
+    };
+    register const REC * rec;
+    MIDIARENA arena;
+    TESTFILE tf;
+    LOG ref, got, expect;
+    CHAR what[80];
+    ULONG i, a;
+    ULONG errs = 0;
+    LONG result;
+
+    memset(&ref, 0, sizeof(LOG));
+    memset(&got, 0, sizeof(LOG));
+    memset(&expect, 0, sizeof(LOG));
+    memset(&tf, 0, sizeof(TESTFILE));
+    memset(&arena, 0, sizeof(MIDIARENA));
+
+    if ( (result = write_song("mftest_skip.mid", 0, FALSE)) ) return( fail("skip", "write failed", result) );
+    if ( (result = read_log("mftest_skip.mid", &ref, 0, 0)) )
+	return( fail("skip", "MidiReadFile() failed", result) );
+
+    for (i = 0; i < sizeof(skips) / sizeof(skips[0]); i++)
+    {
+	expect.Num = expect.Size = 0;
+	for (rec = &ref.Recs[0]; rec < &ref.Recs[ref.Num]; rec++)
+	{
+	    if ( !skip_event(rec, skips[i].Events, skips[i].Chans) ) copy_rec(&expect, &ref, rec);
+	}
+
+	for (a = 0; a < 2; a++)
+	{
+	    sprintf(&what[0], "SkipEvents %08lX, SkipChans %04X%s", (unsigned long)skips[i].Events,
+		    skips[i].Chans, (a) ? ", with MIDIARENA" : "");
+	    init_file(&tf, "mftest_skip.mid", &got);
+	    tf.mf.SkipEvents = skips[i].Events;
+	    tf.mf.SkipChans = skips[i].Chans;
+	    if (a)
+	    {
+		tf.mf.Flags = MIDIMMAP;
+		tf.mf.Arena = &arena;
+	    }
+	    if ( (result = MidiReadFile(&tf.mf)) )
+		errs += fail("skip", &what[0], result);
+	    else
+		errs += compare_logs("skip", &what[0], &got, &expect, 0);
+	    MidiFreeArena(&arena);
+	}
+    }
+
+    done_file(&tf);
+    free_log(&ref);
+    free_log(&got);
+    free_log(&expect);
+    if (!errs) remove("mftest_skip.mid");
+    return(errs);
+}
@@ -0,0 +1,121 @@
+/* ===========================================================================
+ * mfttempo.c
+ *
+ * mftest's check of the MIDITEMPOMAP.
+ * =========================================================================
+ */
+
+#include "mftest.h"
+
+
+
+
+/******************************** check_tempo() ********************************
+ * Loads the song's tempos with MidiLoadTempoMap(), which must be the Tempo Meta-Events that
+ * MidiReadFile() gets. Converts times both ways, checking them against adding up each tempo's
+ * ticks the slow way. Also checks that the MIDIFILE's SkipEvents and SkipChans are left alone.
+ **************************************************************************/
+
+static double slow_micros(const LOG * ref, ULONG ticks)
+{
+    register const REC * rec;
+    register const UCHAR * ptr;
+    ULONG tempo = 500000, time = 0;
+    double micros = 0.0;
+
+    for (rec = &ref->Recs[0]; rec < &ref->Recs[ref->Num]; rec++)
+    {
+	if ( rec->Status != 0xFF || rec->Data1 != 0x51 ) continue;
+	if (rec->Time >= ticks) break;
+	micros += (double)(rec->Time - time) * tempo / DIVISION;
+	time = rec->Time;
+	ptr = &ref->Bytes[rec->Offset];
+	tempo = ((ULONG)ptr[0] << 16) | ((ULONG)ptr[1] << 8) | ptr[2];
+    }
+
+    return( micros + (double)(ticks - time) * tempo / DIVISION );
+}
+
+ULONG check_tempo(VOID)
+{
+    register const REC * rec;
+    register const UCHAR * ptr;
+    MIDITEMPOMAP map;
+    TESTFILE tf;
+    LOG ref;
+    ULONG ticks[200];
+    double micros[200], slow;
+    ULONG i, n, num;
+    ULONG errs = 0;
+    LONG result;
+
+    memset(&ref, 0, sizeof(LOG));
+    memset(&tf, 0, sizeof(TESTFILE));
+    memset(&map, 0, sizeof(MIDITEMPOMAP));
+
+    if ( (result = write_song("mftest_tempo.mid", 0, FALSE)) ) return( fail("tempo", "write failed", result) );
+    if ( (result = read_log("mftest_tempo.mid", &ref, 0, 0)) )
+	return( fail("tempo", "MidiReadFile() failed", result) );
+
+    init_file(&tf, "mftest_tempo.mid", 0);
+    tf.mf.SkipEvents = MIDISKIPNOTEON;
+    tf.mf.SkipChans = 0x0101;
+    if ( (result = MidiLoadTempoMap(&tf.mf, &map)) )
+	return( fail("tempo", "MidiLoadTempoMap() failed", result) );
+    if (tf.mf.SkipEvents != MIDISKIPNOTEON || tf.mf.SkipChans != 0x0101)
+	errs += fail("tempo", "MidiLoadTempoMap() changed SkipEvents or SkipChans", 0);
+
+    /* The song's first tempo is at time 0, so it replaces the 120 BPM default */
+    n = 0;
+    for (rec = &ref.Recs[0]; rec < &ref.Recs[ref.Num]; rec++)
+    {
+	if ( rec->Status != 0xFF || rec->Data1 != 0x51 ) continue;
+	ptr = &ref.Bytes[rec->Offset];
+	if ( n >= map.NumTempos || map.Ticks[n] != rec->Time ||
+	     map.Tempo[n] != (((ULONG)ptr[0] << 16) | ((ULONG)ptr[1] << 8) | ptr[2]) )
+	{
+	    errs += fail("tempo", "MidiLoadTempoMap() doesn't have the song's tempos", 0);
+	    break;
+	}
+	n++;
+    }
+    if (n != map.NumTempos || map.Division != DIVISION)
+	errs += fail("tempo", "MidiLoadTempoMap() has extra tempos", 0);
+
+    /* Times at, just after, and between tempos */
+    num = 0;
+    for (i = 0; i < map.NumTempos && num < 198; i += 1 + map.NumTempos / 66)
+    {
+	ticks[num++] = map.Ticks[i];
+	ticks[num++] = map.Ticks[i] + 1;
+	ticks[num++] = map.Ticks[i] + 37;
+    }
+    ticks[num++] = map.Ticks[map.NumTempos - 1] + 100000;
+
+    MidiTicksToMicrosN(&map, &ticks[0], &micros[0], num);
+    for (i = 0; i < num; i++)
+    {
+	slow = slow_micros(&ref, ticks[i]);
+	if ( fabs(MidiTicksToMicros(&map, ticks[i]) - slow) > 1e-6 * slow + 1e-3 )
+	{
+	    errs += fail("tempo", "MidiTicksToMicros() is wrong", 0);
+	    break;
+	}
+	if ( fabs(micros[i] - slow) > 1e-6 * slow + 1e-3 )
+	{
+	    errs += fail("tempo", "MidiTicksToMicrosN() is wrong", 0);
+	    break;
+	}
+	if ( MidiMicrosToTicks(&map, MidiTicksToMicros(&map, ticks[i])) != ticks[i] )
+	{
+	    errs += fail("tempo", "MidiMicrosToTicks() doesn't undo MidiTicksToMicros()", 0);
+	    break;
+	}
+    }
+
+    done_file(&tf);
+    MidiFreeTempoMap(&map);
+    free_log(&ref);
+    if (!errs) remove("mftest_tempo.mid");
+    return(errs);
+}
@@ -0,0 +1,187 @@
+/* ===========================================================================
+ * mfttrack.c
+ *
+ * mftest's check of MidiWriteTrackEvents().
+ * =========================================================================
+ */
+
+#include "mftest.h"
+
+
+
+
+/* The MIDIEVTs that bad_track() writes with MidiWriteTrackEvents(), and their payloads */
+static const MIDIEVT * BadEvts;
+static ULONG NumBad;
+static UCHAR ** BadPayloads;
+
+/* How many bytes MidiWriteTrackEvents() wrote before it failed (which must be none) */
+static LONG BadWritten;
+
+
+
+
+/******************************* check_trackevents() ****************************
+ * Checks what MidiWriteTrackEvents() (and the other writes) refuse: an End Of Track that isn't
+ * last, a Length with no payload, a delta-time or length that no reader could get back. Also
+ * that the song written with it is the same as a MIDIEVT at a time, that with no payloads at
+ * all, events with a Length of 0 are fine, and that an End Of Track is added.
+ **************************************************************************/
+
+static LONG EXPENTRY bad_track(MIDIFILE * mf)
+{
+    register LONG result;
+    LONG size = mf->FileSize;
+
+    /* No MIDIEVTs means MidiWriteVLQ() of a value that's too big */
+    if (!NumBad) return( MidiWriteVLQ(mf, MIDIVLQMAX + 1) );
+
+    if ( (result = MidiWriteTrackEvents(mf, BadEvts, NumBad, BadPayloads)) )
+    {
+	BadWritten = mf->FileSize - size;
+	return(result);
+    }
+    return(-1);
+}
+
+static LONG EXPENTRY big_sysex(MIDIFILE * mf)
+{
+    static UCHAR buf[4];
+
+    mf->Time = 0;
+    mf->Status = 0xF0;
+    mf->EventSize = MIDIVLQMAX + 1;
+    ((METATXT *)mf)->Ptr = &buf[0];
+    return(0);
+}
+
+static LONG write_bad(const MIDIEVT * evts, ULONG count, UCHAR ** payloads, CALL standard, VOID ** mem, ULONG * size)
+{
+    CALLBACK cb;
+    MIDIFILE mf;
+
+    memset(&cb, 0, sizeof(CALLBACK));
+    cb.StartMTrk = (standard) ? 0 : (CALL)bad_track;
+    cb.StandardEvt = standard;
+    memset(&mf, 0, sizeof(MIDIFILE));
+    mf.Callbacks = &cb;
+    mf.NumTracks = 1;
+    mf.Division = 96;
+
+    BadEvts = evts;
+    NumBad = count;
+    BadPayloads = payloads;
+    *mem = 0;
+    *size = 0;
+    return( MidiWriteMemory(&mf, mem, size) );
+}
+
+ULONG check_trackevents(VOID)
+{
+    MIDIEVT evts[6];
+    UCHAR * payloads[1];
+    TESTFILE tf;
+    LOG got, expect;
+    UCHAR * first;
+    VOID * mem;
+    ULONG size, firstsize;
+    ULONG errs = 0;
+    LONG result;
+
+    memset(&got, 0, sizeof(LOG));
+    memset(&expect, 0, sizeof(LOG));
+    memset(&tf, 0, sizeof(TESTFILE));
+    memset(&evts[0], 0, sizeof(evts));
+
+    /* The song, with MidiWriteTrackEvents(), must be the same bytes as a MIDIEVT at a time */
+    if ( (result = write_song("mftest_trackevents.mid", 0, FALSE)) )
+	return( fail("trackevents", "write failed", result) );
+    if ( !(first = load_bytes("mftest_trackevents.mid", &firstsize)) )
+	return( fail("trackevents", "can't load the file", 0) );
+    errs += same_write("trackevents", "MidiWriteTrackEvents()", "mftest_trackevents2.mid", 0, TRUE, first, firstsize);
+    free(first);
+
+    /* No payloads, and nothing that needs one. The End Of Track is added */
+    evts[0].Time = 0;
+    evts[0].Status = 0x90;
+    evts[0].Data1 = 60;
+    evts[0].Data2 = 100;
+    evts[1].Time = 10;
+    evts[1].Status = 0x80;
+    evts[1].Data1 = 60;
+    evts[1].Data2 = 64;
+    evts[2].Time = 20;
+    evts[2].Status = 0x01;  /* Empty text */
+    evts[3].Time = 30;
+    evts[3].Status = 0xF0;  /* Empty SYSEX */
+    if ( (result = write_bad(&evts[0], 4, 0, 0, &mem, &size)) )
+	errs += fail("trackevents", "MIDIEVTs that need no payloads failed", result);
+    else
+    {
+	init_file(&tf, 0, &got);
+	if ( (result = MidiReadMemory(&tf.mf, mem, size)) )
+	    errs += fail("trackevents", "reading MIDIEVTs that need no payloads failed", result);
+	else
+	{
+	    add_rec(&expect, 0, 0, 0x90, 60, 100, 0, 0, 0);
+	    add_rec(&expect, 10, 0, 0x80, 60, 64, 0, 0, 0);
+	    add_rec(&expect, 20, 0, 0xFF, 0x01, 0, 0, 0, 0);
+	    add_rec(&expect, 30, 0, 0xF0, 0, 0, 0, 0, 0);
+	    add_rec(&expect, 30, 0, 0xFF, 0x2F, 0, 0, 0, 0);
+	    errs += compare_logs("trackevents", "MIDIEVTs that need no payloads", &got, &expect, 0);
+	}
+    }
+    free(mem);
+
+    /* A Length, but no payloads */
+    ((MIDITXTEVT *)&evts[2])->Length = 3;
+    if ( (result = write_bad(&evts[0], 4, 0, 0, &mem, &size)) != MIDIERRBAD )
+	errs += fail("trackevents", "text with no payload isn't MIDIERRBAD", result);
+    else if (BadWritten)
+	errs += fail("trackevents", "text with no payload left part of an MTrk", BadWritten);
+    free(mem);
+
+    /* Or a payload that's 0 */
+    payloads[0] = 0;
+    if ( (result = write_bad(&evts[0], 4, &payloads[0], 0, &mem, &size)) != MIDIERRBAD )
+	errs += fail("trackevents", "text with a 0 payload isn't MIDIERRBAD", result);
+    else if (BadWritten)
+	errs += fail("trackevents", "text with a 0 payload left part of an MTrk", BadWritten);
+    free(mem);
+    ((MIDITXTEVT *)&evts[2])->Length = 0;
+
+    /* An End Of Track that isn't last */
+    evts[1].Status = 0x2F;
+    if ( (result = write_bad(&evts[0], 4, 0, 0, &mem, &size)) != MIDIERRBAD )
+	errs += fail("trackevents", "an End Of Track that isn't last isn't MIDIERRBAD", result);
+    else if (BadWritten)
+	errs += fail("trackevents", "an End Of Track that isn't last left part of an MTrk", BadWritten);
+    free(mem);
+    evts[1].Status = 0x80;
+
+    /* Too long between events */
+    evts[3].Time = 20 + MIDIVLQMAX + 1;
+    if ( (result = write_bad(&evts[0], 4, 0, 0, &mem, &size)) != MIDIERRBAD )
+	errs += fail("trackevents", "a delta-time over MIDIVLQMAX isn't MIDIERRBAD", result);
+    else if (BadWritten)
+	errs += fail("trackevents", "a delta-time over MIDIVLQMAX left part of an MTrk", BadWritten);
+    free(mem);
+
+    if ( (result = write_bad(&evts[0], 0, 0, 0, &mem, &size)) != MIDIERRBAD )
+	errs += fail("trackevents", "MidiWriteVLQ() over MIDIVLQMAX isn't MIDIERRBAD", result);
+    free(mem);
+
+    if ( (result = write_bad(&evts[0], 0, 0, (CALL)big_sysex, &mem, &size)) != MIDIERRBAD )
+	errs += fail("trackevents", "a SYSEX over MIDIVLQMAX bytes isn't MIDIERRBAD", result);
+    free(mem);
+
+    done_file(&tf);
+    free_log(&got);
+    free_log(&expect);
+    if (!errs)
+    {
+	remove("mftest_trackevents.mid");
+	remove("mftest_trackevents2.mid");
+    }
+    return(errs);
+}
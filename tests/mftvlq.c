@@ -0,0 +1,60 @@
+/* ===========================================================================
+ * mftvlq.c
+ *
+ * mftest's check of MidiVLQToLongN() and MidiLongToVLQ().
+ * =========================================================================
+ */
+
+#include "mftest.h"
+
+
+
+
+/*********************************** check_vlq() **********************************
+ * Converts values to variable length quantities and back, one at a time and a whole buffer
+ * of them at once. Each must take only as many bytes as it needs, and one too big for 4 bytes
+ * must be clamped to MIDIVLQMAX.
+ **************************************************************************/
+
+ULONG check_vlq(VOID)
+{
+    static const ULONG vals[] = {0, 0x7F, 0x80, 0x3FFF, 0x4000, 0x1FFFFF, 0x200000, MIDIVLQMAX, MIDIVLQMAX + 1,
+				 0xFFFFFFFF};
+    static const ULONG lens[] = {1, 1, 2, 2, 3, 3, 4, 4, 4, 4};
+    static ULONG nums[5000], got[5000];
+    static UCHAR buf[5000 * 4 + 4];
+    ULONG i, len, size, n;
+    ULONG errs = 0;
+
+    for (i = 0; i < sizeof(vals) / sizeof(vals[0]); i++)
+    {
+	memset(&buf[0], 0xAA, 8);
+	len = MidiLongToVLQ(vals[i], &buf[0]);
+	if (len != lens[i] || buf[len] != 0xAA)
+	    errs += fail("vlq", "MidiLongToVLQ() stored the wrong number of bytes", 0);
+	if ( (ULONG)MidiVLQToLong(&buf[0], &size) != ((vals[i] > MIDIVLQMAX) ? MIDIVLQMAX : vals[i]) ||
+	     size != len )
+	    errs += fail("vlq", "MidiVLQToLong() doesn't undo MidiLongToVLQ()", 0);
+    }
+
+    /* Mostly 1 byte quantities, as delta-times are */
+    for (i = size = 0; i < 5000; i++)
+    {
+	nums[i] = rnd(4) ? rnd(128) : rnd(MIDIVLQMAX) >> rnd(28);
+	size += MidiLongToVLQ(nums[i], &buf[size]);
+    }
+    n = MidiVLQToLongN(&buf[0], size, &got[0], 5000, &len);
+    if (n != 5000 || len != size || memcmp(&got[0], &nums[0], sizeof(nums)))
+	errs += fail("vlq", "MidiVLQToLongN() doesn't undo MidiLongToVLQ()", 0);
+
+    /* Stops where the bytes run out */
+    n = MidiVLQToLongN(&buf[0], 10, &got[0], 5000, &len);
+    if (len > 10 || n > 10) errs += fail("vlq", "MidiVLQToLongN() went past the end of the bytes", 0);
+
+    return(errs);
+}
+
+
+
+
+/* The checks, in the order that they run */
@@ -0,0 +1,90 @@
+/* ===========================================================================
+ * mftwhole.c
+ *
+ * mftest's check of MIDIWHOLESYSEX.
+ * =========================================================================
+ */
+
+#include "mftest.h"
+
+
+
+
+/****************************** check_wholesysex() *****************************
+ * Reads the song with MIDIWHOLESYSEX (and a MIDIARENA), through the buffer, with MIDIMMAP, from
+ * memory, and with a MIDIPARSER. Each SYSEX must be what MidiReadFile() gets with its packets
+ * put back together.
+ **************************************************************************/
+
+ULONG check_wholesysex(VOID)
+{
+    MIDIARENA arena;
+    MIDIPARSER prs;
+    TESTFILE tf;
+    LOG ref, got, expect;
+    UCHAR * buf;
+    ULONG pos, len, size;
+    ULONG errs = 0;
+    LONG result;
+
+    memset(&ref, 0, sizeof(LOG));
+    memset(&got, 0, sizeof(LOG));
+    memset(&expect, 0, sizeof(LOG));
+    memset(&tf, 0, sizeof(TESTFILE));
+    memset(&arena, 0, sizeof(MIDIARENA));
+
+    if ( (result = write_song("mftest_wholesysex.mid", 0, FALSE)) )
+	return( fail("wholesysex", "write failed", result) );
+    if ( (result = read_log("mftest_wholesysex.mid", &ref, 0, 0)) )
+	return( fail("wholesysex", "MidiReadFile() failed", result) );
+    whole_log(&expect, &ref);
+    if (expect.Num >= ref.Num) errs += fail("wholesysex", "the song has no SYSEX in packets", 0);
+
+    if ( (result = read_log("mftest_wholesysex.mid", &got, MIDIWHOLESYSEX, &arena)) )
+	errs += fail("wholesysex", "read failed", result);
+    else
+	errs += compare_logs("wholesysex", "MIDIWHOLESYSEX", &got, &expect, 0);
+
+    if ( (result = read_log("mftest_wholesysex.mid", &got, MIDIWHOLESYSEX|MIDIMMAP, &arena)) )
+	errs += fail("wholesysex", "MIDIMMAP read failed", result);
+    else
+	errs += compare_logs("wholesysex", "MIDIWHOLESYSEX with MIDIMMAP", &got, &expect, 0);
+
+    if ( !(buf = load_bytes("mftest_wholesysex.mid", &size)) )
+	return( fail("wholesysex", "can't load the file", 0) );
+
+    init_file(&tf, 0, &got);
+    tf.mf.Flags = MIDIWHOLESYSEX;
+    tf.mf.Arena = &arena;
+    if ( (result = MidiReadMemory(&tf.mf, buf, size)) )
+	errs += fail("wholesysex", "MidiReadMemory() failed", result);
+    else
+	errs += compare_logs("wholesysex", "MIDIWHOLESYSEX with MidiReadMemory()", &got, &expect, 0);
+    MidiFreeArena(&arena);
+
+    init_file(&tf, 0, &got);
+    tf.mf.Flags = MIDIWHOLESYSEX;
+    tf.mf.Arena = &arena;
+    memset(&prs, 0, sizeof(MIDIPARSER));
+    prs.MidiFile = &tf.mf;
+    result = 0;
+    for (pos = 0; pos < size && !result; pos += len)
+    {
+	len = (size - pos < 7) ? size - pos : 7;
+	result = MidiParserFeed(&prs, &buf[pos], len);
+    }
+    if ( (len = MidiParserEnd(&prs)) && !result ) result = len;
+    if (result)
+	errs += fail("wholesysex", "MIDIPARSER failed", result);
+    else
+	errs += compare_logs("wholesysex", "MIDIWHOLESYSEX with a MIDIPARSER", &got, &expect, 0);
+    MidiFreeArena(&arena);
+
+    done_file(&tf);
+    free(buf);
+    free_log(&ref);
+    free_log(&got);
+    free_log(&expect);
+    if (!errs) remove("mftest_wholesysex.mid");
+    return(errs);
+}
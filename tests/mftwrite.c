@@ -0,0 +1,39 @@
+/* ===========================================================================
+ * mftwrite.c
+ *
+ * mftest's check of MidiWriteFile(), which every other check relies on to make its file.
+ * =========================================================================
+ */
+
+#include "mftest.h"
+
+
+
+
+/******************************** check_write() ********************************
+ * Writes the song a MIDIEVT at a time, serially, which must read back as the song.
+ **************************************************************************/
+
+ULONG check_write(VOID)
+{
+    LOG got, expect;
+    ULONG errs = 0;
+    LONG result;
+
+    memset(&got, 0, sizeof(LOG));
+    memset(&expect, 0, sizeof(LOG));
+
+    if ( (result = write_song("mftest_write.mid", 0, FALSE)) )
+	return( fail("write", "serial write failed", result) );
+
+    song_log(&expect);
+    if ( (result = read_log("mftest_write.mid", &got, 0, 0)) )
+	errs += fail("write", "MidiReadFile() failed", result);
+    else
+	errs += compare_logs("write", "MidiReadFile() vs the song", &got, &expect, 0);
+
+    free_log(&got);
+    free_log(&expect);
+    if (!errs) remove("mftest_write.mid");
+    return(errs);
+}
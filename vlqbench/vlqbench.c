@@ -0,0 +1,214 @@
+/* ===========================================================================
+ * vlqbench.c
+ *
+ * Times the MIDIFILE.DLL variable length quantity conversions. MidiVLQToLong() (one quantity per
+ * call) is compared with MidiVLQToLongN() (many quantities per call), and MidiLongToVLQ() is
+ * compared with the byte-at-a-time loop that it used to be. The results of each pair are also
+ * checked against each other.
+ * =========================================================================
+ */
+
+#ifdef __OS2__
+#include <os2.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "midifile.h"
+
+
+/* How many quantities to convert in each test, and how many times to repeat it (unless the user
+    says otherwise) */
+#define NUMVALS 1000000
+#define REPEATS 20
+
+ULONG repeats = REPEATS;
+
+/* The values, and their variable length quantities */
+ULONG values[NUMVALS];
+ULONG results[NUMVALS];
+UCHAR vlqs[NUMVALS * 5];
+
+/* The encoder being timed. Calling it through this keeps the compiler from inlining one encoder
+    (but not the other) into the timing loop */
+ULONG (* volatile encoder)(ULONG val, UCHAR * ptr);
+
+
+
+
+/********************************** seconds() ********************************
+ * Returns the time in seconds, for timing the tests.
+ **************************************************************************/
+
+double seconds(VOID)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return(ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+
+
+
+/******************************** old_tovlq() *********************************
+ * The MidiLongToVLQ() loop before it was made branchless, for comparison.
+ **************************************************************************/
+
+ULONG old_tovlq(ULONG val, UCHAR * ptr)
+{
+    UCHAR buf[5];
+    register ULONG i = 0;
+    register ULONG len;
+
+    do
+    {
+	buf[i++] = (UCHAR)(val & 0x7F);
+	val >>= 7;
+    } while (val);
+
+    len = i;
+    while (--i)
+    {
+	*(ptr)++ = buf[i] | 0x80;
+    }
+    *ptr = buf[0];
+
+    return(len);
+}
+
+
+
+
+/********************************** fill() ***********************************
+ * Makes up the values for a test. Of every 100, ones is how many are less than 0x80 (ie, 1 byte
+ * delta-times, like dense controller data), and the rest are up to 0x0FFFFFFF. Then they're
+ * converted to variable length quantities in vlqs, and the total length is returned.
+ **************************************************************************/
+
+ULONG fill(ULONG ones)
+{
+    register ULONG i, len;
+
+    srand(1);
+    for (i=0, len=0; i < NUMVALS; i++)
+    {
+	if ( (ULONG)(rand() % 100) < ones )
+	    values[i] = rand() & 0x7F;
+	else
+	    values[i] = (ULONG)rand() & (0x0FFFFFFF >> (rand() % 21));
+	len += old_tovlq(values[i], &vlqs[len]);
+    }
+    return(len);
+}
+
+
+
+
+/********************************* decode() **********************************
+ * Times decoding all of the quantities, first one at a time with MidiVLQToLong(), then with
+ * MidiVLQToLongN().
+ **************************************************************************/
+
+VOID decode(ULONG ones)
+{
+    register ULONG i, r, pos;
+    ULONG size, len;
+    double start, one, many;
+
+    size = fill(ones);
+
+    start = seconds();
+    for (r = 0; r < repeats; r++)
+    {
+	for (i=0, pos=0; i < NUMVALS; i++)
+	{
+	    results[i] = MidiVLQToLong(&vlqs[pos], &len);
+	    pos += len;
+	}
+    }
+    one = seconds() - start;
+    if ( memcmp(values, results, sizeof(values)) ) printf("MidiVLQToLong() got it wrong!\r\n");
+
+    memset(results, 0, sizeof(results));
+    start = seconds();
+    for (r = 0; r < repeats; r++)
+    {
+	if ( MidiVLQToLongN(&vlqs[0], size, &results[0], NUMVALS, &len) != NUMVALS || len != size )
+	    printf("MidiVLQToLongN() stopped short!\r\n");
+    }
+    many = seconds() - start;
+    if ( memcmp(values, results, sizeof(values)) ) printf("MidiVLQToLongN() got it wrong!\r\n");
+
+    printf("Decode, %3lu%% 1-byte: MidiVLQToLong %7.2f ns/value, MidiVLQToLongN %7.2f ns/value (%.1fx)\r\n",
+	(unsigned long)ones, one * 1e9 / (NUMVALS * (double)repeats), many * 1e9 / (NUMVALS * (double)repeats), one / many);
+}
+
+
+
+
+/********************************* encode() **********************************
+ * Times encoding all of the values, first with the old loop, then with MidiLongToVLQ().
+ **************************************************************************/
+
+VOID encode(ULONG ones)
+{
+    register ULONG i, r, pos;
+    ULONG (* func)(ULONG val, UCHAR * ptr);
+    ULONG size;
+    double start, old, now;
+    static UCHAR out[NUMVALS * 5 + 5];
+
+    size = fill(ones);
+
+    encoder = old_tovlq;
+    func = encoder;
+    start = seconds();
+    for (r = 0; r < repeats; r++)
+    {
+	for (i=0, pos=0; i < NUMVALS; i++) pos += func(values[i], &out[pos]);
+    }
+    old = seconds() - start;
+
+    memset(out, 0, sizeof(out));
+    encoder = MidiLongToVLQ;
+    func = encoder;
+    start = seconds();
+    for (r = 0; r < repeats; r++)
+    {
+	for (i=0, pos=0; i < NUMVALS; i++) pos += func(values[i], &out[pos]);
+    }
+    now = seconds() - start;
+    if ( pos != size || memcmp(vlqs, out, size) ) printf("MidiLongToVLQ() got it wrong!\r\n");
+
+    printf("Encode, %3lu%% 1-byte: old loop      %7.2f ns/value, MidiLongToVLQ  %7.2f ns/value (%.1fx)\r\n",
+	(unsigned long)ones, old * 1e9 / (NUMVALS * (double)repeats), now * 1e9 / (NUMVALS * (double)repeats), old / now);
+}
+
+
+
+
+/********************************** main() ***********************************
+ * Program entry point. Runs the tests with mostly 1 byte quantities (as with dense controller
+ * data), and with a mix. An arg is how many times to repeat each test.
+ **************************************************************************/
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && !(repeats = strtoul(argv[1], 0, 10)))
+    {
+	printf("Syntax: VLQBENCH.EXE [repeats]\r\n");
+	exit(1);
+    }
+
+    decode(100);
+    decode(90);
+    decode(50);
+    encode(100);
+    encode(90);
+    encode(50);
+
+    exit(0);
+}